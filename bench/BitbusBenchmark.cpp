@@ -0,0 +1,702 @@
+// Times the decoder's hot kernels in isolation on synthetic edge streams,
+// across bit rates and oversampling ratios. Build with
+// -DBITBUS_STANDALONE_CORE=ON and run BitbusBenchmark [kernel-name-filter].
+
+#include "BitbusCsvExport.h"
+#include "BitbusParallelExport.h"
+#include "BitbusDecoder.h"
+#include "BitbusEdgeChannel.h"
+#include "BitbusFieldText.h"
+#include "BitbusTextCache.h"
+#include "BitbusLineEncoder.h"
+#include "BitbusWaveform.h"
+#include <chrono>
+#include <fstream>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+using namespace std;
+
+// Each measurement repeats its kernel for at least this long
+#define BENCH_MIN_SECONDS 0.1
+// Payload of the single long frame the byte kernels read
+#define BENCH_PAYLOAD_BYTES 16384
+// Frames of the end-to-end stream
+#define BENCH_FRAMES 512
+#define BENCH_FRAME_INFO_BYTES 32
+
+struct NullSink
+{
+	void AddDecodedFrame ( const BitbusFrame & )
+	{
+		mFrames++;
+	}
+
+	void AddDecodedMarker ( U64, BitbusMarkerType type )
+	{
+		mFcsErrors += ( type == BITBUS_MARKER_FCS_ERROR ) ? 1 : 0;
+	}
+
+	void BeforeChannelRead()
+	{
+	}
+
+	U64 mFrames = 0;
+	U64 mFcsErrors = 0;
+};
+
+// Gives the benchmark access to the decoder's kernels
+class KernelDecoder : public BitbusDecoder< BitbusEdgeChannel, NullSink >
+{
+public:
+	KernelDecoder ( const BitbusDecoderSettings & settings, NullSink & sink ) :
+		BitbusDecoder< BitbusEdgeChannel, NullSink > ( settings, sink )
+	{
+	}
+
+	using BitbusDecoder< BitbusEdgeChannel, NullSink >::BitSyncReadBits;
+	using BitbusDecoder< BitbusEdgeChannel, NullSink >::BitSyncReadByte;
+	using BitbusDecoder< BitbusEdgeChannel, NullSink >::BitSyncProcessFlags;
+	using BitbusDecoder< BitbusEdgeChannel, NullSink >::BitSyncSkipInterval;
+	using BitbusDecoder< BitbusEdgeChannel, NullSink >::FlagComing;
+	using BitbusDecoder< BitbusEdgeChannel, NullSink >::AbortComing;
+	using BitbusDecoder< BitbusEdgeChannel, NullSink >::ByteAsyncDecodeByte;
+
+	void SetReadingFrame()
+	{
+		mReadingFrame = true;
+	}
+};
+
+// Counts what the bubble text generator produces
+struct NullText
+{
+	void AddResultString ( const char* str1, const char* str2 = 0, const char* str3 = 0,
+	                       const char* str4 = 0, const char* str5 = 0, const char* str6 = 0 )
+	{
+		Add ( str1 );
+		Add ( str2 );
+		Add ( str3 );
+		Add ( str4 );
+		Add ( str5 );
+		Add ( str6 );
+	}
+
+	void AddTabularText ( const char* str1, const char* str2 = 0, const char* str3 = 0,
+	                      const char* str4 = 0, const char* str5 = 0, const char* str6 = 0 )
+	{
+		AddResultString ( str1, str2, str3, str4, str5, str6 );
+	}
+
+	void Add ( const char* str )
+	{
+		if ( str != 0 )
+		{
+			mChars += strlen ( str );
+		}
+	}
+
+	U64 mChars = 0;
+};
+
+// What one pass of a kernel went through
+struct BenchWork
+{
+	U64 lineBits;     // bit cells on the line (0: not a line kernel)
+	U64 payloadBytes; // decoded bytes
+	U64 frames;       // decoded BITBUS frames (0: not a frame kernel)
+};
+
+class Stopwatch
+{
+public:
+	Stopwatch() : mStart ( std::chrono::steady_clock::now() ) {}
+
+	double Seconds() const
+	{
+		return std::chrono::duration<double> ( std::chrono::steady_clock::now() - mStart ).count();
+	}
+
+protected:
+	std::chrono::steady_clock::time_point mStart;
+};
+
+static U32 sRandom = 0x12345678;
+
+static U8 RandomByte()
+{
+	sRandom ^= sRandom << 13;
+	sRandom ^= sRandom >> 17;
+	sRandom ^= sRandom << 5;
+	return U8 ( sRandom );
+}
+
+static const char* sFilter = 0;
+// Kernel results go here so the compiler cannot drop the calls
+static volatile U64 sKernelResults = 0;
+// FCS errors on the end-to-end streams: they are encoded clean, so any is a decode bug
+static U64 sDecodeErrors = 0;
+
+static bool Selected ( const char* kernel )
+{
+	return ( sFilter == 0 ) || ( strstr ( kernel, sFilter ) != 0 );
+}
+
+static void PrintHeader()
+{
+	printf ( "%-22s %8s %4s %10s %10s %12s %10s\n", "kernel", "rate", "os", "ns/bit", "MB/s", "frames/s", "x realtime" );
+}
+
+// Run pass until BENCH_MIN_SECONDS have gone by, then report per pass
+template <class Pass>
+static void Measure ( const char* kernel, U32 bitRate, U32 oversampling, Pass pass )
+{
+	BenchWork work = pass(); // warm up (and size the work)
+	U32 passes = 0;
+	Stopwatch watch;
+	double seconds;
+	do
+	{
+		pass();
+		passes++;
+		seconds = watch.Seconds();
+	}
+	while ( seconds < BENCH_MIN_SECONDS );
+	seconds /= passes;
+
+	char rate[ 16 ] = "-";
+	char os[ 16 ] = "-";
+	char nsPerBit[ 16 ] = "-";
+	char framesPerSecond[ 16 ] = "-";
+	char realtime[ 16 ] = "-";
+	if ( bitRate != 0 )
+	{
+		snprintf ( rate, sizeof ( rate ), "%u", bitRate );
+		snprintf ( os, sizeof ( os ), "%ux", oversampling );
+	}
+	if ( work.lineBits != 0 )
+	{
+		snprintf ( nsPerBit, sizeof ( nsPerBit ), "%.2f", seconds * 1e9 / double ( work.lineBits ) );
+		if ( bitRate != 0 )
+		{
+			snprintf ( realtime, sizeof ( realtime ), "%.0f", double ( work.lineBits ) / seconds / bitRate );
+		}
+	}
+	if ( work.frames != 0 )
+	{
+		snprintf ( framesPerSecond, sizeof ( framesPerSecond ), "%.0f", double ( work.frames ) / seconds );
+	}
+
+	char megabytesPerSecond[ 16 ] = "-";
+	if ( work.payloadBytes != 0 )
+	{
+		snprintf ( megabytesPerSecond, sizeof ( megabytesPerSecond ), "%.2f", double ( work.payloadBytes ) / seconds / 1e6 );
+	}
+
+	printf ( "%-22s %8s %4s %10s %10s %12s %10s\n", kernel, rate, os, nsPerBit, megabytesPerSecond, framesPerSecond, realtime );
+}
+
+static U64 LineBits ( const BitbusLineEncoder & line, U32 oversampling )
+{
+	return line.GetEndSample() / oversampling;
+}
+
+// One long frame of random payload
+static void EncodePayload ( BitbusLineEncoder & line, vector<U8> & payload )
+{
+	payload.resize ( BENCH_PAYLOAD_BYTES );
+	for ( U32 i=0; i < payload.size(); ++i )
+	{
+		payload[ i ] = RandomByte();
+	}
+	line.AddIdle ( 16 );
+	line.AddFlags ( 2 );
+	line.AddFrame ( payload.data(), U32 ( payload.size() ) );
+	line.AddFlags ( 2 );
+	line.AddIdle ( 16 );
+}
+
+static void BenchBitSync ( U32 bitRate, U32 oversampling )
+{
+	BitbusDecoderSettings settings;
+	settings.mBitRate = bitRate;
+	settings.mTransmissionMode = BITBUS_TRANSMISSION_BIT_SYNC;
+	const U32 sampleRate = bitRate * oversampling;
+
+	BitbusLineEncoder line ( settings, oversampling );
+	vector<U8> payload;
+	EncodePayload ( line, payload );
+	const vector<U64> & edges = line.GetEdges();
+	// Stop short of the FCS and the closing flag
+	const U32 bytes = U32 ( payload.size() ) - 1;
+	const U64 bits = U64 ( bytes ) * 8;
+
+	if ( Selected ( "BitSyncReadBits" ) )
+	{
+		Measure ( "BitSyncReadBits", bitRate, oversampling, [&]() -> BenchWork
+		{
+			BitbusEdgeChannel channel ( line.GetInitialState(), edges.data(), edges.size(), line.GetEndSample() );
+			NullSink sink;
+			KernelDecoder decoder ( settings, sink );
+			decoder.Setup ( &channel, sampleRate );
+			decoder.Start();
+			decoder.BitSyncProcessFlags();
+			decoder.SetReadingFrame();
+			for ( U32 b=0; b < bytes; ++b )
+			{
+				U8 value = 0;
+				for ( U32 i=0; i < 8; )
+				{
+					i += decoder.BitSyncReadBits ( 8 - i, i, value );
+				}
+			}
+			BenchWork work = { bits, bytes, 0 };
+			return work;
+		} );
+	}
+
+	if ( Selected ( "BitSyncReadByte" ) )
+	{
+		Measure ( "BitSyncReadByte", bitRate, oversampling, [&]() -> BenchWork
+		{
+			BitbusEdgeChannel channel ( line.GetInitialState(), edges.data(), edges.size(), line.GetEndSample() );
+			NullSink sink;
+			KernelDecoder decoder ( settings, sink );
+			decoder.Setup ( &channel, sampleRate );
+			decoder.Start();
+			decoder.BitSyncProcessFlags();
+			decoder.SetReadingFrame();
+			for ( U32 b=0; b < bytes; ++b )
+			{
+				decoder.BitSyncReadByte();
+			}
+			BenchWork work = { bits, bytes, 0 };
+			return work;
+		} );
+	}
+
+	// The flag and abort checks look at one edge interval each: run them at
+	// every interval of the payload (AbortComing) or of a fill flag stream
+	if ( Selected ( "AbortComing" ) )
+	{
+		Measure ( "AbortComing", bitRate, oversampling, [&]() -> BenchWork
+		{
+			BitbusEdgeChannel channel ( line.GetInitialState(), edges.data(), edges.size(), line.GetEndSample() );
+			NullSink sink;
+			KernelDecoder decoder ( settings, sink );
+			decoder.Setup ( &channel, sampleRate );
+			decoder.Start();
+			for ( U64 i=0; i + 1 < edges.size(); ++i )
+			{
+				sKernelResults += decoder.AbortComing() ? 1 : 0;
+				decoder.BitSyncSkipInterval();
+			}
+			BenchWork work = { LineBits ( line, oversampling ), 0, 0 };
+			return work;
+		} );
+	}
+
+	if ( Selected ( "FlagComing" ) )
+	{
+		BitbusLineEncoder flagLine ( settings, oversampling );
+		flagLine.AddIdle ( 16 );
+		flagLine.AddFlags ( BENCH_PAYLOAD_BYTES );
+		flagLine.AddIdle ( 16 );
+		const vector<U64> & flagEdges = flagLine.GetEdges();
+
+		Measure ( "FlagComing", bitRate, oversampling, [&]() -> BenchWork
+		{
+			BitbusEdgeChannel channel ( flagLine.GetInitialState(), flagEdges.data(), flagEdges.size(), flagLine.GetEndSample() );
+			NullSink sink;
+			KernelDecoder decoder ( settings, sink );
+			decoder.Setup ( &channel, sampleRate );
+			decoder.Start();
+			for ( U64 i=0; i + 1 < flagEdges.size(); ++i )
+			{
+				sKernelResults += decoder.FlagComing() ? 1 : 0;
+				decoder.BitSyncSkipInterval();
+			}
+			BenchWork work = { LineBits ( flagLine, oversampling ), 0, 0 };
+			return work;
+		} );
+	}
+
+	// Resynchronisation: noise of 1 to 5 bit intervals, no flag in it, hunted
+	// through from Start() to the end of the data
+	if ( Selected ( "FlagHunt" ) )
+	{
+		vector<U64> noiseEdges;
+		U64 sample = 16 * oversampling;
+		for ( U32 i=0; i < BENCH_PAYLOAD_BYTES * 2; ++i )
+		{
+			sample += ( 1 + RandomByte() % 5 ) * oversampling;
+			noiseEdges.push_back ( sample );
+		}
+		const U64 noiseEnd = sample + 16 * oversampling;
+
+		Measure ( "FlagHunt", bitRate, oversampling, [&]() -> BenchWork
+		{
+			BitbusEdgeChannel channel ( BIT_HIGH, noiseEdges.data(), noiseEdges.size(), noiseEnd );
+			NullSink sink;
+			KernelDecoder decoder ( settings, sink );
+			decoder.Setup ( &channel, sampleRate );
+			try
+			{
+				decoder.Start();
+				for ( ; ; )
+				{
+					decoder.ProcessBITBUSFrame();
+				}
+			}
+			catch ( BitbusEndOfData & )
+			{
+			}
+			sKernelResults += decoder.GetHuntStats().mEdgesSkipped;
+			BenchWork work = { noiseEnd / oversampling, 0, 0 };
+			return work;
+		} );
+	}
+}
+
+static void BenchByteAsync ( U32 bitRate, U32 oversampling )
+{
+	if ( !Selected ( "ByteAsyncDecodeByte" ) )
+	{
+		return;
+	}
+
+	BitbusDecoderSettings settings;
+	settings.mBitRate = bitRate;
+	settings.mTransmissionMode = BITBUS_TRANSMISSION_BYTE_ASYNC;
+	const U32 sampleRate = bitRate * oversampling;
+
+	BitbusLineEncoder line ( settings, oversampling );
+	vector<U8> payload;
+	EncodePayload ( line, payload );
+	const vector<U64> & edges = line.GetEdges();
+	// Every character on the line: flags, escapes, payload and FCS
+	const U64 characters = ( line.GetEndSample() / oversampling - 32 ) / 10;
+
+	Measure ( "ByteAsyncDecodeByte", bitRate, oversampling, [&]() -> BenchWork
+	{
+		BitbusEdgeChannel channel ( line.GetInitialState(), edges.data(), edges.size(), line.GetEndSample() );
+		NullSink sink;
+		KernelDecoder decoder ( settings, sink );
+		decoder.Setup ( &channel, sampleRate );
+		decoder.Start();
+		for ( U64 i=0; i < characters; ++i )
+		{
+			decoder.ByteAsyncDecodeByte();
+		}
+		BenchWork work = { characters * 10, characters, 0 };
+		return work;
+	} );
+}
+
+// Whole frames through ProcessBITBUSFrame, for reference
+static void BenchFrames ( BitbusTransmissionModeType mode, const char* kernel, U32 bitRate, U32 oversampling )
+{
+	if ( !Selected ( kernel ) )
+	{
+		return;
+	}
+
+	BitbusDecoderSettings settings;
+	settings.mBitRate = bitRate;
+	settings.mTransmissionMode = mode;
+	const U32 sampleRate = bitRate * oversampling;
+
+	BitbusLineEncoder line ( settings, oversampling );
+	U8 frame[ 2 + BENCH_FRAME_INFO_BYTES ];
+	line.AddIdle ( 16 );
+	line.AddFlags ( 2 );
+	for ( U32 f=0; f < BENCH_FRAMES; ++f )
+	{
+		for ( U32 i=0; i < sizeof ( frame ); ++i )
+		{
+			frame[ i ] = RandomByte();
+		}
+		line.AddFrame ( frame, sizeof ( frame ) );
+		line.AddFlags ( 1 );
+	}
+	line.AddIdle ( 16 );
+	const vector<U64> & edges = line.GetEdges();
+
+	Measure ( kernel, bitRate, oversampling, [&]() -> BenchWork
+	{
+		BitbusEdgeChannel channel ( line.GetInitialState(), edges.data(), edges.size(), line.GetEndSample() );
+		NullSink sink;
+		KernelDecoder decoder ( settings, sink );
+		decoder.Setup ( &channel, sampleRate );
+		decoder.Start();
+		for ( U32 f=0; f < BENCH_FRAMES; ++f )
+		{
+			decoder.ProcessBITBUSFrame();
+		}
+		sDecodeErrors += sink.mFcsErrors;
+		BenchWork work = { LineBits ( line, oversampling ), U64 ( BENCH_FRAMES ) * sizeof ( frame ), BENCH_FRAMES };
+		return work;
+	} );
+}
+
+static void BenchCrc16()
+{
+	vector<U8> data ( BENCH_PAYLOAD_BYTES );
+	for ( U32 i=0; i < data.size(); ++i )
+	{
+		data[ i ] = RandomByte();
+	}
+	if ( Selected ( "Crc16" ) )
+	{
+		Measure ( "Crc16", 0, 0, [&]() -> BenchWork
+		{
+			sKernelResults = BitbusCrc16::Compute ( data.data(), data.size() );
+			BenchWork work = { U64 ( data.size() ) * 8, data.size(), 0 };
+			return work;
+		} );
+	}
+
+	// Byte at a time, as the decoder feeds it
+	if ( Selected ( "Crc16 RunningFcs" ) )
+	{
+		Measure ( "Crc16 RunningFcs", 0, 0, [&]() -> BenchWork
+		{
+			BitbusRunningFcs fcs;
+			fcs.Reset ( BITBUS_FCS_CRC16 );
+			for ( U32 i=0; i < data.size(); ++i )
+			{
+				fcs.AddByte ( data[ i ] );
+			}
+			sKernelResults = fcs.CalculatedFcs();
+			BenchWork work = { U64 ( data.size() ) * 8, data.size(), 0 };
+			return work;
+		} );
+	}
+}
+
+static void BenchBubbleText()
+{
+	if ( !Selected ( "GenBubbleText" ) )
+	{
+		return;
+	}
+
+	BitbusDecoderSettings settings;
+	vector<BitbusFrame> fields;
+	const U8 types[] = { BITBUS_FIELD_FLAG, BITBUS_FIELD_SOH, BITBUS_FIELD_ADDRESS, BITBUS_FIELD_INFORMATION,
+	                     BITBUS_FIELD_INFORMATION, BITBUS_FIELD_INFORMATION, BITBUS_FIELD_FCS, BITBUS_FIELD_FLAG };
+	for ( U32 i=0; i < 4096; ++i )
+	{
+		BitbusFrame field = { U64 ( i ) * 160, U64 ( i ) * 160 + 150, RandomByte(), i % 32, types[ i % sizeof ( types ) ], 0 };
+		if ( ( i % 16 ) == 3 )
+		{
+			field.mFlags = BITBUS_ESCAPED_BYTE;
+		}
+		fields.push_back ( field );
+	}
+
+	BitbusFieldText<NullText> text ( settings, &BitbusGetNumberString );
+	Measure ( "GenBubbleText", 0, 0, [&]() -> BenchWork
+	{
+		NullText out;
+		for ( U32 i=0; i < fields.size(); ++i )
+		{
+			text.Generate ( out, fields[ i ], Hexadecimal, false );
+		}
+		// Frames here are bubbles, one per field
+		BenchWork work = { 0, out.mChars, fields.size() };
+		return work;
+	} );
+
+	// Redrawing the same fields: all but the first pass are replayed
+	BitbusFieldText< BitbusTextCache<NullText> > cachedText ( settings, &BitbusGetNumberString );
+	BitbusTextCache<NullText> cache;
+	Measure ( "GenBubbleText cached", 0, 0, [&]() -> BenchWork
+	{
+		NullText out;
+		for ( U32 i=0; i < BITBUS_TEXT_CACHE_ENTRIES; ++i )
+		{
+			if ( !cache.Replay ( out, i, Hexadecimal, false ) )
+			{
+				cache.StartEntry ( out, i, Hexadecimal, false );
+				cachedText.Generate ( cache, fields[ i ], Hexadecimal, false );
+			}
+		}
+		BenchWork work = { 0, out.mChars, BITBUS_TEXT_CACHE_ENTRIES };
+		return work;
+	} );
+}
+
+// Decoded fields as the export reads them
+class BenchExportFrames
+{
+public:
+	explicit BenchExportFrames ( const vector<BitbusFrame> & fields ) : mFields ( fields ) {}
+
+	bool HasFrame ( U64 index )
+	{
+		return index < mFields.size();
+	}
+
+	BitbusFrame GetFrame ( U64 index )
+	{
+		return mFields[ index ];
+	}
+
+	bool UpdateExportProgressAndCheckForCancel ( U64 )
+	{
+		return false;
+	}
+
+protected:
+	const vector<BitbusFrame> & mFields;
+};
+
+// The text/csv export of decoded frames to /dev/null, so writes are timed too
+static void BenchCsvExport()
+{
+	if ( !Selected ( "CsvExport" ) )
+	{
+		return;
+	}
+
+	BitbusDecoderSettings settings;
+	settings.mBitbusAddressingMode = BITBUS_ADDRESS_EXTENDED;
+
+	vector<BitbusFrame> fields;
+	U64 sample = 0;
+	for ( U32 f=0; f < BENCH_FRAMES * 64; ++f )
+	{
+		// Start flag, address, information, FCS, end flag
+		vector<U8> types ( 2 + BENCH_FRAME_INFO_BYTES + 2, BITBUS_FIELD_INFORMATION );
+		types.front() = BITBUS_FIELD_FLAG;
+		types[ 1 ] = BITBUS_FIELD_ADDRESS;
+		types[ types.size() - 2 ] = BITBUS_FIELD_FCS;
+		types.back() = BITBUS_FIELD_FLAG;
+		for ( U32 i=0; i < types.size(); ++i, sample += 160 )
+		{
+			U8 data = ( types[ i ] == BITBUS_FIELD_ADDRESS ) ? 0x10 : RandomByte();
+			BitbusFrame field = { sample, sample + 150, data, i, types[ i ], 0 };
+			fields.push_back ( field );
+		}
+	}
+
+	// Formatting threads: 1 is the serial export
+	const DisplayBase bases[] = { Hexadecimal, Decimal };
+	const char* baseNames[] = { "hex", "dec" };
+	const U32 threads[] = { 1, 2, 4, 8 };
+	for ( U32 b=0; b < 2; ++b )
+	{
+		for ( U32 t=0; t < sizeof ( threads ) / sizeof ( threads[ 0 ] ); ++t )
+		{
+			char kernel[ 32 ];
+			snprintf ( kernel, sizeof ( kernel ), "CsvExport %s %uT", baseNames[ b ], threads[ t ] );
+			Measure ( kernel, 0, 0, [&]() -> BenchWork
+			{
+				ofstream out ( "/dev/null", ios::out );
+				BenchExportFrames frames ( fields );
+				BitbusWriteCsvExportParallel ( out, frames, settings, bases[ b ], 0, 10000000,
+				                               &BitbusGetNumberString, &BitbusGetTimeString, threads[ t ] );
+				BenchWork work = { 0, U64 ( BENCH_FRAMES ) * 64 * BENCH_FRAME_INFO_BYTES, BENCH_FRAMES * 64 };
+				return work;
+			} );
+		}
+	}
+}
+
+// The simulator's line, counting what it is sent
+struct CountingLine
+{
+	CountingLine() : mSample ( 0 ), mTransitions ( 0 ) {}
+
+	void Transition()
+	{
+		mTransitions++;
+	}
+
+	void Advance ( U32 samples )
+	{
+		mSample += samples;
+	}
+
+	U64 mSample;
+	U64 mTransitions;
+};
+
+// Waveform synthesis from the byte tables, as the simulator sends frames
+static void BenchWaveform()
+{
+	vector<U8> data ( BENCH_PAYLOAD_BYTES );
+	for ( U32 i=0; i < data.size(); ++i )
+	{
+		data[ i ] = RandomByte();
+	}
+	const BitbusWaveformTables & tables = BitbusWaveformTables::Get();
+	const U32 oversampling = 16;
+
+	if ( Selected ( "Waveform NRZI" ) )
+	{
+		Measure ( "Waveform NRZI", 0, 0, [&]() -> BenchWork
+		{
+			CountingLine line;
+			U32 ones = 0;
+			for ( U32 i=0; i < data.size(); ++i )
+			{
+				ones = BitbusSendSyncByte ( line, tables, data[ i ], ones, oversampling );
+			}
+			sKernelResults += line.mTransitions;
+			BenchWork work = { line.mSample / oversampling, data.size(), 0 };
+			return work;
+		} );
+	}
+
+	if ( Selected ( "Waveform async" ) )
+	{
+		Measure ( "Waveform async", 0, 0, [&]() -> BenchWork
+		{
+			CountingLine line;
+			for ( U32 i=0; i < data.size(); ++i )
+			{
+				BitbusSendAsyncByte ( line, tables, data[ i ], oversampling );
+			}
+			sKernelResults += line.mTransitions;
+			BenchWork work = { line.mSample / oversampling, data.size(), 0 };
+			return work;
+		} );
+	}
+}
+
+int main ( int argc, char** argv )
+{
+	if ( argc > 1 )
+	{
+		sFilter = argv[ 1 ];
+	}
+
+	const U32 bitRates[] = { 62500, 375000, 2400000 };
+	const U32 oversampling[] = { 4, 10, 25, 100 };
+
+	PrintHeader();
+	for ( U32 r=0; r < sizeof ( bitRates ) / sizeof ( bitRates[ 0 ] ); ++r )
+	{
+		for ( U32 o=0; o < sizeof ( oversampling ) / sizeof ( oversampling[ 0 ] ); ++o )
+		{
+			BenchBitSync ( bitRates[ r ], oversampling[ o ] );
+			BenchByteAsync ( bitRates[ r ], oversampling[ o ] );
+			BenchFrames ( BITBUS_TRANSMISSION_BIT_SYNC, "Frames NRZI", bitRates[ r ], oversampling[ o ] );
+			BenchFrames ( BITBUS_TRANSMISSION_BYTE_ASYNC, "Frames async", bitRates[ r ], oversampling[ o ] );
+		}
+	}
+	BenchCrc16();
+	BenchBubbleText();
+	BenchCsvExport();
+	BenchWaveform();
+
+	if ( sDecodeErrors != 0 )
+	{
+		printf ( "WARNING: %llu FCS errors decoding clean frame streams\n", sDecodeErrors );
+		return 1;
+	}
+	return 0;
+}
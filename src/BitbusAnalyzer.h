@@ -4,14 +4,31 @@
 #include <Analyzer.h>
 #include "BitbusAnalyzerResults.h"
 #include "BitbusSimulationDataGenerator.h"
-
-struct BitbusByte
-{
-	U64 startSample;
-	U64 endSample;
-	U8 value;
-	bool escaped;
-};
+#include "BitbusDecoder.h"
+#include "BitbusEdgeChannel.h"
+#include "BitbusFrameRecord.h"
+#include <chrono>
+#include <mutex>
+
+// Results are committed in batches of decoded BITBUS frames. A batch is
+// closed when it holds BITBUS_COMMIT_MAX_FRAMES frames, spans
+// BITBUS_COMMIT_MAX_BITS bit times of signal, has been open for
+// BITBUS_COMMIT_MAX_MS milliseconds, or before the decoder waits for more
+// capture data. The frame bound starts at 1 and adapts between commits.
+#ifndef BITBUS_COMMIT_MAX_FRAMES
+#define BITBUS_COMMIT_MAX_FRAMES 256
+#endif
+#ifndef BITBUS_COMMIT_MAX_BITS
+#define BITBUS_COMMIT_MAX_BITS 65536
+#endif
+#ifndef BITBUS_COMMIT_MAX_MS
+#define BITBUS_COMMIT_MAX_MS 50
+#endif
+// Edges read from the capture at a time: the decoder only asks whether
+// more have been captured once it has used them up
+#ifndef BITBUS_READ_AHEAD_EDGES
+#define BITBUS_READ_AHEAD_EDGES 4096
+#endif
 
 class BitbusAnalyzerSettings;
 class ANALYZER_EXPORT BitbusAnalyzer : public Analyzer2
@@ -29,70 +46,57 @@ public:
 
         virtual void SetupResults();
 
+	// Counters of the last run, or of the one going on as of its last
+	// commit; safe to call from any thread
+	BitbusDecodeStats GetDecodeStats() const;
+
+	// Decoder sink: results go to the SDK
+	void AddDecodedFrame ( const BitbusFrame & frame );
+	void AddDecodedMarker ( U64 sample, BitbusMarkerType type );
+	void BeforeChannelRead();
+	// mRecordOutput sink: the FrameV2 of a field (Fields output mode) or
+	// of a BITBUS frame (the output modes with frame records)
+	void AddFieldRecord ( const BitbusFrame & field );
+	void AddFrameRecord ( const BitbusFrameRecord & record );
+
 protected:
 
 	void SetupAnalyzer();
+	// Bit rate from the edges read ahead, for this run only
+	U32 DetectBitRate();
 
-	// Functions to read and process a BITBUS frame
-	void ProcessBITBUSFrame();
-	BitbusByte ProcessFlags();
-	void ProcessAddressField ( BitbusByte byteAfterFlag );
-	void ProcessInfoAndFcsField();
-	vector<BitbusByte> ReadProcessAndFcsField();
-	void InfoAndFcsField ( const vector<BitbusByte> & informationAndFcs );
-	void ProcessInformationField ( const vector<BitbusByte> & information );
-	void ProcessFcsField ( const vector<BitbusByte> & fcs );
-	BitbusByte ReadByte();
-
-	// Bit Sync Transmission functions
-	void BitSyncProcessFlags();
-	BitState BitSyncReadBit();
-	BitbusByte BitSyncReadByte();
-	BitbusByte BitSyncProcessFirstByteAfterFlag ( BitbusByte firstAddressByte );
-	bool FlagComing();
-        bool AbortComing();
-	// Byte Async Transmission functions
-	BitbusByte ByteAsyncProcessFlags();
-	void GenerateFlagsFrames ( vector<BitbusByte> readBytes ) ;
-	BitbusByte ByteAsyncReadByte();
-	BitbusByte ByteAsyncReadByte_();
-        bool IsNRZ();
-        bool IsBitSync();
-	// Helper functions
-	Frame CreateFrame ( U8 mType, U64 mStartingSampleInclusive, U64 mEndingSampleInclusive,
-	                    U64 mData1=0, U64 mData2=0, U8 mFlags=0 ) const;
-	vector<U8> BitbusBytesToVectorBytes ( const vector<BitbusByte> & asyncBytes ) const;
-	U64 VectorToValue ( const vector<U8> & v ) const;
-
-	void AddFrameToResults ( const Frame & frame );
-	void CommitFrames();
+	// Batched CommitResults/ReportProgress
+	void StartCommitBatch();
+	bool CommitBatchDue();
+	void CommitBatch();
+	void PublishDecodeStats();
+	// Each BITBUS frame, start flag to end flag or abort, is an SDK packet
+	void CommitPacket();
 
 protected:
 
 	std::auto_ptr< BitbusAnalyzerSettings > mSettings;
 	std::auto_ptr< BitbusAnalyzerResults > mResults;
 	AnalyzerChannelData* mBitbus;
-
-	U32 mSampleRateHz;
-	U64 mSamplesInHalfPeriod;
-	U64 mSamplesInAFlag;
-	U64 mSamplesInAbort;
-	U32 mSamplesIn8Bits;
-
-	vector<U8> mCurrentFrameBytes;
-
-        BitState mPreviousBitState;
-        BitState mPreviousLineBitState;
-
-	U32 mConsecutiveOnes;
-	bool mReadingFrame;
-	bool mAbortFrame;
-	bool mFoundEndFlag;
-
-	Frame mEndFlagFrame;
-	Frame mAbtFrame;
-
-	vector<Frame> mResultFrames;
+	// mBitbus, its edges read ahead in blocks
+	BitbusReadAheadChannel< AnalyzerChannelData > mChannel;
+	// mChannel as the decoder reads it, its calls counted
+	BitbusCountingChannel< BitbusReadAheadChannel< AnalyzerChannelData > > mCountingChannel;
+
+	BitbusDecoder< BitbusCountingChannel< BitbusReadAheadChannel< AnalyzerChannelData > >, BitbusAnalyzer > mDecoder;
+
+	U32 mCommitBatchLimit;
+	U32 mFramesInBatch;
+	U64 mBatchStartSample;
+	U64 mSamplesInCommitSpan;
+	std::chrono::steady_clock::time_point mBatchStartTime;
+	U64 mCommitCount;
+	U64 mCommittedFrameCount;
+	U64 mCommitNanoseconds;
+	mutable std::mutex mStatsMutex;
+	BitbusDecodeStats mPublishedStats; // under mStatsMutex
+	U32 mFieldsInPacket;
+	BitbusRecordOutput mRecordOutput;
 
 	BitbusSimulationDataGenerator mSimulationDataGenerator;
 	bool mSimulationInitilized;
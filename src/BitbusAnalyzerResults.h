@@ -2,6 +2,11 @@
 #define BITBUS_ANALYZER_RESULTS
 
 #include <AnalyzerResults.h>
+#include "BitbusFieldText.h"
+#include "BitbusPacketIndex.h"
+#include "BitbusPacketText.h"
+#include "BitbusTextCache.h"
+#include <mutex>
 #include <string>
 
 using namespace std;
@@ -22,23 +27,19 @@ public:
 	virtual void GeneratePacketTabularText ( U64 packet_id, DisplayBase display_base );
 	virtual void GenerateTransactionTabularText ( U64 transaction_id, DisplayBase display_base );
 
+	// Filled in by the analyzer as it decodes
+	BitbusPacketIndex & GetPacketIndex();
+
 protected: //functions
 	void GenBubbleText ( U64 frame_index, DisplayBase display_base, bool tabular );
-
-	void GenFlagFieldString ( const Frame & frame, bool tabular );
-	void GenAddressFieldString ( const Frame & frame, DisplayBase display_base, bool tabular );
-	void GenSOHFieldString ( const Frame & frame, DisplayBase display_base, bool tabular );
-	void GenInformationFieldString ( const Frame & frame, DisplayBase display_base, bool tabular );
-	void GenFcsFieldString ( const Frame & frame, DisplayBase display_base, bool tabular );
-	void GenReservedFieldString ( const Frame & frame, DisplayBase display_base, bool tabular );
-        void GenAbortFieldString (bool tabular );
-
-	string EscapeByteStr ( const Frame & frame );
-	string GenEscapedString ( const Frame & frame );
-        string genNumberInfo( const Frame &frame );
 protected:  //vars
 	BitbusAnalyzerSettings* mSettings;
 	BitbusAnalyzer* mAnalyzer;
+	BitbusFieldText< BitbusTextCache<BitbusAnalyzerResults> > mFieldText;
+	BitbusTextCache<BitbusAnalyzerResults> mTextCache;
+	mutex mTextLock;
+	BitbusPacketText<BitbusAnalyzerResults> mPacketText;
+	BitbusPacketIndex mPacketIndex;
 };
 
 #endif //BITBUS_ANALYZER_RESULTS
@@ -3,9 +3,9 @@
 
 BitbusAnalyzerSettings::BitbusAnalyzerSettings():
 	mInputChannel ( UNDEFINED_CHANNEL ),
-	mBitRate ( 62500 ),
-	mTransmissionMode ( BITBUS_TRANSMISSION_BIT_SYNC ),
-	mBitbusAddressingMode ( BITBUS_ADDRESS_SOF )
+	mDetectBitRate ( false ),
+	mSimulationTraffic ( BITBUS_TRAFFIC_FIXED ),
+	mOutputMode ( BITBUS_OUTPUT_FIELDS )
 {
 	mInputChannelInterface.reset ( new AnalyzerSettingInterfaceChannel() );
 	mInputChannelInterface->SetTitleAndTooltip ( "BITBUS", "Pioneer BitBus" );
@@ -17,6 +17,11 @@ BitbusAnalyzerSettings::BitbusAnalyzerSettings():
 	mBitRateInterface->SetMin ( 1 );
 	mBitRateInterface->SetInteger ( mBitRate );
 
+	mDetectBitRateInterface.reset ( new AnalyzerSettingInterfaceBool() );
+	mDetectBitRateInterface->SetTitleAndTooltip ( "Detect Bit Rate", "Measure the bit rate from the first edges of the capture; the one above is used if too few edges tell" );
+	mDetectBitRateInterface->SetCheckBoxText ( "Automatic" );
+	mDetectBitRateInterface->SetValue ( mDetectBitRate );
+
 	mBitbusTransmissionInterface.reset ( new AnalyzerSettingInterfaceNumberList() );
 	mBitbusTransmissionInterface->SetTitleAndTooltip ( "Transmission Mode", "Specify the transmission mode of the BITBUS frames" );
 	mBitbusTransmissionInterface->AddNumber ( BITBUS_TRANSMISSION_BIT_SYNC, "NRZI Bit Synchronous", "Bit-oriented transmission using bit stuffing and NRZI line encoding" );
@@ -31,14 +36,43 @@ BitbusAnalyzerSettings::BitbusAnalyzerSettings():
 	mBitbusAddressingModeInterface->AddNumber ( BITBUS_ADDRESS_EXTENDED, "Extended", "Extended Address Field (16 bits)" );
 	mBitbusAddressingModeInterface->SetNumber ( mBitbusAddressingMode );
 
+	mFcsTypeInterface.reset ( new AnalyzerSettingInterfaceNumberList() );
+	mFcsTypeInterface->SetTitleAndTooltip ( "FCS", "Specify the width of the frame check sequence" );
+	mFcsTypeInterface->AddNumber ( BITBUS_FCS_CRC16, "CRC-16", "16-bit FCS (CRC-16/X.25), the BITBUS default" );
+	mFcsTypeInterface->AddNumber ( BITBUS_FCS_CRC32, "CRC-32", "32-bit HDLC FCS" );
+	mFcsTypeInterface->SetNumber ( mFcsType );
+
+	mSimulationTrafficInterface.reset ( new AnalyzerSettingInterfaceNumberList() );
+	mSimulationTrafficInterface->SetTitleAndTooltip ( "Simulation Traffic", "Specify the frames the simulation sends" );
+	mSimulationTrafficInterface->AddNumber ( BITBUS_TRAFFIC_FIXED, "Fixed", "The same empty frame, the address counting up" );
+	mSimulationTrafficInterface->AddNumber ( BITBUS_TRAFFIC_MIXED, "Mixed", "0 to 64 information bytes, a few addresses, varied gaps" );
+	mSimulationTrafficInterface->AddNumber ( BITBUS_TRAFFIC_STUFFING, "Stuffing", "Long frames of bytes that all need bit or byte stuffing" );
+	mSimulationTrafficInterface->AddNumber ( BITBUS_TRAFFIC_FAULTS, "Faults", "Mixed, with aborted frames and FCS errors" );
+	mSimulationTrafficInterface->SetNumber ( mSimulationTraffic );
+
+	mOutputModeInterface.reset ( new AnalyzerSettingInterfaceNumberList() );
+	mOutputModeInterface->SetTitleAndTooltip ( "Output", "Specify the results: one per field, and/or one record per BITBUS frame" );
+	mOutputModeInterface->AddNumber ( BITBUS_OUTPUT_FIELDS, "Fields", "A frame and a FrameV2 record per flag, address, information byte, FCS and abort" );
+	mOutputModeInterface->AddNumber ( BITBUS_OUTPUT_FIELDS_AND_RECORDS, "Fields and frame records",
+	                                  "Fields, and a FrameV2 record per BITBUS frame: address, payload, FCS and errors" );
+	mOutputModeInterface->AddNumber ( BITBUS_OUTPUT_RECORDS, "Frame records, no information bytes",
+	                                  "Frame records, and fields but for the information bytes: the payload is in the record only" );
+	mOutputModeInterface->SetNumber ( mOutputMode );
+
 	AddInterface ( mInputChannelInterface.get() );
 	AddInterface ( mBitRateInterface.get() );
+	AddInterface ( mDetectBitRateInterface.get() );
 	AddInterface ( mBitbusTransmissionInterface.get() );
 	AddInterface ( mBitbusAddressingModeInterface.get() );
+	AddInterface ( mFcsTypeInterface.get() );
+	AddInterface ( mSimulationTrafficInterface.get() );
+	AddInterface ( mOutputModeInterface.get() );
 
-	AddExportOption ( 0, "Export as text/csv file" );
-	AddExportExtension ( 0, "text", "txt" );
-	AddExportExtension ( 0, "csv", "csv" );
+	AddExportOption ( BITBUS_EXPORT_CSV, "Export as text/csv file" );
+	AddExportExtension ( BITBUS_EXPORT_CSV, "text", "txt" );
+	AddExportExtension ( BITBUS_EXPORT_CSV, "csv", "csv" );
+	AddExportOption ( BITBUS_EXPORT_STATS, "Export decode counters (csv)" );
+	AddExportExtension ( BITBUS_EXPORT_STATS, "csv", "csv" );
 
 	ClearChannels();
 	AddChannel ( mInputChannel, "BITBUS", false );
@@ -48,17 +82,16 @@ BitbusAnalyzerSettings::~BitbusAnalyzerSettings()
 {
 }
 
-U8 BitbusAnalyzerSettings::Bit5Inv ( U8 value )
-{
-	return value ^ 0x20;
-}
-
 bool BitbusAnalyzerSettings::SetSettingsFromInterfaces()
 {
 	mInputChannel = mInputChannelInterface->GetChannel();
 	mBitRate = mBitRateInterface->GetInteger();
+	mDetectBitRate = mDetectBitRateInterface->GetValue();
 	mTransmissionMode = BitbusTransmissionModeType ( U32 ( mBitbusTransmissionInterface->GetNumber() ) );
 	mBitbusAddressingMode = BitbusAddressingMode ( U32 ( mBitbusAddressingModeInterface->GetNumber() ) );
+	mFcsType = BitbusFcsType ( U32 ( mFcsTypeInterface->GetNumber() ) );
+	mSimulationTraffic = BitbusTrafficType ( U32 ( mSimulationTrafficInterface->GetNumber() ) );
+	mOutputMode = BitbusOutputMode ( U32 ( mOutputModeInterface->GetNumber() ) );
 
 	ClearChannels();
 	AddChannel ( mInputChannel, "BITBUS", true );
@@ -70,8 +103,12 @@ void BitbusAnalyzerSettings::UpdateInterfacesFromSettings()
 {
 	mInputChannelInterface->SetChannel ( mInputChannel );
 	mBitRateInterface->SetInteger ( mBitRate );
+	mDetectBitRateInterface->SetValue ( mDetectBitRate );
 	mBitbusTransmissionInterface->SetNumber ( mTransmissionMode );
 	mBitbusAddressingModeInterface->SetNumber ( mBitbusAddressingMode );
+	mFcsTypeInterface->SetNumber ( mFcsType );
+	mSimulationTrafficInterface->SetNumber ( mSimulationTraffic );
+	mOutputModeInterface->SetNumber ( mOutputMode );
 }
 
 void BitbusAnalyzerSettings::LoadSettings ( const char* settings )
@@ -83,6 +120,23 @@ void BitbusAnalyzerSettings::LoadSettings ( const char* settings )
 	text_archive >> mBitRate;
 	text_archive >> * ( U32* ) &mTransmissionMode;
 	text_archive >> * ( U32* ) &mBitbusAddressingMode;
+	// Settings saved before the FCS option existed are CRC-16
+	if ( !( text_archive >> * ( U32* ) &mFcsType ) )
+	{
+		mFcsType = BITBUS_FCS_CRC16;
+	}
+	if ( !( text_archive >> * ( U32* ) &mSimulationTraffic ) )
+	{
+		mSimulationTraffic = BITBUS_TRAFFIC_FIXED;
+	}
+	if ( !( text_archive >> mDetectBitRate ) )
+	{
+		mDetectBitRate = false;
+	}
+	if ( !( text_archive >> * ( U32* ) &mOutputMode ) )
+	{
+		mOutputMode = BITBUS_OUTPUT_FIELDS;
+	}
 
 	ClearChannels();
 	AddChannel ( mInputChannel, "BITBUS", true );
@@ -98,6 +152,10 @@ const char* BitbusAnalyzerSettings::SaveSettings()
 	text_archive << mBitRate;
 	text_archive << U32 ( mTransmissionMode );
 	text_archive << U32 ( mBitbusAddressingMode );
+	text_archive << U32 ( mFcsType );
+	text_archive << U32 ( mSimulationTraffic );
+	text_archive << mDetectBitRate;
+	text_archive << U32 ( mOutputMode );
 
 	return SetReturnString ( text_archive.GetString() );
 }
@@ -0,0 +1,121 @@
+#include "BitbusBitRate.h"
+#include <algorithm>
+
+BitbusBitRateDetector::BitbusBitRateDetector ( U32 sampleRateHz )
+	:	mSampleRateHz ( sampleRateHz ), mLastEdge ( 0 ), mHasEdge ( false )
+{
+}
+
+void BitbusBitRateDetector::AddEdge ( U64 sample )
+{
+	if ( mHasEdge && ( sample > mLastEdge ) )
+	{
+		mIntervals.push_back ( sample - mLastEdge );
+	}
+	mLastEdge = sample;
+	mHasEdge = true;
+}
+
+U32 BitbusBitRateDetector::GetIntervalCount() const
+{
+	return U32 ( mIntervals.size() );
+}
+
+U32 BitbusBitRateDetector::GetBitRate() const
+{
+	if ( mIntervals.size() < BITBUS_AUTOBAUD_MIN_INTERVALS )
+	{
+		return 0;
+	}
+	vector<U64> sorted ( mIntervals );
+	sort ( sorted.begin(), sorted.end() );
+
+	U64 bitLength = Measure ( sorted, FindBitLength ( sorted ) );
+	// Shortest intervals of two bits: half of it fits much better
+	for ( U32 i=0; ( i < 3 ) && ( bitLength >= ( 2 << BITBUS_AUTOBAUD_FRACTION_BITS ) ); ++i )
+	{
+		if ( 2 * Misfit ( sorted, bitLength / 2 ) >= Misfit ( sorted, bitLength ) )
+		{
+			break;
+		}
+		bitLength = Measure ( sorted, bitLength / 2 );
+	}
+	if ( bitLength == 0 )
+	{
+		return 0;
+	}
+	return U32 ( ( ( U64 ( mSampleRateHz ) << BITBUS_AUTOBAUD_FRACTION_BITS ) + bitLength / 2 ) / bitLength );
+}
+
+// Mean of the shortest group of intervals below twice the first that holds
+// at least 1/64 of them (shorter ones are glitches), fixed point
+U64 BitbusBitRateDetector::FindBitLength ( const vector<U64> & sorted ) const
+{
+	const U64 minCount = max<U64> ( 4, sorted.size() / 64 );
+	for ( U32 i=0; i < sorted.size(); ++i )
+	{
+		U64 end = U64 ( lower_bound ( sorted.begin() + i, sorted.end(), 2 * sorted[ i ] ) - sorted.begin() );
+		if ( end - i >= minCount )
+		{
+			U64 samples = 0;
+			for ( U64 k=i; k < end; ++k )
+			{
+				samples += sorted[ k ];
+			}
+			return ( ( samples << BITBUS_AUTOBAUD_FRACTION_BITS ) + ( end - i ) / 2 ) / ( end - i );
+		}
+	}
+	return 0;
+}
+
+// The bit length over the intervals of up to 2, 4, then
+// BITBUS_AUTOBAUD_MAX_CELLS bits, counted with the length so far: a rough
+// one counts the short ones right
+U64 BitbusBitRateDetector::Measure ( const vector<U64> & sorted, U64 bitLength ) const
+{
+	for ( U32 pass=0; ( pass < 8 ) && ( bitLength != 0 ); ++pass )
+	{
+		const U64 maxCells = min<U64> ( U64 ( 2 ) << pass, BITBUS_AUTOBAUD_MAX_CELLS );
+		U64 samples = 0;
+		U64 cells = 0;
+		for ( U32 i=0; i < sorted.size(); ++i )
+		{
+			U64 intervalCells = ( ( sorted[ i ] << BITBUS_AUTOBAUD_FRACTION_BITS ) + bitLength / 2 ) / bitLength;
+			if ( intervalCells > maxCells )
+			{
+				break;
+			}
+			if ( intervalCells >= 1 )
+			{
+				samples += sorted[ i ];
+				cells += intervalCells;
+			}
+		}
+		if ( cells == 0 )
+		{
+			return 0;
+		}
+		U64 measured = ( ( samples << BITBUS_AUTOBAUD_FRACTION_BITS ) + cells / 2 ) / cells;
+		if ( ( measured == bitLength ) && ( maxCells == BITBUS_AUTOBAUD_MAX_CELLS ) )
+		{
+			break;
+		}
+		bitLength = measured;
+	}
+	return bitLength;
+}
+
+// Mean distance of the intervals of up to BITBUS_AUTOBAUD_MAX_CELLS bits
+// from a whole number of bits, in 1/256 bit
+U64 BitbusBitRateDetector::Misfit ( const vector<U64> & sorted, U64 bitLength ) const
+{
+	U64 measured = 0;
+	U64 misfit = 0;
+	for ( U32 i=0; ( i < sorted.size() ) && ( ( sorted[ i ] << BITBUS_AUTOBAUD_FRACTION_BITS ) <= bitLength * BITBUS_AUTOBAUD_MAX_CELLS ); ++i )
+	{
+		U64 halfCells = ( ( sorted[ i ] << ( BITBUS_AUTOBAUD_FRACTION_BITS + 8 ) ) / bitLength ) & 0xFF;
+		misfit += ( halfCells < 0x80 ) ? halfCells : 0x100 - halfCells;
+		measured++;
+	}
+	return ( measured > 0 ) ? misfit / measured : 0;
+}
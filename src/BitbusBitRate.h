@@ -0,0 +1,51 @@
+#ifndef BITBUS_BIT_RATE_H
+#define BITBUS_BIT_RATE_H
+
+#include "BitbusTypes.h"
+#include <vector>
+
+using namespace std;
+
+// Bit rate detection reads at most this many edges from the start of the
+// data, and needs this many intervals between them to go on
+#ifndef BITBUS_AUTOBAUD_MAX_EDGES
+#define BITBUS_AUTOBAUD_MAX_EDGES 4096
+#endif
+#define BITBUS_AUTOBAUD_MIN_INTERVALS 16
+// Longer intervals (idle line, aborts) are not measured, in bits
+#define BITBUS_AUTOBAUD_MAX_CELLS 8
+// Bit lengths are kept in fixed point: samples << this
+#define BITBUS_AUTOBAUD_FRACTION_BITS 16
+
+// Finds the bit rate of a line from the intervals between its edges, each
+// a whole number of bits in any transmission mode. The shortest intervals
+// that come up too often to be glitches are taken for one bit, the rate is
+// measured over all intervals of up to BITBUS_AUTOBAUD_MAX_CELLS bits, and
+// halved while half of it fits them much better.
+//
+// A line of nothing but flags does not tell: NRZI flags are 7 bits edge
+// to edge, NRZ ones 2 and 6 bits.
+class BitbusBitRateDetector
+{
+public:
+	explicit BitbusBitRateDetector ( U32 sampleRateHz );
+
+	// Edges in ascending order
+	void AddEdge ( U64 sample );
+	U32 GetIntervalCount() const;
+
+	// Bits per second, 0 if the edges do not tell
+	U32 GetBitRate() const;
+
+protected:
+	U64 FindBitLength ( const vector<U64> & sorted ) const;
+	U64 Measure ( const vector<U64> & sorted, U64 bitLength ) const;
+	U64 Misfit ( const vector<U64> & sorted, U64 bitLength ) const;
+
+	U32 mSampleRateHz;
+	vector<U64> mIntervals;
+	U64 mLastEdge;
+	bool mHasEdge;
+};
+
+#endif //BITBUS_BIT_RATE_H
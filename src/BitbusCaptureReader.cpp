@@ -0,0 +1,386 @@
+#include "BitbusCaptureReader.h"
+#include <stdlib.h>
+#include <string.h>
+
+BitbusCaptureReader::BitbusCaptureReader() :
+	mPendingEdge ( 0 ), mHasPendingEdge ( false ),
+	mFile ( 0 ), mInitialState ( BIT_LOW ), mSampleRate ( 0 ), mTriggerSample ( 0 ), mEndSample ( 0 )
+{
+}
+
+BitbusCaptureReader::~BitbusCaptureReader()
+{
+	if ( mFile != 0 )
+	{
+		fclose ( mFile );
+	}
+}
+
+bool BitbusCaptureReader::NextEdge ( U64 & sample )
+{
+	U64 edge;
+	while ( ReadEdge ( edge ) )
+	{
+		if ( !mHasPendingEdge )
+		{
+			mPendingEdge = edge;
+			mHasPendingEdge = true;
+		}
+		else if ( edge <= mPendingEdge ) // pulse shorter than a sample
+		{
+			mHasPendingEdge = false;
+		}
+		else
+		{
+			sample = mPendingEdge;
+			mPendingEdge = edge;
+			return true;
+		}
+	}
+
+	if ( mHasPendingEdge )
+	{
+		sample = mPendingEdge;
+		mHasPendingEdge = false;
+		return true;
+	}
+	return false;
+}
+
+BitState BitbusCaptureReader::GetInitialState() const
+{
+	return mInitialState;
+}
+
+U32 BitbusCaptureReader::GetSampleRate() const
+{
+	return mSampleRate;
+}
+
+U64 BitbusCaptureReader::GetTriggerSample() const
+{
+	return mTriggerSample;
+}
+
+U64 BitbusCaptureReader::GetEndSample() const
+{
+	return mEndSample;
+}
+
+//
+/////////////// SALEAE BINARY EXPORT ///////////////////////////////////////////////
+//
+
+#define SALEAE_BINARY_ID "<SALEAE>"
+#define SALEAE_BINARY_VERSION 0
+#define SALEAE_BINARY_DIGITAL 0
+#define SALEAE_BINARY_HEADER_SIZE 44
+
+BitbusSaleaeBinaryReader::BitbusSaleaeBinaryReader() :
+	mOrigin ( 0.0 ), mTransitionsLeft ( 0 ), mBuffered ( 0 ), mBufferPosition ( 0 )
+{
+}
+
+bool BitbusSaleaeBinaryReader::IsSaleaeBinary ( const char* path )
+{
+	FILE* file = fopen ( path, "rb" );
+	if ( file == 0 )
+	{
+		return false;
+	}
+	char id[ 8 ];
+	bool isBinary = ( fread ( id, 1, sizeof ( id ), file ) == sizeof ( id ) ) && ( memcmp ( id, SALEAE_BINARY_ID, 8 ) == 0 );
+	fclose ( file );
+	return isBinary;
+}
+
+bool BitbusSaleaeBinaryReader::Open ( const char* path, U32 sampleRate, string & error )
+{
+	mFile = fopen ( path, "rb" );
+	if ( mFile == 0 )
+	{
+		error = string ( "cannot open " ) + path;
+		return false;
+	}
+
+	// The header fields are packed, little endian
+	char id[ 8 ];
+	S32 version;
+	S32 type;
+	U32 initialState;
+	double beginTime;
+	double endTime;
+	if ( ( fread ( id, 1, sizeof ( id ), mFile ) != sizeof ( id ) ) ||
+	     ( fread ( &version, sizeof ( version ), 1, mFile ) != 1 ) ||
+	     ( fread ( &type, sizeof ( type ), 1, mFile ) != 1 ) ||
+	     ( fread ( &initialState, sizeof ( initialState ), 1, mFile ) != 1 ) ||
+	     ( fread ( &beginTime, sizeof ( beginTime ), 1, mFile ) != 1 ) ||
+	     ( fread ( &endTime, sizeof ( endTime ), 1, mFile ) != 1 ) ||
+	     ( fread ( &mTransitionsLeft, sizeof ( mTransitionsLeft ), 1, mFile ) != 1 ) ||
+	     ( memcmp ( id, SALEAE_BINARY_ID, 8 ) != 0 ) )
+	{
+		error = string ( path ) + " is not a Saleae binary export";
+		return false;
+	}
+	if ( ( version != SALEAE_BINARY_VERSION ) || ( type != SALEAE_BINARY_DIGITAL ) )
+	{
+		error = string ( path ) + " is not a version 0 digital binary export";
+		return false;
+	}
+	if ( sampleRate == 0 )
+	{
+		error = "binary exports carry no sample rate, it has to be given";
+		return false;
+	}
+
+	// Sample 0 is the start of the capture, or the trigger if that comes first
+	mSampleRate = sampleRate;
+	mOrigin = ( beginTime < 0.0 ) ? beginTime : 0.0;
+	mInitialState = ( initialState != 0 ) ? BIT_HIGH : BIT_LOW;
+	mTriggerSample = ToSample ( 0.0 );
+	mEndSample = ToSample ( endTime );
+	return true;
+}
+
+U64 BitbusSaleaeBinaryReader::ToSample ( double seconds ) const
+{
+	return U64 ( ( seconds - mOrigin ) * double ( mSampleRate ) + 0.5 );
+}
+
+bool BitbusSaleaeBinaryReader::ReadEdge ( U64 & sample )
+{
+	if ( mBufferPosition == mBuffered )
+	{
+		if ( mTransitionsLeft == 0 )
+		{
+			return false;
+		}
+		U32 wanted = U32 ( ( mTransitionsLeft < 4096 ) ? mTransitionsLeft : 4096 );
+		mBuffered = U32 ( fread ( mBuffer, sizeof ( double ), wanted, mFile ) );
+		mBufferPosition = 0;
+		mTransitionsLeft = ( mBuffered == wanted ) ? mTransitionsLeft - mBuffered : 0; // truncated file: stop there
+		if ( mBuffered == 0 )
+		{
+			return false;
+		}
+	}
+
+	sample = ToSample ( mBuffer[ mBufferPosition++ ] );
+	return true;
+}
+
+BitbusSaleaeBinaryWriter::BitbusSaleaeBinaryWriter() :
+	mFile ( 0 ), mWriteError ( false ), mSampleRate ( 0 ), mInitialState ( BIT_LOW ),
+	mEdgeCount ( 0 ), mLastEdge ( 0 ), mBuffered ( 0 )
+{
+}
+
+BitbusSaleaeBinaryWriter::~BitbusSaleaeBinaryWriter()
+{
+	if ( mFile != 0 )
+	{
+		fclose ( mFile );
+	}
+}
+
+bool BitbusSaleaeBinaryWriter::Create ( const char* path, U32 sampleRate, BitState initialState, string & error )
+{
+	mFile = fopen ( path, "wb" );
+	if ( mFile == 0 )
+	{
+		error = string ( "cannot write " ) + path;
+		return false;
+	}
+
+	mSampleRate = sampleRate;
+	mInitialState = initialState;
+
+	// Placeholder until Close() knows the count
+	if ( !WriteHeader ( 0 ) )
+	{
+		error = string ( "cannot write " ) + path;
+		return false;
+	}
+	return true;
+}
+
+bool BitbusSaleaeBinaryWriter::AddEdge ( U64 sample )
+{
+	if ( ( mEdgeCount > 0 ) && ( sample <= mLastEdge ) )
+	{
+		return false;
+	}
+
+	mBuffer[ mBuffered++ ] = double ( sample ) / mSampleRate;
+	if ( mBuffered == sizeof ( mBuffer ) / sizeof ( mBuffer[ 0 ] ) )
+	{
+		Flush();
+	}
+	mLastEdge = sample;
+	mEdgeCount++;
+	return true;
+}
+
+void BitbusSaleaeBinaryWriter::Flush()
+{
+	mWriteError |= ( fwrite ( mBuffer, sizeof ( double ), mBuffered, mFile ) != mBuffered );
+	mBuffered = 0;
+}
+
+bool BitbusSaleaeBinaryWriter::Close ( U64 endSample )
+{
+	if ( mFile == 0 )
+	{
+		return false;
+	}
+
+	Flush();
+	bool ok = ( fseek ( mFile, 0, SEEK_SET ) == 0 ) && WriteHeader ( ( endSample > mLastEdge ) ? endSample : mLastEdge );
+	ok = ( fclose ( mFile ) == 0 ) && ok && !mWriteError;
+	mFile = 0;
+	return ok;
+}
+
+U64 BitbusSaleaeBinaryWriter::GetSize() const
+{
+	return SALEAE_BINARY_HEADER_SIZE + mEdgeCount * sizeof ( double );
+}
+
+// Packed, little endian, as the reader expects
+bool BitbusSaleaeBinaryWriter::WriteHeader ( U64 endSample )
+{
+	S32 version = SALEAE_BINARY_VERSION;
+	S32 type = SALEAE_BINARY_DIGITAL;
+	U32 initialState = ( mInitialState == BIT_HIGH ) ? 1 : 0;
+	double beginTime = 0.0;
+	double endTime = double ( endSample ) / mSampleRate;
+	return ( fwrite ( SALEAE_BINARY_ID, 1, 8, mFile ) == 8 ) &&
+	       ( fwrite ( &version, sizeof ( version ), 1, mFile ) == 1 ) &&
+	       ( fwrite ( &type, sizeof ( type ), 1, mFile ) == 1 ) &&
+	       ( fwrite ( &initialState, sizeof ( initialState ), 1, mFile ) == 1 ) &&
+	       ( fwrite ( &beginTime, sizeof ( beginTime ), 1, mFile ) == 1 ) &&
+	       ( fwrite ( &endTime, sizeof ( endTime ), 1, mFile ) == 1 ) &&
+	       ( fwrite ( &mEdgeCount, sizeof ( mEdgeCount ), 1, mFile ) == 1 );
+}
+
+//
+/////////////// EDGE LIST ///////////////////////////////////////////////
+//
+
+BitbusEdgeListReader::BitbusEdgeListReader() :
+	mFirstEdge ( 0 ), mHasFirstEdge ( false ), mLastEdge ( 0 ), mHasEndSample ( false )
+{
+}
+
+// Next line with something on it, comments and surrounding blanks removed
+bool BitbusEdgeListReader::ReadLine ( char* line, U32 size )
+{
+	while ( fgets ( line, int ( size ), mFile ) != 0 )
+	{
+		char* comment = strchr ( line, '#' );
+		if ( comment != 0 )
+		{
+			*comment = 0;
+		}
+		size_t length = strlen ( line );
+		while ( ( length > 0 ) && ( strchr ( " \t\r\n", line[ length - 1 ] ) != 0 ) )
+		{
+			line[ --length ] = 0;
+		}
+		size_t start = strspn ( line, " \t" );
+		if ( start < length )
+		{
+			memmove ( line, line + start, length - start + 1 );
+			return true;
+		}
+	}
+	return false;
+}
+
+bool BitbusEdgeListReader::Open ( const char* path, U32 sampleRate, string & error )
+{
+	mFile = fopen ( path, "r" );
+	if ( mFile == 0 )
+	{
+		error = string ( "cannot open " ) + path;
+		return false;
+	}
+
+	// Settings up to the first edge
+	char line[ 256 ];
+	while ( ReadLine ( line, sizeof ( line ) ) )
+	{
+		char* end;
+		U64 value = strtoull ( line, &end, 10 );
+		if ( ( end != line ) && ( *end == 0 ) )
+		{
+			mFirstEdge = value;
+			mHasFirstEdge = true;
+			break;
+		}
+
+		char key[ 32 ];
+		unsigned long long setting;
+		if ( sscanf ( line, "%31s %llu", key, &setting ) != 2 )
+		{
+			error = string ( "bad line in " ) + path + ": " + line;
+			return false;
+		}
+		if ( strcmp ( key, "sample_rate" ) == 0 )
+		{
+			mSampleRate = U32 ( setting );
+		}
+		else if ( strcmp ( key, "initial" ) == 0 )
+		{
+			mInitialState = ( setting != 0 ) ? BIT_HIGH : BIT_LOW;
+		}
+		else if ( strcmp ( key, "trigger" ) == 0 )
+		{
+			mTriggerSample = setting;
+		}
+		else if ( strcmp ( key, "end" ) == 0 )
+		{
+			mEndSample = setting;
+			mHasEndSample = true;
+		}
+		else
+		{
+			error = string ( "unknown setting in " ) + path + ": " + key;
+			return false;
+		}
+	}
+
+	if ( sampleRate != 0 )
+	{
+		mSampleRate = sampleRate;
+	}
+	if ( mSampleRate == 0 )
+	{
+		error = string ( path ) + " has no sample_rate, it has to be given";
+		return false;
+	}
+	return true;
+}
+
+bool BitbusEdgeListReader::ReadEdge ( U64 & sample )
+{
+	if ( mHasFirstEdge )
+	{
+		mHasFirstEdge = false;
+		sample = mLastEdge = mFirstEdge;
+		return true;
+	}
+
+	char line[ 64 ];
+	if ( !ReadLine ( line, sizeof ( line ) ) )
+	{
+		return false;
+	}
+	sample = mLastEdge = strtoull ( line, 0, 10 );
+	return true;
+}
+
+U64 BitbusEdgeListReader::GetEndSample() const
+{
+	return mHasEndSample ? mEndSample : mLastEdge;
+}
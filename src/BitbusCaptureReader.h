@@ -0,0 +1,124 @@
+#ifndef BITBUS_CAPTURE_READER_H
+#define BITBUS_CAPTURE_READER_H
+
+#include "BitbusEdgeChannel.h"
+#include <stdio.h>
+#include <string>
+
+using namespace std;
+
+// A single digital channel read from a capture file, streamed through a
+// small buffer. Open() fills in what the file says about the capture.
+class BitbusCaptureReader : public BitbusEdgeSource
+{
+public:
+	BitbusCaptureReader();
+	virtual ~BitbusCaptureReader();
+
+	// False (with error set) if the file cannot be read. sampleRate is the
+	// rate to use, 0 to take it from the file.
+	virtual bool Open ( const char* path, U32 sampleRate, string & error ) = 0;
+
+	// Edges that do not move forward (closer than a sample) cancel in pairs
+	virtual bool NextEdge ( U64 & sample );
+
+	BitState GetInitialState() const;
+	U32 GetSampleRate() const;
+	U64 GetTriggerSample() const;
+	virtual U64 GetEndSample() const;
+
+protected:
+	// Next edge as stored in the file
+	virtual bool ReadEdge ( U64 & sample ) = 0;
+
+	U64 mPendingEdge;
+	bool mHasPendingEdge;
+
+	FILE* mFile;
+	BitState mInitialState;
+	U32 mSampleRate;
+	U64 mTriggerSample;
+	U64 mEndSample;
+};
+
+// Saleae Logic 2 binary export of one digital channel (digital_N.bin):
+// "<SALEAE>", version, type 0, initial state, begin and end time, then the
+// transition times in seconds. The file carries no sample rate, so it has
+// to be given.
+class BitbusSaleaeBinaryReader : public BitbusCaptureReader
+{
+public:
+	BitbusSaleaeBinaryReader();
+
+	virtual bool Open ( const char* path, U32 sampleRate, string & error );
+
+	// Does the file start like a Saleae binary export?
+	static bool IsSaleaeBinary ( const char* path );
+
+protected:
+	virtual bool ReadEdge ( U64 & sample );
+	U64 ToSample ( double seconds ) const;
+
+	double mOrigin;
+	U64 mTransitionsLeft;
+	double mBuffer[ 4096 ];
+	U32 mBuffered;
+	U32 mBufferPosition;
+};
+
+// Writes a Saleae Logic 2 binary export of one digital channel, for the
+// tools that make captures. The transition count is patched in on Close().
+class BitbusSaleaeBinaryWriter
+{
+public:
+	BitbusSaleaeBinaryWriter();
+	~BitbusSaleaeBinaryWriter();
+
+	bool Create ( const char* path, U32 sampleRate, BitState initialState, string & error );
+	// Edges must be ascending; one at or before the last is refused
+	bool AddEdge ( U64 sample );
+	bool Close ( U64 endSample );
+
+	// Bytes written so far
+	U64 GetSize() const;
+
+protected:
+	void Flush();
+	bool WriteHeader ( U64 endSample );
+
+	FILE* mFile;
+	bool mWriteError;
+	U32 mSampleRate;
+	BitState mInitialState;
+	U64 mEdgeCount;
+	U64 mLastEdge;
+	double mBuffer[ 4096 ];
+	U32 mBuffered;
+};
+
+// Plain text edge list, one value per line, '#' starts a comment:
+//   sample_rate 25000000   (optional, may be given instead)
+//   initial 0|1            (line state before the first edge, default 0)
+//   trigger 1000           (optional sample number of time 0)
+//   end 123456789          (optional last sample, default the last edge)
+//   1234                   (edge sample numbers, ascending)
+//   ...
+class BitbusEdgeListReader : public BitbusCaptureReader
+{
+public:
+	BitbusEdgeListReader();
+
+	virtual bool Open ( const char* path, U32 sampleRate, string & error );
+	virtual U64 GetEndSample() const;
+
+protected:
+	virtual bool ReadEdge ( U64 & sample );
+	bool ReadLine ( char* line, U32 size );
+
+	U64 mFirstEdge;
+	bool mHasFirstEdge;
+	U64 mLastEdge;
+	bool mHasEndSample;
+};
+
+#endif //BITBUS_CAPTURE_READER_H
@@ -0,0 +1,49 @@
+#ifndef BITBUS_COUNTING_ALLOCATOR
+#define BITBUS_COUNTING_ALLOCATOR
+
+#include "BitbusTypes.h"
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// std::allocator that counts its heap allocations into a counter owned by
+// the decoder. Its reusable buffers use it, so the count stops
+// growing once they have reached the size of the largest frame seen.
+template <typename T>
+class BitbusCountingAllocator
+{
+public:
+	typedef T value_type;
+
+	explicit BitbusCountingAllocator ( U64* counter ) : mCounter ( counter ) {}
+
+	template <typename U>
+	BitbusCountingAllocator ( const BitbusCountingAllocator<U> & other ) : mCounter ( other.mCounter ) {}
+
+	T* allocate ( std::size_t n )
+	{
+		( *mCounter )++;
+		return static_cast<T*> ( ::operator new ( n * sizeof ( T ) ) );
+	}
+
+	void deallocate ( T* p, std::size_t )
+	{
+		::operator delete ( p );
+	}
+
+	template <typename U>
+	bool operator== ( const BitbusCountingAllocator<U> & other ) const
+	{
+		return mCounter == other.mCounter;
+	}
+
+	template <typename U>
+	bool operator!= ( const BitbusCountingAllocator<U> & other ) const
+	{
+		return mCounter != other.mCounter;
+	}
+
+	U64* mCounter;
+};
+
+#endif //BITBUS_COUNTING_ALLOCATOR
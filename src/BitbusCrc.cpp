@@ -0,0 +1,59 @@
+#include "BitbusCrc.h"
+
+BitbusRunningFcs::BitbusRunningFcs()
+{
+	Reset ( BITBUS_FCS_CRC16 );
+}
+
+void BitbusRunningFcs::Reset ( BitbusFcsType type )
+{
+	mType = type;
+	mFcsBytes = BitbusDecoderSettings::FcsBytes ( type );
+	mCrc = ( type == BITBUS_FCS_CRC32 ) ? BitbusCrc32::Start() : BitbusCrc16::Start();
+	mPendingCount = 0;
+}
+
+void BitbusRunningFcs::AddByte ( U8 value )
+{
+	mPending[ mPendingCount++ ] = value;
+
+	// Eight bytes ready besides the ones held back: fold them in one table step
+	if ( mPendingCount == 8 + mFcsBytes )
+	{
+		Fold ( mPending, 8 );
+		for ( U32 i=0; i < mFcsBytes; ++i )
+		{
+			mPending[ i ] = mPending[ 8 + i ];
+		}
+		mPendingCount = mFcsBytes;
+	}
+}
+
+void BitbusRunningFcs::Fold ( const U8* data, U32 length )
+{
+	if ( mType == BITBUS_FCS_CRC32 )
+	{
+		mCrc = BitbusCrc32::Update ( mCrc, data, length );
+	}
+	else
+	{
+		mCrc = BitbusCrc16::Update ( U16 ( mCrc ), data, length );
+	}
+}
+
+U64 BitbusRunningFcs::CalculatedFcs() const
+{
+	U32 crc = mCrc;
+	U32 length = ( mPendingCount > mFcsBytes ) ? mPendingCount - mFcsBytes : 0;
+
+	if ( mType == BITBUS_FCS_CRC32 )
+	{
+		crc = BitbusCrc32::Update ( crc, mPending, length );
+		return BitbusCrc32::TransmissionOrder ( BitbusCrc32::Finish ( crc ) );
+	}
+	else
+	{
+		crc = BitbusCrc16::Update ( U16 ( crc ), mPending, length );
+		return BitbusCrc16::TransmissionOrder ( BitbusCrc16::Finish ( U16 ( crc ) ) );
+	}
+}
@@ -0,0 +1,157 @@
+#ifndef BITBUS_CRC
+#define BITBUS_CRC
+
+#include "BitbusTypes.h"
+
+// Compile-time table generation (C++11 constexpr: recursion instead of loops)
+namespace BitbusCrcTables
+{
+	// Shift one byte's worth of bits through the reflected polynomial
+	template <typename T, T Poly>
+	constexpr T BitSteps ( T crc, U32 bits )
+	{
+		return ( bits == 0 ) ? crc : BitSteps<T, Poly> ( ( crc & 1 ) ? T ( ( crc >> 1 ) ^ Poly ) : T ( crc >> 1 ), bits - 1 );
+	}
+
+	// Slice 0 is the classic byte-at-a-time table, slice k advances the byte
+	// through k more zero bytes so eight bytes fold in with eight lookups
+	template <typename T, T Poly>
+	constexpr T Entry ( U32 slice, U32 index )
+	{
+		return ( slice == 0 ) ? BitSteps<T, Poly> ( T ( index ), 8 )
+		       : T ( ( Entry<T, Poly> ( slice - 1, index ) >> 8 ) ^
+		             BitSteps<T, Poly> ( T ( Entry<T, Poly> ( slice - 1, index ) & 0xff ), 8 ) );
+	}
+
+	template <U32... I> struct IndexList {};
+
+	template <typename A, typename B> struct Concat;
+	template <U32... A, U32... B> struct Concat< IndexList<A...>, IndexList<B...> >
+	{
+		typedef IndexList< A..., ( sizeof... ( A ) + B )... > Type;
+	};
+
+	// Halving keeps the template depth logarithmic in N
+	template <U32 N> struct MakeIndexList
+	{
+		typedef typename Concat< typename MakeIndexList< N / 2 >::Type,
+		                         typename MakeIndexList< N - N / 2 >::Type >::Type Type;
+	};
+	template <> struct MakeIndexList<0> { typedef IndexList<> Type; };
+	template <> struct MakeIndexList<1> { typedef IndexList<0> Type; };
+
+	template <typename T, T Poly, typename L> struct Table;
+	template <typename T, T Poly, U32... I> struct Table< T, Poly, IndexList<I...> >
+	{
+		static constexpr T sValues[ sizeof... ( I ) ] = { Entry<T, Poly> ( I / 256, I % 256 )... };
+	};
+	template <typename T, T Poly, U32... I>
+	constexpr T Table< T, Poly, IndexList<I...> >::sValues[ sizeof... ( I ) ];
+}
+
+// Reflected (LSB first) CRC as used for the HDLC/BITBUS frame check sequence.
+// Each width gets its own slice-by-8 kernel with tables built by the compiler.
+template <typename T, T Poly, T Init, T XorOut>
+class BitbusCrc
+{
+public:
+	typedef T ValueType;
+	static const U32 Bytes = sizeof ( T );
+
+	static T Compute ( const U8* data, U32 length )
+	{
+		return Finish ( Update ( Start(), data, length ) );
+	}
+
+	// Register value before the first byte, and the FCS from the final register
+	static T Start()
+	{
+		return Init;
+	}
+	static T Finish ( T crc )
+	{
+		return T ( crc ^ XorOut );
+	}
+
+	// Raw (not inverted) CRC register update
+	static T Update ( T crc, U8 data )
+	{
+		return T ( ( crc >> 8 ) ^ Lookup ( 0, ( crc ^ data ) & 0xff ) );
+	}
+
+	// Eight bytes per table step, the tail a byte at a time
+	static T Update ( T crc, const U8* data, U32 length )
+	{
+		while ( length >= 8 )
+		{
+			T next = 0;
+			for ( U32 i=0; i < 8; ++i )
+			{
+				U8 byte = data[ i ];
+				if ( i < Bytes )
+				{
+					byte ^= U8 ( crc >> ( 8 * i ) );
+				}
+				next ^= Lookup ( 7 - i, byte );
+			}
+			crc = next;
+			data += 8;
+			length -= 8;
+		}
+		while ( length-- > 0 )
+		{
+			crc = Update ( crc, *data++ );
+		}
+		return crc;
+	}
+
+	// The FCS goes out low byte first: value with the first byte on the wire
+	// in the most significant position, as the FCS frame stores it
+	static U64 TransmissionOrder ( T crc )
+	{
+		U64 value = 0;
+		for ( U32 i=0; i < Bytes; ++i )
+		{
+			value = ( value << 8 ) | U8 ( crc >> ( 8 * i ) );
+		}
+		return value;
+	}
+
+protected:
+	static T Lookup ( U32 slice, U32 index )
+	{
+		return BitbusCrcTables::Table< T, Poly, typename BitbusCrcTables::MakeIndexList< 8 * 256 >::Type >::sValues[ slice * 256 + index ];
+	}
+};
+
+// CRC-16/X.25: reflected CCITT polynomial 0x1021, initial value and final xor 0xFFFF
+typedef BitbusCrc< U16, 0x8408, 0xFFFF, 0xFFFF > BitbusCrc16;
+// HDLC 32-bit FCS: reflected polynomial 0x04C11DB7, initial value and final xor 0xFFFFFFFF
+typedef BitbusCrc< U32, 0xEDB88320, 0xFFFFFFFF, 0xFFFFFFFF > BitbusCrc32;
+
+// FCS of the frame being read, computed while its bytes arrive.
+// The last FCS-width bytes are held back: when the closing flag shows up
+// they are the FCS field, and the CRC of everything before them is ready.
+class BitbusRunningFcs
+{
+public:
+	BitbusRunningFcs();
+
+	void Reset ( BitbusFcsType type );
+	void AddByte ( U8 value );
+
+	// CRC over all bytes added so far but the FCS field, in transmission
+	// order (first FCS byte in the most significant byte)
+	U64 CalculatedFcs() const;
+
+protected:
+	void Fold ( const U8* data, U32 length );
+
+	BitbusFcsType mType;
+	U32 mFcsBytes;
+	U32 mCrc;
+	U8 mPending[ 8 + BitbusCrc32::Bytes ];
+	U32 mPendingCount;
+};
+
+#endif //BITBUS_CRC
@@ -0,0 +1,357 @@
+#ifndef BITBUS_CSV_EXPORT_H
+#define BITBUS_CSV_EXPORT_H
+
+#include "BitbusFormat.h"
+#include <algorithm>
+#include <ostream>
+#include <string.h>
+#include <vector>
+
+using namespace std;
+
+// Export text is gathered in a buffer this big and written to the stream in
+// one go; progress (and cancel) is checked every BITBUS_EXPORT_PROGRESS_FRAMES
+#ifndef BITBUS_EXPORT_BUFFER_BYTES
+#define BITBUS_EXPORT_BUFFER_BYTES ( 1 << 20 )
+#endif
+#ifndef BITBUS_EXPORT_PROGRESS_FRAMES
+#define BITBUS_EXPORT_PROGRESS_FRAMES 4096
+#endif
+
+// Buffered export text, written to a stream or (without one) kept for the
+// caller. Hexadecimal and decimal numbers are formatted here
+// (BitbusFormatHexadecimal/Decimal); the other bases go through the
+// formatter given.
+class BitbusCsvWriter
+{
+public:
+	BitbusCsvWriter ( ostream & out, BitbusNumberFormatter numberString )
+		:	mOut ( &out ), mNumberString ( numberString ), mBuffer ( BITBUS_EXPORT_BUFFER_BYTES ), mUsed ( 0 )
+	{
+	}
+
+	// Text kept in memory, grown as needed, until TakeText(); buffer's
+	// memory is used if it is at least initialBytes
+	BitbusCsvWriter ( BitbusNumberFormatter numberString, size_t initialBytes, vector<char> & buffer )
+		:	mOut ( 0 ), mNumberString ( numberString ), mUsed ( 0 )
+	{
+		mBuffer.swap ( buffer );
+		mBuffer.resize ( max<size_t> ( max<size_t> ( mBuffer.capacity(), initialBytes ), 1 ) );
+	}
+
+	~BitbusCsvWriter()
+	{
+		Flush();
+	}
+
+	void Put ( char c )
+	{
+		if ( mUsed == mBuffer.size() )
+		{
+			MakeRoom ( 1 );
+		}
+		mBuffer[ mUsed++ ] = c;
+	}
+
+	void Put ( const char* str )
+	{
+		Put ( str, strlen ( str ) );
+	}
+
+	void Put ( const char* str, size_t length )
+	{
+		if ( mUsed + length > mBuffer.size() )
+		{
+			MakeRoom ( length );
+			if ( mUsed + length > mBuffer.size() ) // bigger than the whole buffer
+			{
+				mOut->write ( str, length );
+				return;
+			}
+		}
+		memcpy ( &mBuffer[ mUsed ], str, length );
+		mUsed += length;
+	}
+
+	void PutNumber ( U64 number, DisplayBase display_base, U32 num_data_bits )
+	{
+		char digits[ 128 ];
+		char* end = digits + sizeof ( digits );
+		switch ( display_base )
+		{
+		case Hexadecimal:
+			{
+				char* first = BitbusFormatHexadecimal ( number, num_data_bits, end );
+				Put ( first, end - first );
+			}
+			break;
+		case Decimal:
+			{
+				char* first = BitbusFormatDecimal ( number, num_data_bits, end );
+				Put ( first, end - first );
+			}
+			break;
+		default:
+			mNumberString ( number, display_base, num_data_bits, digits, sizeof ( digits ) );
+			Put ( digits );
+			break;
+		}
+	}
+
+	void Flush()
+	{
+		if ( ( mOut != 0 ) && ( mUsed > 0 ) )
+		{
+			mOut->write ( &mBuffer[ 0 ], mUsed );
+			mUsed = 0;
+		}
+	}
+
+	// The kept text; the writer starts over empty
+	void TakeText ( vector<char> & text )
+	{
+		mBuffer.resize ( mUsed );
+		text.swap ( mBuffer );
+		mBuffer.assign ( 1, 0 );
+		mUsed = 0;
+	}
+
+protected:
+	void MakeRoom ( size_t length )
+	{
+		if ( mOut != 0 )
+		{
+			Flush();
+		}
+		else
+		{
+			mBuffer.resize ( max ( mBuffer.size() * 2, mUsed + length ) );
+		}
+	}
+
+	ostream* mOut;
+	BitbusNumberFormatter mNumberString;
+	vector<char> mBuffer;
+	size_t mUsed;
+};
+
+#define BITBUS_CSV_HEADER "Time[s],Address,Information,FCS\n"
+
+static inline const char* BitbusEscapeByteStr ( const BitbusDecoderSettings & settings, const BitbusFrame & frame )
+{
+	if ( ( settings.mTransmissionMode == BITBUS_TRANSMISSION_BYTE_ASYNC ) && ( frame.mFlags & BITBUS_ESCAPED_BYTE ) )
+	{
+		return "0x7D-";
+	}
+	else
+	{
+		return "";
+	}
+}
+
+// The text/csv export: one line per BITBUS frame (time, address, information, FCS).
+//
+// Frames are read forward only, so they can come from the analyzer results
+// or straight from a decoder:
+//   bool HasFrame ( U64 index ); // false past the last frame
+//   BitbusFrame GetFrame ( U64 index );
+//   bool UpdateExportProgressAndCheckForCancel ( U64 completed_frames );
+template <class Frames>
+void BitbusWriteCsvRows ( BitbusCsvWriter & out, Frames & frames, const BitbusDecoderSettings & settings,
+                          DisplayBase display_base, U64 triggerSample, U32 sampleRate, BitbusTimeFormatter timeString );
+
+template <class Frames>
+void BitbusWriteCsvExport ( ostream & fileStream, Frames & frames, const BitbusDecoderSettings & settings,
+                            DisplayBase display_base, U64 triggerSample, U32 sampleRate,
+                            BitbusNumberFormatter numberString, BitbusTimeFormatter timeString )
+{
+	BitbusCsvWriter out ( fileStream, numberString );
+	out.Put ( BITBUS_CSV_HEADER );
+	BitbusWriteCsvRows ( out, frames, settings, display_base, triggerSample, sampleRate, timeString );
+}
+
+// The rows of the export, without the header. A row starts on an SOH or
+// address field and ends on the first field after it that is not
+// information, so the rows of the fields after a flag or an abort do not
+// depend on the fields before it.
+template <class Frames>
+void BitbusWriteCsvRows ( BitbusCsvWriter & out, Frames & frames, const BitbusDecoderSettings & settings,
+                          DisplayBase display_base, U64 triggerSample, U32 sampleRate, BitbusTimeFormatter timeString )
+{
+	const char sepChar = ' ';
+
+	U32 fcsBits = settings.FcsBits();
+
+	U64 frameNumber = 0;
+	U64 nextProgress = BITBUS_EXPORT_PROGRESS_FRAMES;
+
+	if ( !frames.HasFrame ( frameNumber ) )
+	{
+		frames.UpdateExportProgressAndCheckForCancel ( frameNumber );
+		return;
+	}
+
+	for ( ; ; )
+	{
+		bool doAbortFrame = false;
+		// Re-sync to start reading BITBUS frames from the Address Byte
+		BitbusFrame firstAddressFrame;
+		for ( ; ; )
+		{
+			firstAddressFrame = frames.GetFrame ( frameNumber );
+
+			// Check for abort
+			if ( firstAddressFrame.mType == BITBUS_FIELD_SOH ||
+			        firstAddressFrame.mType == BITBUS_FIELD_ADDRESS ) // It's and address frame
+			{
+				break;
+			}
+			else
+			{
+				frameNumber++;
+				if ( !frames.HasFrame ( frameNumber ) )
+				{
+					frames.UpdateExportProgressAndCheckForCancel ( frameNumber );
+					return;
+				}
+			}
+
+		}
+
+		// 1)  Time [s]
+		char timeStr[ 64 ];
+		timeString ( firstAddressFrame.mStartingSampleInclusive, triggerSample, sampleRate, timeStr, 64 );
+		out.Put ( timeStr );
+		out.Put ( ',' );
+
+		// 2) Address Field
+		if ( settings.mBitbusAddressingMode == BITBUS_ADDRESS_SOF )
+		{
+			if ( firstAddressFrame.mType != BITBUS_ADDRESS_EXTENDED )
+			{
+				out.Put ( ",\n" );
+				continue;
+			}
+
+			out.Put ( BitbusEscapeByteStr ( settings, firstAddressFrame ) );
+			out.PutNumber ( firstAddressFrame.mData1, display_base, 8 );
+			out.Put ( ',' );
+		}
+		else // Check for extended address
+		{
+			BitbusFrame nextAddress = firstAddressFrame;
+			for ( ; ; )
+			{
+
+				if ( nextAddress.mType != BITBUS_ADDRESS_EXTENDED ) // ERROR
+				{
+					out.Put ( ",\n" );
+					break;
+				}
+
+				bool endOfAddress = ( ( nextAddress.mData1 & 0x01 ) == 0 );
+
+				if ( !endOfAddress || nextAddress.mData2 != 0 )
+				{
+					out.Put ( sepChar );
+				}
+				out.Put ( BitbusEscapeByteStr ( settings, nextAddress ) );
+				out.PutNumber ( nextAddress.mData1, display_base, 8 );
+
+				if ( endOfAddress ) // no more bytes of address?
+				{
+					out.Put ( ',' );
+					break;
+				}
+				else
+				{
+					frameNumber++;
+					if ( !frames.HasFrame ( frameNumber ) )
+					{
+						frames.UpdateExportProgressAndCheckForCancel ( frameNumber );
+						return;
+					}
+					nextAddress = frames.GetFrame ( frameNumber );
+				}
+			}
+
+		}
+
+		out.Put ( ',' );
+
+		frameNumber++;
+		if ( !frames.HasFrame ( frameNumber ) )
+		{
+			frames.UpdateExportProgressAndCheckForCancel ( frameNumber );
+			return;
+		}
+
+		// 5) Information Fields
+		BitbusFrame infoFrame;
+		for ( ; ; )
+		{
+			infoFrame = frames.GetFrame ( frameNumber );
+
+			// Check for flag
+			if ( infoFrame.mType == BITBUS_FIELD_FLAG )
+			{
+				out.Put ( ',' );
+				break;
+			}
+
+			// Check for info byte
+			if ( infoFrame.mType == BITBUS_FIELD_INFORMATION ) // ERROR
+			{
+				out.Put ( sepChar );
+				out.Put ( BitbusEscapeByteStr ( settings, infoFrame ) );
+				out.PutNumber ( infoFrame.mData1, display_base, 8 );
+				frameNumber++;
+				if ( !frames.HasFrame ( frameNumber ) )
+				{
+					frames.UpdateExportProgressAndCheckForCancel ( frameNumber );
+					return;
+				}
+			}
+			else
+			{
+				out.Put ( ',' );
+				break;
+			}
+		}
+
+		if ( doAbortFrame )
+		{
+			continue;
+		}
+
+		// 6) FCS Field: the frame the information loop stopped on
+		const BitbusFrame & fcsFrame = infoFrame;
+		if ( fcsFrame.mType != BITBUS_FIELD_FCS )
+		{
+			out.Put ( ",\n" );
+		}
+		else // BITBUS_FIELD_FCS Frame
+		{
+			out.PutNumber ( fcsFrame.mData1, display_base, fcsBits );
+			out.Put ( '\n' );
+		}
+
+		frameNumber++;
+		if ( !frames.HasFrame ( frameNumber ) )
+		{
+			frames.UpdateExportProgressAndCheckForCancel ( frameNumber );
+			return;
+		}
+
+		if ( frameNumber >= nextProgress )
+		{
+			nextProgress = frameNumber + BITBUS_EXPORT_PROGRESS_FRAMES;
+			if ( frames.UpdateExportProgressAndCheckForCancel ( frameNumber ) )
+			{
+				return;
+			}
+		}
+	}
+}
+
+#endif //BITBUS_CSV_EXPORT_H
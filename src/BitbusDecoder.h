@@ -0,0 +1,1449 @@
+#ifndef BITBUS_DECODER_H
+#define BITBUS_DECODER_H
+
+#include "BitbusTypes.h"
+#include "BitbusCrc.h"
+#include "BitbusCountingAllocator.h"
+#include "BitbusTrace.h"
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+using namespace std;
+
+// Cell count of an edge interval whose end has not been looked up yet
+#define BITSYNC_OPEN_RUN 0xFFFFFFFF
+
+// The bit period is kept in fixed point: samples per bit << this
+#define BITBUS_PERIOD_FRACTION_BITS 16
+
+// Bit sync clock recovery, a proportional plus integral loop run once per
+// edge interval. The phase error is the interval's samples less its cells
+// at the current period. The proportional gain is 1: every edge sets the
+// bit phase, the next interval's cells are counted from it. The integral
+// is the period, corrected by 1/2^BITBUS_DPLL_INTEGRAL_SHIFT of the error,
+// so it follows a clock that drifts through a frame. Each frame starts at
+// the nominal period, and the period stays within
+// nominal/2^BITBUS_DPLL_MAX_DEVIATION_SHIFT of it.
+#ifndef BITBUS_DPLL_INTEGRAL_SHIFT
+#define BITBUS_DPLL_INTEGRAL_SHIFT 4
+#endif
+#ifndef BITBUS_DPLL_MAX_DEVIATION_SHIFT
+#define BITBUS_DPLL_MAX_DEVIATION_SHIFT 3
+#endif
+
+// Lowest sample rate the decoder is specified for, in samples per bit
+#define BITBUS_MIN_SAMPLES_PER_BIT 3
+
+// Byte async character: start bit, 8 data bits (LSB first), stop bit
+#define BITBUS_ASYNC_CHARACTER_BITS 10
+#define BITBUS_ASYNC_STOP_BIT 9
+
+enum BitbusMarkerType {
+        BITBUS_MARKER_STUFFED_BIT,
+        BITBUS_MARKER_FCS_ERROR,
+        BITBUS_MARKER_FRAMING_ERROR
+};
+
+struct BitbusByte
+{
+	U64 startSample;
+	U64 endSample;
+	U8 value;
+	bool escaped;
+	// Byte async: a stop bit (of the byte or its escape) read low
+	bool framingError;
+};
+
+// What one ProcessBITBUSFrame() leaves for the next. Two decoders on the
+// same line with equal keys between frames decode the rest of it alike,
+// which is how segments decoded apart are joined (BitbusParallelDecoder).
+struct BitbusResumeKey
+{
+	U64 mSample;
+	U64 mRunEdge;
+	U64 mRunEnd;
+	U32 mRunCells;
+	U32 mRunCell;
+	U8 mLineState;
+	U8 mRunLevel;
+	U8 mPreviousBitState;
+	bool mRunOpensWithZero;
+	bool mFoundEndFlag;
+
+	bool operator== ( const BitbusResumeKey & other ) const
+	{
+		return ( mSample == other.mSample ) && ( mRunEdge == other.mRunEdge ) && ( mRunEnd == other.mRunEnd ) &&
+		       ( mRunCells == other.mRunCells ) && ( mRunCell == other.mRunCell ) &&
+		       ( mLineState == other.mLineState ) &&
+		       ( mRunLevel == other.mRunLevel ) && ( mPreviousBitState == other.mPreviousBitState ) &&
+		       ( mRunOpensWithZero == other.mRunOpensWithZero ) && ( mFoundEndFlag == other.mFoundEndFlag );
+	}
+};
+
+// Flag hunt instrumentation: BitSyncHuntFlag() runs each time the decoder
+// has to look for a flag among intervals that are none
+struct BitbusHuntStats
+{
+	U64 mHunts;
+	U64 mEdgesSkipped;
+	U64 mSamplesSkipped;
+	U64 mNanoseconds;
+};
+
+// Counters of one decode run, to tell a slow decode of a bad signal from a
+// slow decoder. The decoder counts what it emits and the time it spends
+// reading flags and bytes; the channel calls are counted by
+// BitbusCountingChannel and the commits by whoever takes the frames.
+struct BitbusDecodeStats
+{
+	U32 mBitRate; // decoded at: the one set, or the one detected
+	// Emitted
+	U64 mFields;
+	U64 mPackets; // BITBUS frames, closed by an end flag or an abort
+	U64 mInformationBytes;
+	U64 mFlags;   // start and end flags
+	U64 mFillFlags;
+	U64 mAborts;
+	U64 mFcsErrors;
+	U64 mStuffedBits;
+	U64 mFramingErrors;
+	// Work
+	U64 mEdges;   // edges the decoder moved to
+	U64 mChannelCalls;
+	U64 mResyncs; // bit sync: the line synchronized again after an abort or idle
+	U64 mAllocations; // by the frame buffers, flat once they are warm
+	BitbusHuntStats mHunt;
+	// Read from the clock three times a frame, so only with
+	// -DBITBUS_PHASE_TIMING (cmake -DBITBUS_PHASE_TIMING=ON); 0 without,
+	// and left out of the counters export
+	U64 mFlagNanoseconds; // from the end of a frame to the next address byte
+	U64 mByteNanoseconds; // from the address byte to the end flag or abort
+	// Taken
+	U64 mCommits;
+	U64 mCommittedPackets;
+	U64 mCommitNanoseconds;
+
+	void AddField ( const BitbusFrame & frame )
+	{
+		mFields++;
+		switch ( frame.mType )
+		{
+		case BITBUS_FIELD_FLAG:
+			( frame.mData1 == BITBUS_FLAG_FILL ) ? mFillFlags++ : mFlags++;
+			mPackets += ( frame.mData1 == BITBUS_FLAG_END ) ? 1 : 0;
+			break;
+		case BITBUS_FIELD_INFORMATION:
+			mInformationBytes++;
+			break;
+		case BITBUS_FIELD_FCS:
+			mFcsErrors += ( frame.mFlags & BITBUS_DISPLAY_AS_ERROR ) ? 1 : 0;
+			break;
+		case BITBUS_ABORT_SEQ:
+			mAborts++;
+			mPackets++;
+			break;
+		}
+	}
+
+	void AddMarker ( BitbusMarkerType type )
+	{
+		mStuffedBits += ( type == BITBUS_MARKER_STUFFED_BIT ) ? 1 : 0;
+		mFramingErrors += ( type == BITBUS_MARKER_FRAMING_ERROR ) ? 1 : 0;
+	}
+
+	// The work counters of other (a decoder run on part of the same line)
+	void AddWork ( const BitbusDecodeStats & other )
+	{
+		mEdges += other.mEdges;
+		mChannelCalls += other.mChannelCalls;
+		mResyncs += other.mResyncs;
+		mAllocations += other.mAllocations;
+		mHunt.mHunts += other.mHunt.mHunts;
+		mHunt.mEdgesSkipped += other.mHunt.mEdgesSkipped;
+		mHunt.mSamplesSkipped += other.mHunt.mSamplesSkipped;
+		mHunt.mNanoseconds += other.mHunt.mNanoseconds;
+		mFlagNanoseconds += other.mFlagNanoseconds;
+		mByteNanoseconds += other.mByteNanoseconds;
+		mCommits += other.mCommits;
+		mCommittedPackets += other.mCommittedPackets;
+		mCommitNanoseconds += other.mCommitNanoseconds;
+	}
+};
+
+// Per-decoder buffers reused from frame to frame
+typedef vector< BitbusByte, BitbusCountingAllocator<BitbusByte> > BitbusByteBuffer;
+
+// The BITBUS flag/byte/FCS state machine, independent of the Logic SDK.
+//
+// Channel is read like the SDK's AnalyzerChannelData:
+//   BitState GetBitState(); U64 GetSampleNumber(); void Advance ( U32 );
+//   void AdvanceToNextEdge(); bool WouldAdvancingCauseTransition ( U32 );
+// Sink receives the results:
+//   void AddDecodedFrame ( const BitbusFrame & );
+//   void AddDecodedMarker ( U64 sample, BitbusMarkerType );
+//   void BeforeChannelRead(); // called before a read that may need more data
+template <class Channel, class Sink>
+class BitbusDecoder
+{
+public:
+	BitbusDecoder ( const BitbusDecoderSettings & settings, Sink & sink );
+
+	// At bitRate, or the settings' rate if it is 0 (bitRate is the one
+	// detected; the settings are the user's and left alone)
+	void Setup ( Channel* channel, U32 sampleRateHz, U32 bitRate = 0 );
+	// Synchronize on the line (bit sync), then decode one BITBUS frame per call
+	void Start();
+	// Instead of Start(): go on from where a decoder of the same line was
+	// when it gave key, the channel moved to key.mSample
+	void Resume ( const BitbusResumeKey & key );
+	void ProcessBITBUSFrame();
+
+	// Nominal samples per bit, rounded
+	U64 GetSamplesPerBit() const;
+	// Heap allocations made by the frame buffers since Setup()
+	U64 GetAllocationCount() const;
+	const BitbusHuntStats & GetHuntStats() const;
+	// Of the run so far, channel and commit counters left at 0
+	const BitbusDecodeStats & GetStats() const;
+	// Between frames (after Start() or ProcessBITBUSFrame()); the count of
+	// 1s is left out, ProcessFlags() clears it before reading any bit
+	BitbusResumeKey GetResumeKey() const;
+
+protected:
+	// Functions to read and process a BITBUS frame
+	BitbusByte ProcessFlags();
+	void ProcessAddressField ( BitbusByte byteAfterFlag );
+	void ProcessInfoAndFcsField();
+	void ReadProcessAndFcsField();
+	void InfoAndFcsField ( const BitbusByteBuffer & informationAndFcs );
+	void ProcessInformationField ( const BitbusByteBuffer & information, U32 count );
+	void ProcessFcsField ( const BitbusByteBuffer & bytes, U32 first );
+	BitbusByte ReadByte();
+
+	// Bit Sync Transmission functions
+	void BitSyncProcessFlags();
+	U32 BitSyncReadBits ( U32 count, U32 shift, U8 & value );
+	BitbusByte BitSyncReadByte();
+	BitbusByte BitSyncReadFlag();
+	bool FlagComing();
+        bool AbortComing();
+	bool BitSyncFlagAfterZero();
+
+	// Bit Sync edge interval reader
+	void BitSyncStart();
+	void BitSyncNextInterval();
+	void BitSyncCloseInterval();
+	void BitSyncSkipInterval();
+	void BitSyncHuntFlag();
+	void AddHuntStats ( std::chrono::steady_clock::time_point start, U64 edges, U64 samples );
+	void BitSyncEnsureInterval();
+	U32 BitSyncRemainingCells() const;
+	U64 BitSyncPosition() const;
+	BitState BitSyncCellBit();
+	// Bit clock
+	U32 CellsIn ( U64 samples ) const;
+	U64 SamplesForCells ( U32 cells ) const;
+	U64 HalfCells ( U32 halfCells ) const;
+	void TrackInterval ( U64 samples, U32 cells );
+	U64 ClampPeriod ( S64 period ) const;
+	void ResetBitClock();
+	U64 MeasuredBitRate() const;
+	// Byte Async Transmission functions
+	BitbusByte ByteAsyncProcessFlags();
+	void GenerateFlagsFrames ( const BitbusByteBuffer & readBytes ) ;
+	BitbusByte ByteAsyncReadByte();
+	BitbusByte ByteAsyncDecodeByte();
+        bool IsNRZ();
+        bool IsBitSync();
+	// Helper functions
+	BitbusFrame CreateFrame ( U8 mType, U64 mStartingSampleInclusive, U64 mEndingSampleInclusive,
+	                          U64 mData1=0, U64 mData2=0, U8 mFlags=0 ) const;
+	U64 BitbusBytesToValue ( const BitbusByteBuffer & bytes, U32 first, U32 count ) const;
+	U8 ByteFlags ( const BitbusByte & byte ) const;
+
+	void AddFrameToResults ( const BitbusFrame & frame );
+	void AddMarker ( U64 sample, BitbusMarkerType type );
+
+protected:
+
+	const BitbusDecoderSettings & mSettings;
+	Sink & mSink;
+	Channel* mChannel;
+
+	U32 mSampleRateHz;
+	U32 mBitRate;
+	// Samples per bit, fixed point (BITBUS_PERIOD_FRACTION_BITS): from the
+	// settings, and as tracked through the current frame (bit sync)
+	U64 mNominalPeriod;
+	U64 mBitPeriod;
+	// Intervals measured in the current frame, for its bit rate
+	U64 mFrameCells;
+	U64 mFrameSamples;
+	U32 mSamplesInLongRun;
+	U32 mSamplesIn8Bits;
+	U32 mCellsInAFlag;
+	U32 mCellsInAbort;
+	// Byte async: middle of each bit of a character, in samples from its start edge
+	U64 mAsyncBitMiddles[ BITBUS_ASYNC_CHARACTER_BITS ];
+
+	BitbusRunningFcs mFcs;
+
+        BitState mPreviousBitState;
+
+	// Current edge interval of the bit sync line: mRunCells bit cells at
+	// mRunLevel between mRunEdge and mRunEnd, mRunCell of them consumed.
+	// An interval longer than any flag or abort is left open (its end is
+	// only looked up when the decoder has to move past it).
+	U64 mRunEdge;
+	U64 mRunEnd;
+	U32 mRunCells;
+	U32 mRunCell;
+	BitState mRunLevel;
+	bool mRunOpensWithZero;
+
+	U32 mConsecutiveOnes;
+	bool mReadingFrame;
+	bool mAbortFrame;
+	bool mFoundEndFlag;
+
+	BitbusFrame mEndFlagFrame;
+	BitbusFrame mAbtFrame;
+
+	BitbusDecodeStats mStats; // the frame buffers count their allocations in it
+
+	BitbusByteBuffer mFlagBytes;
+	BitbusByteBuffer mFrameBytes;
+};
+
+template <class Channel, class Sink>
+BitbusDecoder<Channel, Sink>::BitbusDecoder ( const BitbusDecoderSettings & settings, Sink & sink )
+    :	mSettings ( settings ), mSink ( sink ), mChannel ( 0 ),
+        mSampleRateHz ( 0 ), mBitRate ( 0 ), mNominalPeriod ( 0 ), mBitPeriod ( 0 ), mFrameCells ( 0 ), mFrameSamples ( 0 ),
+        mSamplesInLongRun ( 0 ), mSamplesIn8Bits ( 0 ),
+        mCellsInAFlag ( 0 ), mCellsInAbort ( 0 ), mAsyncBitMiddles(),
+        mPreviousBitState ( BIT_LOW ),
+        mRunEdge ( 0 ), mRunEnd ( 0 ), mRunCells ( 0 ), mRunCell ( 0 ), mRunLevel ( BIT_LOW ), mRunOpensWithZero ( false ),
+        mConsecutiveOnes ( 0 ), mReadingFrame ( false ),mAbortFrame ( false ),
+        mFoundEndFlag ( false ),
+        mEndFlagFrame(), mAbtFrame(), mStats(),
+        mFlagBytes ( BitbusCountingAllocator<BitbusByte> ( &mStats.mAllocations ) ),
+        mFrameBytes ( BitbusCountingAllocator<BitbusByte> ( &mStats.mAllocations ) )
+{
+}
+
+template <class Channel, class Sink>
+void BitbusDecoder<Channel, Sink>::Setup ( Channel* channel, U32 sampleRateHz, U32 bitRate )
+{
+        mChannel = channel;
+
+        // Not truncated to whole samples: a bit can be 3.3 samples long
+        mSampleRateHz = sampleRateHz;
+        mBitRate = ( bitRate > 0 ) ? bitRate : mSettings.mBitRate;
+        mNominalPeriod = ( ( U64 ( mSampleRateHz ) << BITBUS_PERIOD_FRACTION_BITS ) + mBitRate / 2 ) / mBitRate;
+        ResetBitClock();
+
+        if (IsNRZ()) {
+                mCellsInAFlag = 6;
+        } else {
+                mCellsInAFlag = 7;
+        }
+
+        mCellsInAbort = 7;
+
+        mSamplesIn8Bits = U32 ( SamplesForCells ( 8 ) );
+
+        // Intervals are measured exactly up to an abort seen from five cells in
+        // (a 0 and four 1s can be read before the run has to be classified).
+        mSamplesInLongRun = U32 ( HalfCells ( 2 * ( mCellsInAbort + 6 ) + 1 ) );
+
+        // Byte async has no clock to track: the bits are where the nominal period puts them
+        for ( U32 i=0; i < BITBUS_ASYNC_CHARACTER_BITS; ++i )
+        {
+                mAsyncBitMiddles[ i ] = HalfCells ( 2 * i + 1 );
+        }
+
+        mPreviousBitState = mChannel->GetBitState();
+        mConsecutiveOnes = 0;
+        mReadingFrame = false;
+	mAbortFrame = false;
+
+        mFoundEndFlag = false;
+
+        mRunEdge = 0;
+        mRunEnd = 0;
+        mRunCells = 0;
+        mRunCell = 0;
+        mRunLevel = mPreviousBitState;
+        mRunOpensWithZero = false;
+
+        mFcs.Reset ( mSettings.mFcsType );
+        mStats = BitbusDecodeStats();
+        mStats.mBitRate = mBitRate;
+        BITBUS_TRACE_EVENT ( BITBUS_TRACE_SETUP, mChannel->GetSampleNumber(), mBitRate );
+}
+
+template <class Channel, class Sink>
+void BitbusDecoder<Channel, Sink>::Start()
+{
+	if ( IsBitSync() )
+	{
+		// Synchronize
+		BitSyncStart();
+	}
+}
+
+template <class Channel, class Sink>
+void BitbusDecoder<Channel, Sink>::Resume ( const BitbusResumeKey & key )
+{
+	mFoundEndFlag = key.mFoundEndFlag;
+	if ( !IsBitSync() )
+	{
+		return;
+	}
+	// An interval used up has no cells left, as after BitSyncStart()
+	mRunLevel = BitState ( key.mRunLevel );
+	mRunEnd = key.mRunEnd;
+	mRunEdge = key.mRunEdge;
+	mRunCells = key.mRunCells;
+	mRunCell = key.mRunCell;
+	mPreviousBitState = BitState ( key.mPreviousBitState );
+	mRunOpensWithZero = key.mRunOpensWithZero;
+}
+
+template <class Channel, class Sink>
+U64 BitbusDecoder<Channel, Sink>::GetSamplesPerBit() const
+{
+	return ( mNominalPeriod + ( 1 << ( BITBUS_PERIOD_FRACTION_BITS - 1 ) ) ) >> BITBUS_PERIOD_FRACTION_BITS;
+}
+
+template <class Channel, class Sink>
+U64 BitbusDecoder<Channel, Sink>::GetAllocationCount() const
+{
+	return mStats.mAllocations;
+}
+
+template <class Channel, class Sink>
+const BitbusHuntStats & BitbusDecoder<Channel, Sink>::GetHuntStats() const
+{
+	return mStats.mHunt;
+}
+
+template <class Channel, class Sink>
+const BitbusDecodeStats & BitbusDecoder<Channel, Sink>::GetStats() const
+{
+	return mStats;
+}
+
+template <class Channel, class Sink>
+BitbusResumeKey BitbusDecoder<Channel, Sink>::GetResumeKey() const
+{
+	BitbusResumeKey key = BitbusResumeKey();
+	key.mSample = mChannel->GetSampleNumber();
+	key.mLineState = U8 ( mChannel->GetBitState() );
+	key.mFoundEndFlag = mFoundEndFlag;
+	if ( mSettings.mTransmissionMode == BITBUS_TRANSMISSION_BYTE_ASYNC )
+	{
+		return key; // the bytes are read from the channel position alone
+	}
+
+	key.mRunLevel = U8 ( mRunLevel );
+	key.mRunEnd = mRunEnd;
+
+	if ( ( mRunCells != BITSYNC_OPEN_RUN ) && ( mRunCell >= mRunCells ) )
+	{
+		// Interval used up: only where it ends matters, as for a fresh BitSyncStart()
+		key.mPreviousBitState = U8 ( ( mRunCells > 0 ) ? mRunLevel : mPreviousBitState );
+	}
+	else
+	{
+		key.mRunEdge = mRunEdge;
+		key.mRunCells = mRunCells;
+		key.mRunCell = mRunCell;
+		key.mPreviousBitState = U8 ( mPreviousBitState );
+		key.mRunOpensWithZero = mRunOpensWithZero;
+	}
+	return key;
+}
+
+template <class Channel, class Sink>
+bool BitbusDecoder<Channel, Sink>::IsNRZ()
+{
+        return mSettings.mTransmissionMode == BITBUS_TRANSMISSION_BIT_SYNC_NRZ;
+}
+
+template <class Channel, class Sink>
+bool BitbusDecoder<Channel, Sink>::IsBitSync()
+{
+        return mSettings.mTransmissionMode == BITBUS_TRANSMISSION_BIT_SYNC_NRZ ||
+                mSettings.mTransmissionMode == BITBUS_TRANSMISSION_BIT_SYNC;
+}
+
+//
+/////////////// SYNC BIT TRAMISSION ///////////////////////////////////////////////
+//
+
+template <class Channel, class Sink>
+void BitbusDecoder<Channel, Sink>::ProcessBITBUSFrame()
+{
+	bool earlyAbort;
+	mFcs.Reset ( mSettings.mFcsType );
+	ResetBitClock();
+#ifdef BITBUS_PHASE_TIMING
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+#endif
+	BitbusByte addressByte = ProcessFlags();
+	earlyAbort = mAbortFrame;
+#ifdef BITBUS_PHASE_TIMING
+	std::chrono::steady_clock::time_point flagsRead = std::chrono::steady_clock::now();
+#endif
+	if ( !earlyAbort )
+	{
+		BITBUS_TRACE_EVENT ( BITBUS_TRACE_FRAME_START, addressByte.startSample, 0 );
+	}
+	ProcessAddressField ( addressByte );
+	ProcessInfoAndFcsField();
+#ifdef BITBUS_PHASE_TIMING
+	std::chrono::steady_clock::time_point bytesRead = std::chrono::steady_clock::now();
+	mStats.mFlagNanoseconds += U64 ( std::chrono::duration_cast<std::chrono::nanoseconds> ( flagsRead - start ).count() );
+	mStats.mByteNanoseconds += U64 ( std::chrono::duration_cast<std::chrono::nanoseconds> ( bytesRead - flagsRead ).count() );
+#endif
+
+	if ( mAbortFrame && (!earlyAbort) ) // The frame has been aborted at some point
+	{
+		BITBUS_TRACE_EVENT ( BITBUS_TRACE_ABORT, mAbtFrame.mStartingSampleInclusive, 0 );
+		AddFrameToResults ( mAbtFrame );
+	}
+	else if ( !mAbortFrame ) // An early abort (idle line) has no frame to close
+	{
+		BITBUS_TRACE_EVENT ( BITBUS_TRACE_FRAME_END, mEndFlagFrame.mStartingSampleInclusive, 0 );
+		AddFrameToResults ( mEndFlagFrame );
+	}
+	if ( mAbortFrame ) {
+		if ( IsBitSync() )
+		{
+			// After abortion, synchronize again
+			BITBUS_TRACE_EVENT ( BITBUS_TRACE_RESYNC, mChannel->GetSampleNumber(), earlyAbort ? 1 : 0 );
+			mStats.mResyncs++;
+			BitSyncSkipInterval();
+		}
+	}
+	// Reset state bool variables
+	mReadingFrame = false;
+	mAbortFrame = false;
+}
+
+template <class Channel, class Sink>
+BitbusByte BitbusDecoder<Channel, Sink>::ProcessFlags()
+{
+        BitbusByte addressByte;
+	if ( IsBitSync() )
+	{
+		BitSyncProcessFlags();
+		mReadingFrame = true;
+		addressByte = ReadByte();
+	}
+	else
+	{
+		mReadingFrame = true;
+		addressByte = ByteAsyncProcessFlags();
+	}
+	return addressByte;
+}
+
+template <class Channel, class Sink>
+bool BitbusDecoder<Channel, Sink>::AbortComing()
+{
+	BitSyncEnsureInterval();
+        if (IsNRZ()) {
+                if (mRunLevel==BIT_LOW)
+                        return false;
+	}
+	// More than 7 cells to the next edge: 7 or more 1-bits in a row
+	return BitSyncRemainingCells() > mCellsInAbort;
+}
+
+// Interframe time fill: ISO/IEC 13239:2002(E) pag. 21
+template <class Channel, class Sink>
+void BitbusDecoder<Channel, Sink>::BitSyncProcessFlags()
+{
+	bool flagEncountered = false;
+        BitbusByteBuffer & flags = mFlagBytes;
+        flags.clear();
+        mAbortFrame = false;
+
+	for ( ; ; )
+	{
+		if ( AbortComing() )
+		{
+			// Show fill flags
+			for ( U32 i=0; i < flags.size(); ++i )
+			{
+				BitbusFrame frame = CreateFrame ( BITBUS_FIELD_FLAG, flags.at ( i ).startSample,
+				                            flags.at ( i ).endSample, BITBUS_FLAG_FILL );
+				AddFrameToResults ( frame );
+			}
+                        flags.clear();
+                        flagEncountered = false;
+			mAbortFrame = true;
+
+                        break;
+                }
+
+		if ( FlagComing() )
+		{
+			flags.push_back ( BitSyncReadFlag() );
+
+			// The closing 0 of the flag is the first cell of the next interval
+			BitSyncEnsureInterval();
+			mRunCell++;
+			flagEncountered = true;
+		}
+		else // non-flag
+		{
+			if ( flagEncountered )
+			{
+				if ( IsNRZ() && BitSyncFlagAfterZero() )
+				{
+					// NRZ flags back to back: step over the opening 0 of the next one
+					mRunCell++;
+					continue;
+				}
+				break;
+			}
+			else // non-flag byte before a byte-flag is ignored
+			{
+				BitSyncHuntFlag();
+			}
+		}
+	}
+
+	if ( !mAbortFrame )
+	{
+                for ( U32 i=0; i < flags.size(); ++i )
+                {
+                        BitbusFrame frame = CreateFrame ( BITBUS_FIELD_FLAG, flags.at ( i ).startSample,
+                                                   flags.at ( i ).endSample, BITBUS_FLAG_FILL );
+                        if ( i == flags.size() - 1 )
+                        {
+                                frame.mData1 = BITBUS_FLAG_START;
+                        }
+                        AddFrameToResults ( frame );
+                }
+        }
+        mConsecutiveOnes=0;
+}
+
+// Read up to count bits with bit-stuffing from the current edge interval,
+// LSB first into value starting at bit shift. Returns the number of bits read.
+template <class Channel, class Sink>
+U32 BitbusDecoder<Channel, Sink>::BitSyncReadBits ( U32 count, U32 shift, U8 & value )
+{
+	BitSyncEnsureInterval();
+
+	U32 remaining = BitSyncRemainingCells();
+
+	if ( BitSyncCellBit() == BIT_LOW )
+	{
+		// NRZI: a 0 is the edge opening the interval. NRZ: every cell of a low interval is a 0.
+		U32 zeros = IsNRZ() ? min ( count, remaining ) : 1;
+		mRunCell += zeros;
+		mConsecutiveOnes = 0;
+		return zeros;
+	}
+
+	U32 ones = min ( min ( count, remaining ), 5 - mConsecutiveOnes );
+	value |= U8 ( ( ( 1 << ones ) - 1 ) << shift );
+	mRunCell += ones;
+	mConsecutiveOnes += ones;
+
+	if ( mReadingFrame && mConsecutiveOnes == 5 )
+	{
+		mConsecutiveOnes = 0;
+
+		// Check for 0-bit insertion (i.e. line toggle right after the fifth 1)
+		if ( mRunCell == mRunCells )
+		{
+			BitSyncNextInterval();
+			// Mark the bit-stuffing
+			AddMarker ( mRunEdge, BITBUS_MARKER_STUFFED_BIT );
+			mRunCell++;
+		}
+		else // Invalid frame...
+		{
+			U64 fifthOne = mRunEdge + HalfCells ( 2 * mRunCell - 1 );
+			mAbtFrame = CreateFrame ( BITBUS_ABORT_SEQ, fifthOne, fifthOne + mSamplesIn8Bits );
+			mAbortFrame = true;
+		}
+	}
+
+	return ones;
+}
+
+template <class Channel, class Sink>
+bool BitbusDecoder<Channel, Sink>::FlagComing()
+{
+        // NRZ first
+        // 01111110
+        // We are at 0->1 transition. If the 1->0 transition follows after
+        // exactly a flag's worth of cells we have a flag.
+	BitSyncEnsureInterval();
+        bool validEdge = BitSyncRemainingCells() == mCellsInAFlag;
+        if (validEdge && IsNRZ()) {
+                if (mRunLevel==BIT_LOW) {
+                        return false;
+                }
+        }
+        return validEdge;
+}
+
+// NRZ: at the last cell of a low interval, is the high interval after it a
+// flag's worth of cells? Low NRZ intervals are always measured, so the
+// channel sits at the end of this one and can look ahead without moving.
+template <class Channel, class Sink>
+bool BitbusDecoder<Channel, Sink>::BitSyncFlagAfterZero()
+{
+	BitSyncEnsureInterval();
+	if ( ( mRunLevel != BIT_LOW ) || ( BitSyncRemainingCells() != 1 ) )
+	{
+		return false;
+	}
+
+	// The shortest and longest intervals of a flag's cells
+	U64 shortest = HalfCells ( 2 * mCellsInAFlag - 1 );
+	shortest += ( CellsIn ( shortest ) < mCellsInAFlag ) ? 1 : 0;
+	U64 longest = HalfCells ( 2 * mCellsInAFlag + 1 );
+	longest -= ( CellsIn ( longest ) > mCellsInAFlag ) ? 1 : 0;
+	return !mChannel->WouldAdvancingCauseTransition ( U32 ( shortest - 1 ) ) &&
+	       mChannel->WouldAdvancingCauseTransition ( U32 ( longest ) );
+}
+
+// Consume the interval of a flag coming (see FlagComing)
+template <class Channel, class Sink>
+BitbusByte BitbusDecoder<Channel, Sink>::BitSyncReadFlag()
+{
+	// Move back to start of bit sequence
+	U64 startSample = BitSyncPosition() - SamplesForCells ( 1 );
+	BitSyncSkipInterval();
+	U64 endSample = BitSyncPosition() + SamplesForCells ( 1 );
+	BitbusByte bs = { startSample, endSample, BITBUS_FLAG_VALUE, false, false };
+	return bs;
+}
+
+template <class Channel, class Sink>
+BitbusByte BitbusDecoder<Channel, Sink>::BitSyncReadByte()
+{
+	if ( mReadingFrame && AbortComing() )
+	{
+		// Create "Abort Frame" frame
+		U64 startSample = BitSyncPosition();
+		U64 endSample = startSample + mSamplesIn8Bits;
+
+		mAbtFrame = CreateFrame ( BITBUS_ABORT_SEQ, startSample + SamplesForCells ( 1 ), endSample );
+		mAbortFrame = true;
+		BitbusByte b;
+		b.startSample = 0;
+		b.endSample = 0;
+		b.value = 0;
+		return b;
+	}
+	if ( mReadingFrame && FlagComing() && !IsNRZ())
+	{
+		mFoundEndFlag = true;
+		return BitSyncReadFlag();
+	}
+
+	U8 byteValue = 0;
+	U64 startSample = BitSyncPosition();
+	for ( U32 i=0; i < 8 ; )
+	{
+                if (i==1 && IsNRZ()) {
+                        // we may be reading a frame now.
+                        if (FlagComing()) {
+                                mFoundEndFlag = true;
+                                return BitSyncReadFlag();
+                        }
+                }
+		// NRZ reads the first bit alone to look for the flag behind it
+		i += BitSyncReadBits ( ( i==0 && IsNRZ() ) ? 1 : 8 - i, i, byteValue );
+		if ( mAbortFrame )
+		{
+			BitbusByte b;
+			b.startSample = 0;
+			b.endSample = 0;
+			b.value = 0;
+			return b;
+		}
+	}
+	U64 endSample = BitSyncPosition();
+	BitbusByte bs = { startSample, endSample, byteValue, false, false };
+	mFcs.AddByte ( bs.value );
+	return bs;
+}
+
+//
+/////////////// SYNC BIT EDGE INTERVALS ///////////////////////////////////////////////
+//
+
+// The line is read as a sequence of edge intervals. Each interval holds a
+// whole number of bit cells: for NRZI the first cell is a 0 (the edge) and
+// the rest are 1s, for NRZ every cell carries the line level. Flags, aborts
+// and stuffed bits are then recognized from the interval lengths, so the
+// channel is only touched once per edge instead of several times per bit.
+
+template <class Channel, class Sink>
+void BitbusDecoder<Channel, Sink>::BitSyncStart()
+{
+	mChannel->AdvanceToNextEdge();
+	mRunEnd = mChannel->GetSampleNumber();
+	mRunLevel = mPreviousBitState;
+	mRunCells = 0;
+	mRunCell = 0;
+}
+
+template <class Channel, class Sink>
+void BitbusDecoder<Channel, Sink>::BitSyncNextInterval()
+{
+	do
+	{
+		if ( mRunCells > 0 )
+		{
+			mPreviousBitState = mRunLevel;
+		}
+		mRunEdge = mRunEnd;
+		mRunLevel = ( mRunLevel == BIT_LOW ) ? BIT_HIGH : BIT_LOW;
+		mRunCell = 0;
+
+		mSink.BeforeChannelRead();
+		// NRZ zeros are data of any length, so low NRZ intervals are always measured
+		if ( ( IsNRZ() && mRunLevel == BIT_LOW ) || mChannel->WouldAdvancingCauseTransition ( mSamplesInLongRun ) )
+		{
+			mChannel->AdvanceToNextEdge();
+			mRunEnd = mChannel->GetSampleNumber();
+			mRunCells = CellsIn ( mRunEnd - mRunEdge );
+			TrackInterval ( mRunEnd - mRunEdge, mRunCells );
+		}
+		else
+		{
+			mRunCells = BITSYNC_OPEN_RUN;
+		}
+	}
+	while ( mRunCells == 0 ); // glitch shorter than half a bit: the level before it goes on
+
+	mRunOpensWithZero = ( mRunLevel != mPreviousBitState );
+}
+
+template <class Channel, class Sink>
+void BitbusDecoder<Channel, Sink>::BitSyncCloseInterval()
+{
+	if ( mRunCells == BITSYNC_OPEN_RUN )
+	{
+		mSink.BeforeChannelRead();
+		mChannel->AdvanceToNextEdge();
+		mRunEnd = mChannel->GetSampleNumber();
+		mRunCells = CellsIn ( mRunEnd - mRunEdge );
+		TrackInterval ( mRunEnd - mRunEdge, mRunCells );
+	}
+}
+
+// Move to the next edge (the end of the current interval, or the end of
+// the next one if we are sitting right on an edge).
+template <class Channel, class Sink>
+void BitbusDecoder<Channel, Sink>::BitSyncSkipInterval()
+{
+	BitSyncEnsureInterval();
+	BitSyncCloseInterval();
+	mRunCell = mRunCells;
+}
+
+// Flag hunt, from an interval that is neither a flag nor an abort: steps
+// over every following interval that cannot be one either (NRZI: under a
+// flag's cells; NRZ: low, or high but not 6 or over 7 cells) with the
+// interval state kept in locals and one channel call per edge, and stops
+// on the next candidate as BitSyncNextInterval() would have left it. An
+// idle line is read to its end here rather than left as an open run; the
+// abort that follows is the same.
+template <class Channel, class Sink>
+void BitbusDecoder<Channel, Sink>::BitSyncHuntFlag()
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	BITBUS_TRACE_EVENT ( BITBUS_TRACE_FLAG_HUNT, mRunEdge, 0 );
+	BitSyncSkipInterval();
+
+	const bool nrz = IsNRZ();
+	const U64 huntStart = mRunEnd;
+	U64 edge = mRunEnd;
+	U64 intervalStart = edge;
+	U32 cells = mRunCells;
+	BitState level = mRunLevel;
+	BitState previous = mPreviousBitState;
+	U64 skipped = 0;
+
+	try
+	{
+		for ( ; ; )
+		{
+			if ( cells > 0 )
+			{
+				previous = level;
+			}
+			intervalStart = edge;
+			level = ( level == BIT_LOW ) ? BIT_HIGH : BIT_LOW;
+
+			mSink.BeforeChannelRead();
+			mChannel->AdvanceToNextEdge();
+			edge = mChannel->GetSampleNumber();
+			cells = CellsIn ( edge - intervalStart );
+
+			bool candidate;
+			if ( nrz )
+			{
+				candidate = ( level == BIT_HIGH ) && ( ( cells == mCellsInAFlag ) || ( cells > mCellsInAbort ) );
+			}
+			else
+			{
+				candidate = ( cells >= mCellsInAFlag );
+			}
+			if ( candidate )
+			{
+				break;
+			}
+			skipped++;
+		}
+	}
+	catch ( ... )
+	{
+		// End of the data (or the thread told to exit) part way through
+		AddHuntStats ( start, skipped, intervalStart - huntStart );
+		throw;
+	}
+
+	mRunEdge = intervalStart;
+	mRunEnd = edge;
+	mRunCells = cells;
+	mRunCell = 0;
+	mRunLevel = level;
+	mPreviousBitState = previous;
+	mRunOpensWithZero = ( mRunLevel != mPreviousBitState );
+
+	AddHuntStats ( start, skipped, intervalStart - huntStart );
+}
+
+template <class Channel, class Sink>
+void BitbusDecoder<Channel, Sink>::AddHuntStats ( std::chrono::steady_clock::time_point start, U64 edges, U64 samples )
+{
+	mStats.mHunt.mHunts++;
+	mStats.mHunt.mEdgesSkipped += edges;
+	mStats.mHunt.mSamplesSkipped += samples;
+	mStats.mHunt.mNanoseconds += U64 ( std::chrono::duration_cast<std::chrono::nanoseconds> ( std::chrono::steady_clock::now() - start ).count() );
+}
+
+template <class Channel, class Sink>
+void BitbusDecoder<Channel, Sink>::BitSyncEnsureInterval()
+{
+	if ( mRunCell >= mRunCells )
+	{
+		BitSyncNextInterval();
+	}
+}
+
+template <class Channel, class Sink>
+U32 BitbusDecoder<Channel, Sink>::BitSyncRemainingCells() const
+{
+	return mRunCells - mRunCell;
+}
+
+template <class Channel, class Sink>
+U64 BitbusDecoder<Channel, Sink>::BitSyncPosition() const
+{
+	if ( mRunCell >= mRunCells )
+	{
+		return mRunEnd;
+	}
+	return mRunEdge + SamplesForCells ( mRunCell );
+}
+
+template <class Channel, class Sink>
+BitState BitbusDecoder<Channel, Sink>::BitSyncCellBit()
+{
+	if ( IsNRZ() )
+	{
+		return mRunLevel;
+	}
+	return ( mRunCell == 0 && mRunOpensWithZero ) ? BIT_LOW : BIT_HIGH;
+}
+
+// Cells in an interval of samples: rounded to the nearest (an idle line
+// can outlast a U32 of cells)
+template <class Channel, class Sink>
+U32 BitbusDecoder<Channel, Sink>::CellsIn ( U64 samples ) const
+{
+	if ( samples >= ( U64 ( 1 ) << ( 63 - BITBUS_PERIOD_FRACTION_BITS ) ) )
+	{
+		return BITSYNC_OPEN_RUN - 1;
+	}
+	return U32 ( min<U64> ( ( ( samples << BITBUS_PERIOD_FRACTION_BITS ) + mBitPeriod / 2 ) / mBitPeriod, BITSYNC_OPEN_RUN - 1 ) );
+}
+
+// Samples from a cell boundary to the one cells later
+template <class Channel, class Sink>
+U64 BitbusDecoder<Channel, Sink>::SamplesForCells ( U32 cells ) const
+{
+	return ( U64 ( cells ) * mBitPeriod ) >> BITBUS_PERIOD_FRACTION_BITS;
+}
+
+// Samples from a cell boundary to halfCells half cells later
+template <class Channel, class Sink>
+U64 BitbusDecoder<Channel, Sink>::HalfCells ( U32 halfCells ) const
+{
+	return ( U64 ( halfCells ) * mBitPeriod ) >> ( BITBUS_PERIOD_FRACTION_BITS + 1 );
+}
+
+// An interval measured edge to edge: the edge puts the bit phase right,
+// and the loop takes the phase error. Intervals longer than an abort are
+// idle line or counted wrong anyway, they are left out.
+template <class Channel, class Sink>
+void BitbusDecoder<Channel, Sink>::TrackInterval ( U64 samples, U32 cells )
+{
+	if ( ( cells == 0 ) || ( cells > mCellsInAbort ) || !IsBitSync() )
+	{
+		return;
+	}
+	mFrameCells += cells;
+	mFrameSamples += samples;
+
+	const S64 error = S64 ( samples << BITBUS_PERIOD_FRACTION_BITS ) - S64 ( cells * mBitPeriod );
+	mBitPeriod = ClampPeriod ( S64 ( mBitPeriod ) + error / ( 1 << BITBUS_DPLL_INTEGRAL_SHIFT ) );
+}
+
+// Within the deviation allowed from nominal
+template <class Channel, class Sink>
+U64 BitbusDecoder<Channel, Sink>::ClampPeriod ( S64 period ) const
+{
+	const S64 deviation = S64 ( mNominalPeriod >> BITBUS_DPLL_MAX_DEVIATION_SHIFT );
+	return U64 ( max<S64> ( min<S64> ( period, S64 ( mNominalPeriod ) + deviation ), S64 ( mNominalPeriod ) - deviation ) );
+}
+
+template <class Channel, class Sink>
+void BitbusDecoder<Channel, Sink>::ResetBitClock()
+{
+	mBitPeriod = mNominalPeriod;
+	mFrameCells = 0;
+	mFrameSamples = 0;
+}
+
+// Bits per second over the intervals measured in this frame, 0 if none
+template <class Channel, class Sink>
+U64 BitbusDecoder<Channel, Sink>::MeasuredBitRate() const
+{
+	if ( mFrameSamples == 0 )
+	{
+		return 0;
+	}
+	return ( mFrameCells * mSampleRateHz + mFrameSamples / 2 ) / mFrameSamples;
+}
+
+//
+/////////////// ASYNC BYTE TRAMISSION ///////////////////////////////////////////////
+//
+
+// Interframe time fill: ISO/IEC 13239:2002(E) pag. 21
+template <class Channel, class Sink>
+BitbusByte BitbusDecoder<Channel, Sink>::ByteAsyncProcessFlags()
+{
+	bool flagEncountered = false;
+	// Read bytes until non-flag byte
+	BitbusByteBuffer & readBytes = mFlagBytes;
+	readBytes.clear();
+
+	for ( ; ; )
+	{
+		BitbusByte asyncByte = ReadByte();
+		if ( ( asyncByte.value != BITBUS_FLAG_VALUE ) && flagEncountered )
+		{
+			readBytes.push_back ( asyncByte );
+			break;
+		}
+		else if ( asyncByte.value == BITBUS_FLAG_VALUE )
+		{
+			readBytes.push_back ( asyncByte );
+			flagEncountered = true;
+		}
+		if ( mAbortFrame )
+		{
+			GenerateFlagsFrames ( readBytes );
+			BitbusByte b;
+			b.startSample = 0;
+			b.endSample = 0;
+			b.value = 0;
+			return b;
+		}
+
+	}
+
+	GenerateFlagsFrames ( readBytes );
+
+	BitbusByte nonFlagByte = readBytes.back();
+	return nonFlagByte;
+
+}
+
+template <class Channel, class Sink>
+void BitbusDecoder<Channel, Sink>::GenerateFlagsFrames ( const BitbusByteBuffer & readBytes )
+{
+	// 2) Generate the flag frames and return non-flag byte after the flags
+	for ( U32 i=0; i<readBytes.size()-1; ++i )
+	{
+		const BitbusByte & asyncByte = readBytes[ i ];
+
+		BitbusFrame frame = CreateFrame ( BITBUS_FIELD_FLAG, asyncByte.startSample, asyncByte.endSample, 0, 0,
+		                                  ByteFlags ( asyncByte ) );
+
+		if ( i == readBytes.size() - 2 ) // start flag
+		{
+			frame.mData1 = BITBUS_FLAG_START;
+		}
+		else // fill flag
+		{
+			frame.mData1 = BITBUS_FLAG_FILL;
+		}
+
+		AddFrameToResults ( frame );
+	}
+}
+
+template <class Channel, class Sink>
+void BitbusDecoder<Channel, Sink>::ProcessAddressField ( BitbusByte byteAfterFlag )
+{
+        U8 addressSize = 2;
+        BitbusByte addressByte = byteAfterFlag;
+        BitbusByte startByte = byteAfterFlag;
+        U64 addressValue = 0;
+
+	if ( mAbortFrame )
+	{
+		return;
+	}
+
+        addressByte = ReadByte();
+        switch (mSettings.mBitbusAddressingMode) {
+        case BITBUS_ADDRESS_SOF:
+            {
+                addressSize--;
+                U8 flag = ByteFlags ( byteAfterFlag );
+
+		BitbusFrame frame = CreateFrame ( BITBUS_FIELD_SOH, byteAfterFlag.startSample,
+		                            byteAfterFlag.endSample, byteAfterFlag.value, 0, flag );
+		AddFrameToResults ( frame );
+		// Put a marker in the beggining of the BITBUS frame
+                //mResults->AddMarker ( frame.mStartingSampleInclusive, AnalyzerResults::Start, mSettings.mInputChannel );
+                startByte = addressByte;
+            }
+            // fall through
+        case BITBUS_ADDRESS_EXTENDED:
+            {
+                addressValue = (byteAfterFlag.value<<8);
+                addressValue += addressByte.value;
+                // Two bytes: only a framing error shows
+                U8 flag = ( ByteFlags ( startByte ) | ByteFlags ( addressByte ) ) & BITBUS_FRAMING_ERROR;
+                BitbusFrame frame = CreateFrame ( BITBUS_FIELD_ADDRESS, startByte.startSample,
+                                           addressByte.endSample, addressValue, 0, flag );
+
+                AddFrameToResults ( frame );
+            }
+            break;
+        case BITBUS_ADDRESS_ADDR_RESERVED:
+            {
+                U8 flag = ByteFlags ( byteAfterFlag );
+
+                BitbusFrame frame = CreateFrame ( BITBUS_FIELD_ADDRESS, byteAfterFlag.startSample,
+                                     byteAfterFlag.endSample, byteAfterFlag.value, 0, flag );
+                AddFrameToResults ( frame );
+
+
+                frame = CreateFrame ( BITBUS_FIELD_RESERVED, addressByte.startSample,
+		                            addressByte.endSample, addressByte.value, 0, ByteFlags ( addressByte ) & BITBUS_FRAMING_ERROR );
+		AddFrameToResults ( frame );
+
+            }
+            break;
+        default:
+            break;
+        }
+}
+
+template <class Channel, class Sink>
+void BitbusDecoder<Channel, Sink>::ReadProcessAndFcsField()
+{
+	BitbusByteBuffer & infoAndFcs = mFrameBytes;
+	infoAndFcs.clear();
+        if ( mAbortFrame )
+        {
+                return;
+        }
+
+	for ( ; ; )
+	{
+		BitbusByte asyncByte = ReadByte();
+                if ( mAbortFrame )
+		{
+			return;
+		}
+		if ( ( asyncByte.value == BITBUS_FLAG_VALUE ) && mFoundEndFlag ) // End of frame found
+		{
+			mEndFlagFrame = CreateFrame ( BITBUS_FIELD_FLAG, asyncByte.startSample, asyncByte.endSample, BITBUS_FLAG_END,
+			                              MeasuredBitRate(), ByteFlags ( asyncByte ) );
+			mFoundEndFlag = false;
+			break;
+		}
+		else  // information or fcs byte
+		{
+			infoAndFcs.push_back ( asyncByte );
+                }
+        }
+}
+
+template <class Channel, class Sink>
+void BitbusDecoder<Channel, Sink>::ProcessInfoAndFcsField()
+{
+	ReadProcessAndFcsField();
+
+	InfoAndFcsField ( mFrameBytes );
+}
+
+template <class Channel, class Sink>
+void BitbusDecoder<Channel, Sink>::InfoAndFcsField ( const BitbusByteBuffer & informationAndFcs )
+{
+        U32 informationBytes = U32 ( informationAndFcs.size() );
+        bool hasFcs = false;
+        if (!mAbortFrame ) {
+                // The FCS is the last FcsBytes() bytes: split in place, nothing copied
+                const U32 fcsBytes = BitbusDecoderSettings::FcsBytes ( mSettings.mFcsType );
+                if ( informationBytes >= fcsBytes )
+                {
+                        informationBytes -= fcsBytes;
+                        hasFcs = true;
+                }
+
+        }
+        ProcessInformationField ( informationAndFcs, informationBytes );
+
+        if ( !mAbortFrame )
+        {
+                if ( hasFcs )
+                {
+                        ProcessFcsField ( informationAndFcs, informationBytes );
+                }
+        }
+
+}
+
+template <class Channel, class Sink>
+void BitbusDecoder<Channel, Sink>::ProcessInformationField ( const BitbusByteBuffer & information, U32 count )
+{
+	for ( U32 i=0; i<count; ++i )
+	{
+		const BitbusByte & byte = information[ i ];
+		U8 flag = ByteFlags ( byte );
+		BitbusFrame frame = CreateFrame ( BITBUS_FIELD_INFORMATION, byte.startSample,
+		                            byte.endSample, byte.value, i, flag );
+		AddFrameToResults ( frame );
+	}
+}
+
+template <class Channel, class Sink>
+void BitbusDecoder<Channel, Sink>::AddFrameToResults ( const BitbusFrame & frame )
+{
+	mStats.AddField ( frame );
+	mSink.AddDecodedFrame ( frame );
+}
+
+template <class Channel, class Sink>
+void BitbusDecoder<Channel, Sink>::AddMarker ( U64 sample, BitbusMarkerType type )
+{
+	BITBUS_TRACE_EVENT ( BITBUS_TRACE_MARKER, sample, type );
+	mStats.AddMarker ( type );
+	mSink.AddDecodedMarker ( sample, type );
+}
+
+template <class Channel, class Sink>
+void BitbusDecoder<Channel, Sink>::ProcessFcsField ( const BitbusByteBuffer & bytes, U32 first )
+{
+	const U32 fcsBytes = U32 ( bytes.size() ) - first;
+	U64 readFcsValue = BitbusBytesToValue ( bytes, first, fcsBytes );
+
+	// The running FCS held the FCS bytes back, so it covers exactly the frame before them
+	U64 calculatedFcsValue = mFcs.CalculatedFcs();
+
+	U8 flags = 0;
+	for ( U32 i=first; i < bytes.size(); ++i )
+	{
+		flags |= ByteFlags ( bytes[ i ] ) & BITBUS_FRAMING_ERROR;
+	}
+	BitbusFrame frame = CreateFrame ( BITBUS_FIELD_FCS, bytes[ first ].startSample, bytes.back().endSample,
+	                            readFcsValue, calculatedFcsValue, flags );
+
+	if ( calculatedFcsValue != readFcsValue )
+	{
+		frame.mFlags |= BITBUS_DISPLAY_AS_ERROR;
+	}
+
+	AddFrameToResults ( frame );
+
+        if ( calculatedFcsValue != readFcsValue ) {
+                AddMarker ( frame.mEndingSampleInclusive, BITBUS_MARKER_FCS_ERROR );
+        }
+}
+
+template <class Channel, class Sink>
+BitbusByte BitbusDecoder<Channel, Sink>::ReadByte()
+{
+	BitbusByte byte = ( mSettings.mTransmissionMode == BITBUS_TRANSMISSION_BYTE_ASYNC )
+	                  ? ByteAsyncReadByte() : BitSyncReadByte();
+	if ( !mAbortFrame )
+	{
+		BITBUS_TRACE_EVENT ( BITBUS_TRACE_BYTE, byte.startSample, byte.value );
+	}
+	return byte;
+}
+
+// Scans the decoded bytes for flags and escapes: an escaped byte is taken
+// with the byte after it, an escape before a flag aborts the frame
+template <class Channel, class Sink>
+BitbusByte BitbusDecoder<Channel, Sink>::ByteAsyncReadByte()
+{
+	BitbusByte ret = ByteAsyncDecodeByte();
+	if ( !mReadingFrame )
+	{
+		return ret;
+	}
+
+	switch ( ret.value )
+	{
+	case BITBUS_FLAG_VALUE:
+		mFoundEndFlag = true;
+		break;
+	case BITBUS_ESCAPE_SEQ_VALUE:
+		{
+			BitbusByte escape = ret;
+			ret = ByteAsyncDecodeByte();
+			ret.framingError |= escape.framingError;
+
+			if ( ret.value == BITBUS_FLAG_VALUE ) // abort sequence = ESCAPE_BYTE + FLAG_BYTE (0x7D-0x7E)
+			{
+				// Create "Abort Frame" frame
+				mAbtFrame = CreateFrame ( BITBUS_ABORT_SEQ, escape.startSample, ret.endSample );
+				mAbortFrame = true;
+				return ret;
+			}
+			// Real data: with the bit-5 inverted (that's what we use for the crc)
+			mFcs.AddByte ( BitbusDecoderSettings::Bit5Inv ( ret.value ) );
+			ret.startSample = escape.startSample;
+			ret.escaped = true;
+		}
+		break;
+	default:
+		mFcs.AddByte ( ret.value );
+		break;
+	}
+	return ret;
+}
+
+// One start/stop character, decoded from the edges in it rather than bit
+// by bit: the line is read at each bit's middle, so an edge moves the level
+// for the bits whose middle is after it (or right on it). The channel is
+// called once per edge and once to the middle of the stop bit, which is
+// checked for framing errors on the way.
+template <class Channel, class Sink>
+BitbusByte BitbusDecoder<Channel, Sink>::ByteAsyncDecodeByte()
+{
+	mSink.BeforeChannelRead();
+
+	// Line must be HIGH here
+	if ( mChannel->GetBitState() == BIT_LOW )
+	{
+		mChannel->AdvanceToNextEdge();
+	}
+
+	mChannel->AdvanceToNextEdge(); // high->low transition (start bit)
+
+	const U64 startEdge = mChannel->GetSampleNumber();
+	const U64 stopMiddle = mAsyncBitMiddles[ BITBUS_ASYNC_STOP_BIT ];
+	U64 offset = 0;
+	U32 bits = 0; // at their position in the character: start bit, data LSB first, stop bit
+	U32 bit = 1;  // the start bit is not read
+	bool high = false;
+
+	while ( mChannel->WouldAdvancingCauseTransition ( U32 ( stopMiddle - offset ) ) )
+	{
+		mChannel->AdvanceToNextEdge();
+		offset = mChannel->GetSampleNumber() - startEdge;
+		for ( ; mAsyncBitMiddles[ bit ] < offset; ++bit )
+		{
+			bits |= high ? ( 1 << bit ) : 0;
+		}
+		high = !high;
+	}
+	mChannel->Advance ( U32 ( stopMiddle - offset ) );
+	for ( ; bit < BITBUS_ASYNC_CHARACTER_BITS; ++bit )
+	{
+		bits |= high ? ( 1 << bit ) : 0;
+	}
+
+	const U64 halfBit = mAsyncBitMiddles[ 0 ];
+	BitbusByte asyncByte;
+	asyncByte.startSample = startEdge + 2 * halfBit;
+	asyncByte.endSample = startEdge + mAsyncBitMiddles[ BITBUS_ASYNC_STOP_BIT - 1 ] + halfBit;
+	asyncByte.value = U8 ( bits >> 1 );
+	asyncByte.escaped = false;
+	asyncByte.framingError = ( bits & ( 1 << BITBUS_ASYNC_STOP_BIT ) ) == 0;
+
+	if ( asyncByte.framingError )
+	{
+		AddMarker ( startEdge + stopMiddle, BITBUS_MARKER_FRAMING_ERROR );
+	}
+	return asyncByte;
+}
+
+
+//
+///////////////////////////// Helper functions ///////////////////////////////////////////
+//
+
+// "Ctor" for the BitbusFrame struct
+template <class Channel, class Sink>
+BitbusFrame BitbusDecoder<Channel, Sink>::CreateFrame ( U8 mType, U64 mStartingSampleInclusive, U64 mEndingSampleInclusive,
+                                  U64 mData1, U64 mData2, U8 mFlags ) const
+{
+	BitbusFrame frame;
+	frame.mStartingSampleInclusive = mStartingSampleInclusive;
+	frame.mEndingSampleInclusive = mEndingSampleInclusive;
+	frame.mType = mType;
+	frame.mData1 = mData1;
+	frame.mData2 = mData2;
+	frame.mFlags = mFlags;
+	return frame;
+}
+
+// Bytes in transmission order, the first one in the most significant position
+template <class Channel, class Sink>
+U64 BitbusDecoder<Channel, Sink>::BitbusBytesToValue ( const BitbusByteBuffer & bytes, U32 first, U32 count ) const
+{
+	U64 value=0;
+	for ( U32 i=first; i < first + count; ++i )
+	{
+		// Escaped bytes keep their on-the-wire value, the FCS was computed over the real one
+		U8 byte = bytes[ i ].escaped ? BitbusDecoderSettings::Bit5Inv ( bytes[ i ].value ) : bytes[ i ].value;
+		value = ( value << 8 ) | byte;
+	}
+	return value;
+}
+
+// mFlags of the field of one byte
+template <class Channel, class Sink>
+U8 BitbusDecoder<Channel, Sink>::ByteFlags ( const BitbusByte & byte ) const
+{
+	return U8 ( ( byte.escaped ? BITBUS_ESCAPED_BYTE : 0 ) | ( byte.framingError ? BITBUS_FRAMING_ERROR : 0 ) );
+}
+
+#endif //BITBUS_DECODER_H
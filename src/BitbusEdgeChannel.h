@@ -0,0 +1,435 @@
+#ifndef BITBUS_EDGE_CHANNEL_H
+#define BITBUS_EDGE_CHANNEL_H
+
+#include "BitbusTypes.h"
+#include <algorithm>
+#include <vector>
+
+// Thrown by BitbusEdgeChannel when the decoder reads past the end of the data
+struct BitbusEndOfData
+{
+};
+
+// In-memory channel for BitbusDecoder: the line starts at initialState and
+// toggles at each of the (ascending) edge samples. Data ends at endSample.
+// The edges are not copied, they must outlive the channel.
+class BitbusEdgeChannel
+{
+public:
+	BitbusEdgeChannel ( BitState initialState, const U64* edges, U64 edgeCount, U64 endSample ) :
+		mInitialState ( initialState ), mEdges ( edges ), mEdgeCount ( edgeCount ), mEndSample ( endSample ),
+		mSample ( 0 ), mNextEdge ( 0 )
+	{
+	}
+
+	BitState GetBitState() const
+	{
+		return ( mNextEdge & 1 ) ? Inverted ( mInitialState ) : mInitialState;
+	}
+
+	U64 GetSampleNumber() const
+	{
+		return mSample;
+	}
+
+	void Advance ( U32 samples )
+	{
+		NeedData ( mSample + samples );
+		mSample += samples;
+		while ( ( mNextEdge < mEdgeCount ) && ( mEdges[ mNextEdge ] <= mSample ) )
+		{
+			mNextEdge++;
+		}
+	}
+
+	void AdvanceToNextEdge()
+	{
+		if ( mNextEdge >= mEdgeCount )
+		{
+			throw BitbusEndOfData();
+		}
+		mSample = mEdges[ mNextEdge++ ];
+	}
+
+	bool WouldAdvancingCauseTransition ( U32 samples ) const
+	{
+		if ( ( mNextEdge < mEdgeCount ) && ( mEdges[ mNextEdge ] <= mSample + samples ) )
+		{
+			return true;
+		}
+		NeedData ( mSample + samples );
+		return false;
+	}
+
+	bool DoMoreTransitionsExistInCurrentData() const
+	{
+		return mNextEdge < mEdgeCount;
+	}
+
+	// Not Toggle: that is a macro in the SDK
+	static BitState Inverted ( BitState state )
+	{
+		return ( state == BIT_LOW ) ? BIT_HIGH : BIT_LOW;
+	}
+
+protected:
+	void NeedData ( U64 sample ) const
+	{
+		if ( sample > mEndSample )
+		{
+			throw BitbusEndOfData();
+		}
+	}
+
+	BitState mInitialState;
+	const U64* mEdges;
+	U64 mEdgeCount;
+	U64 mEndSample;
+
+	U64 mSample;
+	U64 mNextEdge;
+};
+
+// Where BitbusStreamChannel gets its edges from (a capture file, say)
+class BitbusEdgeSource
+{
+public:
+	virtual ~BitbusEdgeSource() {}
+
+	// Next edge in ascending sample order, false when there are no more
+	virtual bool NextEdge ( U64 & sample ) = 0;
+	// Last sample of the data; only asked once NextEdge() has returned false
+	virtual U64 GetEndSample() const = 0;
+
+	// Moves to sample: NextEdge() goes on with the first edge after it and
+	// state is the line state at it. False if the source cannot seek.
+	virtual bool Seek ( U64 /*sample*/, BitState & /*state*/ )
+	{
+		return false;
+	}
+};
+
+// Edges held in memory (ascending, not copied), seekable
+class BitbusEdgeArraySource : public BitbusEdgeSource
+{
+public:
+	BitbusEdgeArraySource ( BitState initialState, const U64* edges, U64 edgeCount, U64 endSample ) :
+		mInitialState ( initialState ), mEdges ( edges ), mEdgeCount ( edgeCount ), mEndSample ( endSample ), mNext ( 0 )
+	{
+	}
+
+	virtual bool NextEdge ( U64 & sample )
+	{
+		if ( mNext >= mEdgeCount )
+		{
+			return false;
+		}
+		sample = mEdges[ mNext++ ];
+		return true;
+	}
+
+	virtual U64 GetEndSample() const
+	{
+		return mEndSample;
+	}
+
+	virtual bool Seek ( U64 sample, BitState & state )
+	{
+		mNext = U64 ( std::upper_bound ( mEdges, mEdges + mEdgeCount, sample ) - mEdges );
+		state = ( mNext & 1 ) ? BitbusEdgeChannel::Inverted ( mInitialState ) : mInitialState;
+		return true;
+	}
+
+protected:
+	BitState mInitialState;
+	const U64* mEdges;
+	U64 mEdgeCount;
+	U64 mEndSample;
+	U64 mNext;
+};
+
+// Channel for BitbusDecoder that pulls edges from a BitbusEdgeSource as
+// the decoder moves along, one edge ahead: captures of any size are read
+// in constant memory.
+class BitbusStreamChannel
+{
+public:
+	BitbusStreamChannel ( BitState initialState, BitbusEdgeSource & source ) :
+		mSource ( source ), mState ( initialState ), mSample ( 0 ), mNextEdge ( 0 ), mHasNextEdge ( false )
+	{
+		mHasNextEdge = mSource.NextEdge ( mNextEdge );
+	}
+
+	BitState GetBitState() const
+	{
+		return mState;
+	}
+
+	U64 GetSampleNumber() const
+	{
+		return mSample;
+	}
+
+	void Advance ( U32 samples )
+	{
+		NeedData ( mSample + samples );
+		mSample += samples;
+		while ( mHasNextEdge && ( mNextEdge <= mSample ) )
+		{
+			TakeEdge();
+		}
+	}
+
+	void AdvanceToNextEdge()
+	{
+		if ( !mHasNextEdge )
+		{
+			throw BitbusEndOfData();
+		}
+		mSample = mNextEdge;
+		TakeEdge();
+	}
+
+	bool WouldAdvancingCauseTransition ( U32 samples ) const
+	{
+		if ( mHasNextEdge && ( mNextEdge <= mSample + samples ) )
+		{
+			return true;
+		}
+		NeedData ( mSample + samples );
+		return false;
+	}
+
+	bool DoMoreTransitionsExistInCurrentData() const
+	{
+		return mHasNextEdge;
+	}
+
+	// Jumps to sample, backwards or forwards, if the source can seek
+	bool Seek ( U64 sample )
+	{
+		BitState state;
+		if ( !mSource.Seek ( sample, state ) )
+		{
+			return false;
+		}
+		mState = state;
+		mSample = sample;
+		mHasNextEdge = mSource.NextEdge ( mNextEdge );
+		return true;
+	}
+
+protected:
+	void TakeEdge()
+	{
+		mState = ( mState == BIT_LOW ) ? BIT_HIGH : BIT_LOW;
+		mHasNextEdge = mSource.NextEdge ( mNextEdge );
+	}
+
+	void NeedData ( U64 sample ) const
+	{
+		if ( !mHasNextEdge && ( sample > mSource.GetEndSample() ) )
+		{
+			throw BitbusEndOfData();
+		}
+	}
+
+	BitbusEdgeSource & mSource;
+	BitState mState;
+	U64 mSample;
+	U64 mNextEdge;
+	bool mHasNextEdge;
+};
+
+// Channel for BitbusDecoder over another channel that edges were read
+// ahead from (to detect the bit rate, or in blocks, see ReadAhead()): the
+// decoder is given those edges again, then goes on with the channel itself.
+template <class Channel>
+class BitbusReadAheadChannel
+{
+public:
+	BitbusReadAheadChannel() :
+		mChannel ( 0 ), mState ( BIT_LOW ), mSample ( 0 ), mNextEdge ( 0 ), mReplaying ( false )
+	{
+	}
+
+	void Setup ( Channel* channel, U32 maxEdges )
+	{
+		mChannel = channel;
+		mReplaying = false;
+		ReadAhead ( maxEdges );
+	}
+
+	// Reads up to maxEdges edges ahead, no more than the channel has data
+	// for already (a Logic channel would wait for more to be captured), once
+	// the edges read ahead before have all been given. False when there are
+	// none: the next edge read may wait.
+	bool ReadAhead ( U32 maxEdges )
+	{
+		if ( mReplaying )
+		{
+			return true;
+		}
+		mState = mChannel->GetBitState();
+		mSample = mChannel->GetSampleNumber();
+		mEdges.clear();
+		mNextEdge = 0;
+		while ( ( mEdges.size() < maxEdges ) && mChannel->DoMoreTransitionsExistInCurrentData() )
+		{
+			mChannel->AdvanceToNextEdge();
+			mEdges.push_back ( mChannel->GetSampleNumber() );
+		}
+		mReplaying = !mEdges.empty();
+		return mReplaying;
+	}
+
+	const std::vector<U64> & GetReadAheadEdges() const
+	{
+		return mEdges;
+	}
+
+	BitState GetBitState() const
+	{
+		return mReplaying ? mState : mChannel->GetBitState();
+	}
+
+	U64 GetSampleNumber() const
+	{
+		return mReplaying ? mSample : mChannel->GetSampleNumber();
+	}
+
+	void Advance ( U32 samples )
+	{
+		if ( !mReplaying )
+		{
+			mChannel->Advance ( samples );
+			return;
+		}
+		U64 sample = mSample + samples;
+		if ( sample >= mEdges.back() )
+		{
+			// Past the edges read ahead: the channel is at the last of them
+			mReplaying = false;
+			mChannel->Advance ( U32 ( sample - mEdges.back() ) );
+			return;
+		}
+		mSample = sample;
+		while ( mEdges[ mNextEdge ] <= mSample )
+		{
+			TakeEdge();
+		}
+	}
+
+	void AdvanceToNextEdge()
+	{
+		if ( !mReplaying )
+		{
+			mChannel->AdvanceToNextEdge();
+			return;
+		}
+		mSample = mEdges[ mNextEdge ];
+		TakeEdge();
+		mReplaying = ( mNextEdge < mEdges.size() );
+	}
+
+	bool WouldAdvancingCauseTransition ( U32 samples ) const
+	{
+		if ( !mReplaying )
+		{
+			return mChannel->WouldAdvancingCauseTransition ( samples );
+		}
+		return mEdges[ mNextEdge ] <= mSample + samples;
+	}
+
+	bool DoMoreTransitionsExistInCurrentData() const
+	{
+		return mReplaying || mChannel->DoMoreTransitionsExistInCurrentData();
+	}
+
+protected:
+	void TakeEdge()
+	{
+		mState = ( mState == BIT_LOW ) ? BIT_HIGH : BIT_LOW;
+		mNextEdge++;
+	}
+
+	Channel* mChannel;
+	std::vector<U64> mEdges;
+	BitState mState;
+	U64 mSample;
+	U64 mNextEdge;
+	bool mReplaying;
+};
+
+// Channel for BitbusDecoder over another one, counting the calls made to
+// it and the edges moved to, for BitbusDecodeStats
+template <class Channel>
+class BitbusCountingChannel
+{
+public:
+	BitbusCountingChannel() :
+		mChannel ( 0 ), mCalls ( 0 ), mEdges ( 0 )
+	{
+	}
+
+	void Setup ( Channel* channel )
+	{
+		mChannel = channel;
+		mCalls = 0;
+		mEdges = 0;
+	}
+
+	U64 GetCallCount() const
+	{
+		return mCalls;
+	}
+
+	U64 GetEdgeCount() const
+	{
+		return mEdges;
+	}
+
+	BitState GetBitState() const
+	{
+		mCalls++;
+		return mChannel->GetBitState();
+	}
+
+	U64 GetSampleNumber() const
+	{
+		mCalls++;
+		return mChannel->GetSampleNumber();
+	}
+
+	void Advance ( U32 samples )
+	{
+		mCalls++;
+		mChannel->Advance ( samples );
+	}
+
+	void AdvanceToNextEdge()
+	{
+		mCalls++;
+		mChannel->AdvanceToNextEdge();
+		mEdges++;
+	}
+
+	bool WouldAdvancingCauseTransition ( U32 samples ) const
+	{
+		mCalls++;
+		return mChannel->WouldAdvancingCauseTransition ( samples );
+	}
+
+	bool DoMoreTransitionsExistInCurrentData() const
+	{
+		mCalls++;
+		return mChannel->DoMoreTransitionsExistInCurrentData();
+	}
+
+protected:
+	Channel* mChannel;
+	mutable U64 mCalls;
+	U64 mEdges;
+};
+
+#endif //BITBUS_EDGE_CHANNEL_H
@@ -0,0 +1,314 @@
+#ifndef BITBUS_FIELD_TEXT_H
+#define BITBUS_FIELD_TEXT_H
+
+#include "BitbusFormat.h"
+
+using namespace std;
+
+// Bubble and tabular text of a decoded BITBUS field, put together in fixed
+// buffers (BitbusFixedText): nothing is allocated per field.
+//
+// Out takes the strings like the SDK's AnalyzerResults:
+//   void AddResultString ( const char* str1, ... ); // up to 6 strings
+//   void AddTabularText ( const char* str1, ... );
+template <class Out>
+class BitbusFieldText
+{
+public:
+	BitbusFieldText ( const BitbusDecoderSettings & settings, BitbusNumberFormatter numberString );
+
+	// Bubble strings (shortest first) or, if tabular, the tabular text of frame
+	void Generate ( Out & out, const BitbusFrame & frame, DisplayBase display_base, bool tabular );
+
+protected:
+	void GenFlagFieldString ( Out & out, const BitbusFrame & frame, bool tabular );
+	void GenAddressFieldString ( Out & out, const BitbusFrame & frame, bool tabular );
+	void GenSOHFieldString ( Out & out, const BitbusFrame & frame, bool tabular );
+	void GenInformationFieldString ( Out & out, const BitbusFrame & frame, bool tabular );
+	void GenFcsFieldString ( Out & out, const BitbusFrame & frame, DisplayBase display_base, bool tabular );
+	void GenReservedFieldString ( Out & out, const BitbusFrame & frame, bool tabular );
+	void GenAbortFieldString ( Out & out, bool tabular );
+
+	void GenEscapedString ( BitbusFixedText & text, const BitbusFrame & frame );
+	void GenFramingErrorString ( BitbusFixedText & text, const BitbusFrame & frame );
+	void genNumberInfo ( BitbusFixedText & text, const BitbusFrame & frame );
+
+	const BitbusDecoderSettings & mSettings;
+	BitbusNumberFormatter mNumberString;
+};
+
+template <class Out>
+BitbusFieldText<Out>::BitbusFieldText ( const BitbusDecoderSettings & settings, BitbusNumberFormatter numberString )
+	:	mSettings ( settings ),
+	    mNumberString ( numberString )
+{
+}
+
+template <class Out>
+void BitbusFieldText<Out>::Generate ( Out & out, const BitbusFrame & frame, DisplayBase display_base, bool tabular )
+{
+        switch ( frame.mType )
+        {
+        case BITBUS_FIELD_FLAG:
+                GenFlagFieldString ( out, frame, tabular );
+                break;
+        case BITBUS_FIELD_SOH:
+                GenSOHFieldString ( out, frame, tabular );
+                break;
+        case BITBUS_FIELD_ADDRESS:
+                GenAddressFieldString ( out, frame, tabular );
+                break;
+        case BITBUS_FIELD_INFORMATION:
+                GenInformationFieldString ( out, frame, tabular );
+                break;
+        case BITBUS_FIELD_FCS:
+                GenFcsFieldString ( out, frame, display_base, tabular );
+                break;
+        case BITBUS_ABORT_SEQ:
+                GenAbortFieldString ( out, tabular );
+                break;
+        case BITBUS_FIELD_RESERVED:
+                GenReservedFieldString ( out, frame, tabular );
+                break;
+
+        }
+}
+
+template <class Out>
+void BitbusFieldText<Out>::GenFlagFieldString ( Out & out, const BitbusFrame & frame, bool tabular )
+{
+        const char* flagTypeStr=0;
+        switch ( frame.mData1 )
+        {
+        case BITBUS_FLAG_START:
+                flagTypeStr = "Start";
+                break;
+        case BITBUS_FLAG_END:
+                flagTypeStr = "End";
+                break;
+        case BITBUS_FLAG_FILL:
+                flagTypeStr = "Fill";
+                break;
+        default:
+                flagTypeStr = "Invalid";
+                break;
+        }
+
+        // The bit rate measured over the frame, on its End flag
+        BitbusFixedText rateStr;
+        if ( ( frame.mData1 == BITBUS_FLAG_END ) && ( frame.mData2 != 0 ) )
+        {
+                rateStr.Append ( " (" );
+                rateStr.AppendNumber ( frame.mData2, Decimal, 32, mNumberString );
+                rateStr.Append ( " bit/s)" );
+        }
+        GenFramingErrorString ( rateStr, frame );
+
+        if ( !tabular )
+        {
+                out.AddResultString ( "F" );
+                out.AddResultString ( "FL" );
+                out.AddResultString ( "FLAG" );
+                out.AddResultString ( flagTypeStr, " FLAG" );
+                out.AddResultString ( flagTypeStr, " Flag Delimiter", rateStr.c_str() );
+        } else {
+                out.AddTabularText( flagTypeStr, " Flag Delimiter", rateStr.c_str() );
+        }
+}
+
+template <class Out>
+void BitbusFieldText<Out>::GenAbortFieldString ( Out & out, bool tabular )
+{
+        const char* seq = 0;
+        if ( mSettings.mTransmissionMode == BITBUS_TRANSMISSION_BIT_SYNC )
+        {
+                seq = "(>=7 1-bits)";
+        }
+        else
+        {
+                seq = "(0x7D-0x7F)";
+        }
+
+        if ( !tabular )
+        {
+                out.AddResultString ( "AB!" );
+                out.AddResultString ( "ABORT!" );
+                out.AddResultString ( "ABORT SEQUENCE!", seq );
+        }
+        else
+        {
+                out.AddTabularText( "ABORT SEQUENCE!", seq );
+        }
+}
+
+template <class Out>
+void BitbusFieldText<Out>::GenEscapedString ( BitbusFixedText & text, const BitbusFrame & frame )
+{
+	if ( frame.mFlags & BITBUS_ESCAPED_BYTE )
+	{
+		text.Append ( " - ESCAPED: 0x7D-" );
+		text.AppendNumber ( frame.mData1, Hexadecimal, 8, mNumberString );
+		text.Append ( '=' );
+		text.AppendNumber ( BitbusDecoderSettings::Bit5Inv ( U8 ( frame.mData1 ) ), Hexadecimal, 8, mNumberString );
+	}
+	GenFramingErrorString ( text, frame );
+}
+
+template <class Out>
+void BitbusFieldText<Out>::GenFramingErrorString ( BitbusFixedText & text, const BitbusFrame & frame )
+{
+	if ( frame.mFlags & BITBUS_FRAMING_ERROR )
+	{
+		text.Append ( " - FRAMING ERROR" );
+	}
+}
+
+template <class Out>
+void BitbusFieldText<Out>::genNumberInfo ( BitbusFixedText & text, const BitbusFrame & frame )
+{
+	text.AppendNumber ( frame.mData1, Decimal, 8, mNumberString );
+	text.Append ( " [" );
+	text.AppendNumber ( frame.mData1, Hexadecimal, 8, mNumberString );
+	text.Append ( ']' );
+}
+
+template <class Out>
+void BitbusFieldText<Out>::GenAddressFieldString ( Out & out, const BitbusFrame & frame, bool tabular )
+{
+        BitbusFixedText addrStr;
+        genNumberInfo ( addrStr, frame );
+        BitbusFixedText escStr;
+        GenEscapedString ( escStr, frame );
+
+        if ( !tabular )
+        {
+                out.AddResultString ( "A" );
+                out.AddResultString ( "AD" );
+                out.AddResultString ( "ADDR" );
+                out.AddResultString ( "ADDR ", addrStr.c_str(), escStr.c_str() );
+                out.AddResultString ( "Address ", addrStr.c_str(), escStr.c_str() );
+        }
+        else {
+                out.AddTabularText( "Address ", addrStr.c_str(), escStr.c_str() );
+        }
+}
+
+template <class Out>
+void BitbusFieldText<Out>::GenReservedFieldString ( Out & out, const BitbusFrame & frame, bool tabular )
+{
+        BitbusFixedText rsvdStr;
+        genNumberInfo ( rsvdStr, frame );
+        BitbusFixedText escStr;
+	GenEscapedString ( escStr, frame );
+
+        if ( !tabular )
+        {
+                out.AddResultString ( "R" );
+                out.AddResultString ( "RS" );
+                out.AddResultString ( "RSV" );
+                out.AddResultString ( "RSVD ", rsvdStr.c_str(), escStr.c_str() );
+                out.AddResultString ( "Reserved ", rsvdStr.c_str(), escStr.c_str() );
+        }
+        else {
+                out.AddTabularText( "Reserved ", rsvdStr.c_str(), escStr.c_str() );
+        }
+}
+
+template <class Out>
+void BitbusFieldText<Out>::GenSOHFieldString ( Out & out, const BitbusFrame & frame, bool tabular )
+{
+        BitbusFixedText sohStr;
+        genNumberInfo ( sohStr, frame );
+
+        BitbusFixedText escStr;
+	GenEscapedString ( escStr, frame );
+
+        if ( !tabular )
+        {
+                out.AddResultString ( "S" );
+                out.AddResultString ( "SO" );
+                out.AddResultString ( "SOH" );
+                out.AddResultString ( "SOH ", sohStr.c_str(), escStr.c_str() );
+                out.AddResultString ( "SOH ", sohStr.c_str(), escStr.c_str() );
+        }
+        else {
+                out.AddTabularText( "Start Of Header ", sohStr.c_str(), escStr.c_str() );
+        }
+}
+
+template <class Out>
+void BitbusFieldText<Out>::GenInformationFieldString ( Out & out, const BitbusFrame & frame, bool tabular )
+{
+        BitbusFixedText informationStr;
+        genNumberInfo ( informationStr, frame );
+	char numberDigits[ 32 ];
+	numberDigits[ 31 ] = 0;
+	const char* numberStr = BitbusFormatDecimal ( frame.mData2, 32, numberDigits + 31 );
+
+	BitbusFixedText escStr;
+	GenEscapedString ( escStr, frame );
+
+	if ( !tabular )
+	{
+		out.AddResultString ( "I" );
+		out.AddResultString ( "I ", numberStr );
+		out.AddResultString ( "I ", numberStr, " (", informationStr.c_str() ,")", escStr.c_str() );
+                out.AddResultString ( "Info ", numberStr, " (", informationStr.c_str() ,")", escStr.c_str() );
+        }
+        else {
+                out.AddTabularText("Info ", numberStr, " (", informationStr.c_str() ,")", escStr.c_str() );
+        }
+}
+
+template <class Out>
+void BitbusFieldText<Out>::GenFcsFieldString ( Out & out, const BitbusFrame & frame, DisplayBase display_base, bool tabular )
+{
+        U32 fcsBits = mSettings.FcsBits();
+
+	BitbusFixedText fieldNameStr;
+	if ( frame.mFlags & BITBUS_DISPLAY_AS_ERROR )
+	{
+		fieldNameStr.Append ( '!' );
+	}
+
+	fieldNameStr.Append ( "FCS CRC" );
+	fieldNameStr.AppendNumber ( fcsBits, Decimal, 32, mNumberString );
+
+	if ( !tabular )
+	{
+		out.AddResultString ( "CRC" );
+		out.AddResultString ( fieldNameStr.c_str() );
+	}
+
+	if ( frame.mFlags & BITBUS_DISPLAY_AS_ERROR )
+	{
+		fieldNameStr.Append ( " ERROR" );
+	}
+	else
+	{
+		fieldNameStr.Append ( " OK" );
+	}
+
+	if ( !tabular )
+	{
+		out.AddResultString ( fieldNameStr.c_str() );
+	}
+
+	if ( frame.mFlags & BITBUS_DISPLAY_AS_ERROR )
+	{
+		fieldNameStr.Append ( " - CALC CRC[" );
+		fieldNameStr.AppendNumber ( frame.mData2, display_base, fcsBits, mNumberString );
+		fieldNameStr.Append ( "] != READ CRC[" );
+		fieldNameStr.AppendNumber ( frame.mData1, display_base, fcsBits, mNumberString );
+		fieldNameStr.Append ( ']' );
+	}
+	GenFramingErrorString ( fieldNameStr, frame );
+
+    if( !tabular )
+        out.AddResultString ( fieldNameStr.c_str()  );
+    else
+        out.AddTabularText( fieldNameStr.c_str()  );
+
+}
+
+#endif //BITBUS_FIELD_TEXT_H
@@ -0,0 +1,80 @@
+#include "BitbusFormat.h"
+#include <stdio.h>
+
+static void AsciiString ( U64 number, char* result_string, U32 result_string_max_length )
+{
+	if ( ( number >= 0x20 ) && ( number < 0x7F ) )
+	{
+		snprintf ( result_string, result_string_max_length, "%c", char ( number ) );
+	}
+	else
+	{
+		snprintf ( result_string, result_string_max_length, "'%llu'", number );
+	}
+}
+
+void BitbusGetNumberString ( U64 number, DisplayBase display_base, U32 num_data_bits,
+                             char* result_string, U32 result_string_max_length )
+{
+	if ( result_string_max_length == 0 )
+	{
+		return;
+	}
+
+	if ( num_data_bits < 64 )
+	{
+		number &= ( 1ULL << num_data_bits ) - 1;
+	}
+
+	switch ( display_base )
+	{
+	case Binary:
+		{
+			U32 length = 0;
+			for ( const char* prefix = "0b"; *prefix && length + 1 < result_string_max_length; ++prefix )
+			{
+				result_string[ length++ ] = *prefix;
+			}
+			for ( U32 i = num_data_bits; i > 0 && length + 1 < result_string_max_length; --i )
+			{
+				result_string[ length++ ] = ( ( number >> ( i - 1 ) ) & 1 ) ? '1' : '0';
+			}
+			result_string[ length ] = 0;
+		}
+		break;
+	case Hexadecimal:
+		snprintf ( result_string, result_string_max_length, "0x%0*llX", int ( ( num_data_bits + 3 ) / 4 ), number );
+		break;
+	case ASCII:
+		AsciiString ( number, result_string, result_string_max_length );
+		break;
+	case AsciiHex:
+		{
+			char ascii[ 16 ];
+			AsciiString ( number, ascii, sizeof ( ascii ) );
+			snprintf ( result_string, result_string_max_length, "%s (0x%0*llX)", ascii, int ( ( num_data_bits + 3 ) / 4 ), number );
+		}
+		break;
+	case Decimal:
+	default:
+		snprintf ( result_string, result_string_max_length, "%llu", number );
+		break;
+	}
+}
+
+void BitbusGetTimeString ( U64 sample, U64 trigger_sample, U32 sample_rate_hz,
+                           char* result_string, U32 result_string_max_length )
+{
+	const char* sign = "";
+	U64 samples = sample - trigger_sample;
+	if ( sample < trigger_sample )
+	{
+		sign = "-";
+		samples = trigger_sample - sample;
+	}
+
+	// Whole seconds and nanoseconds in integers, so long captures keep every digit
+	U64 seconds = samples / sample_rate_hz;
+	U64 nanoseconds = ( samples % sample_rate_hz ) * 1000000000ULL / sample_rate_hz;
+	snprintf ( result_string, result_string_max_length, "%s%llu.%09llu", sign, seconds, nanoseconds );
+}
@@ -0,0 +1,137 @@
+#ifndef BITBUS_FORMAT_H
+#define BITBUS_FORMAT_H
+
+#include "BitbusTypes.h"
+
+// Same signatures as AnalyzerHelpers::GetNumberString and GetTimeString
+typedef void ( *BitbusNumberFormatter ) ( U64 number, DisplayBase display_base, U32 num_data_bits,
+                                          char* result_string, U32 result_string_max_length );
+typedef void ( *BitbusTimeFormatter ) ( U64 sample, U64 trigger_sample, U32 sample_rate_hz,
+                                        char* result_string, U32 result_string_max_length );
+
+// Formatting for builds without the Logic SDK, in the style of AnalyzerHelpers:
+// hex is 0x-prefixed and zero padded, binary 0b-prefixed, time in seconds
+// from the trigger with nanosecond digits
+void BitbusGetNumberString ( U64 number, DisplayBase display_base, U32 num_data_bits,
+                             char* result_string, U32 result_string_max_length );
+void BitbusGetTimeString ( U64 sample, U64 trigger_sample, U32 sample_rate_hz,
+                           char* result_string, U32 result_string_max_length );
+
+// Hexadecimal (0x, zero padded to the field width) and decimal as
+// AnalyzerHelpers::GetNumberString writes them, without a call or a format
+// string: written backwards, ending just before end; returns the first
+// character. end needs 2 + 16 (or 20) characters before it.
+static inline char* BitbusFormatHexadecimal ( U64 number, U32 num_data_bits, char* end )
+{
+	if ( num_data_bits < 64 )
+	{
+		number &= ( 1ULL << num_data_bits ) - 1;
+	}
+	const char* hex = "0123456789ABCDEF";
+	char* padded = end - ( num_data_bits + 3 ) / 4;
+	char* first = end;
+	do
+	{
+		*--first = hex[ number & 0xF ];
+		number >>= 4;
+	}
+	while ( ( number != 0 ) || ( first > padded ) );
+	*--first = 'x';
+	*--first = '0';
+	return first;
+}
+
+static inline char* BitbusFormatDecimal ( U64 number, U32 num_data_bits, char* end )
+{
+	if ( num_data_bits < 64 )
+	{
+		number &= ( 1ULL << num_data_bits ) - 1;
+	}
+	char* first = end;
+	do
+	{
+		*--first = char ( '0' + number % 10 );
+		number /= 10;
+	}
+	while ( number != 0 );
+	return first;
+}
+
+// Text built up in a fixed buffer, for the bubble and tabular strings: no
+// allocation, and cut short rather than grown
+#define BITBUS_FIXED_TEXT_BYTES 256
+
+class BitbusFixedText
+{
+public:
+	BitbusFixedText() : mLength ( 0 )
+	{
+		mText[ 0 ] = 0;
+	}
+
+	void Clear()
+	{
+		mLength = 0;
+		mText[ 0 ] = 0;
+	}
+
+	void Append ( const char* str )
+	{
+		while ( ( *str != 0 ) && ( mLength + 1 < BITBUS_FIXED_TEXT_BYTES ) )
+		{
+			mText[ mLength++ ] = *str++;
+		}
+		mText[ mLength ] = 0;
+	}
+
+	void Append ( char c )
+	{
+		if ( mLength + 1 < BITBUS_FIXED_TEXT_BYTES )
+		{
+			mText[ mLength++ ] = c;
+			mText[ mLength ] = 0;
+		}
+	}
+
+	void Append ( const BitbusFixedText & text )
+	{
+		Append ( text.c_str() );
+	}
+
+	// Hexadecimal and decimal here, the other bases through numberString
+	void AppendNumber ( U64 number, DisplayBase display_base, U32 num_data_bits, BitbusNumberFormatter numberString )
+	{
+		char digits[ 128 ];
+		char* end = digits + sizeof ( digits ) - 1;
+		*end = 0;
+		switch ( display_base )
+		{
+		case Hexadecimal:
+			Append ( BitbusFormatHexadecimal ( number, num_data_bits, end ) );
+			break;
+		case Decimal:
+			Append ( BitbusFormatDecimal ( number, num_data_bits, end ) );
+			break;
+		default:
+			numberString ( number, display_base, num_data_bits, digits, sizeof ( digits ) );
+			Append ( digits );
+			break;
+		}
+	}
+
+	const char* c_str() const
+	{
+		return mText;
+	}
+
+	U32 GetLength() const
+	{
+		return mLength;
+	}
+
+protected:
+	char mText[ BITBUS_FIXED_TEXT_BYTES ];
+	U32 mLength;
+};
+
+#endif //BITBUS_FORMAT_H
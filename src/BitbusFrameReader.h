@@ -0,0 +1,142 @@
+#ifndef BITBUS_FRAME_READER_H
+#define BITBUS_FRAME_READER_H
+
+#include "BitbusDecoder.h"
+#include "BitbusEdgeChannel.h"
+#include <deque>
+
+using namespace std;
+
+// Decodes on demand for a reader that goes through the frames forward only
+// (BitbusWriteCsvExport): frames are decoded when asked for and dropped
+// once the reader has moved past them, so memory stays flat on any capture.
+template <class Channel>
+class BitbusFrameReader
+{
+public:
+	BitbusFrameReader ( const BitbusDecoderSettings & settings, Channel & channel, U32 sampleRateHz );
+
+	bool HasFrame ( U64 index );
+	// index must not be below the last one asked for
+	BitbusFrame GetFrame ( U64 index );
+	bool UpdateExportProgressAndCheckForCancel ( U64 completed_frames );
+
+	U64 GetDecodedFrameCount() const;
+	U64 GetFcsErrorCount() const;
+	const BitbusHuntStats & GetHuntStats() const;
+	const BitbusDecodeStats & GetStats() const;
+
+	// Sink of the decoder
+	void AddDecodedFrame ( const BitbusFrame & frame );
+	void AddDecodedMarker ( U64 sample, BitbusMarkerType type );
+	void BeforeChannelRead();
+
+protected:
+	BitbusDecoder< Channel, BitbusFrameReader<Channel> > mDecoder;
+	bool mStarted;
+	bool mEndOfData;
+
+	deque<BitbusFrame> mFrames;
+	U64 mFirstFrame; // index of mFrames.front()
+	U64 mFcsErrors;
+};
+
+template <class Channel>
+BitbusFrameReader<Channel>::BitbusFrameReader ( const BitbusDecoderSettings & settings, Channel & channel, U32 sampleRateHz )
+	:	mDecoder ( settings, *this ), mStarted ( false ), mEndOfData ( false ), mFirstFrame ( 0 ), mFcsErrors ( 0 )
+{
+	mDecoder.Setup ( &channel, sampleRateHz );
+}
+
+template <class Channel>
+bool BitbusFrameReader<Channel>::HasFrame ( U64 index )
+{
+	while ( !mFrames.empty() && ( mFirstFrame < index ) )
+	{
+		mFrames.pop_front();
+		mFirstFrame++;
+	}
+
+	try
+	{
+		if ( !mStarted && !mEndOfData )
+		{
+			mStarted = true;
+			mDecoder.Start();
+		}
+		while ( !mEndOfData && ( index >= mFirstFrame + mFrames.size() ) )
+		{
+			mDecoder.ProcessBITBUSFrame();
+		}
+	}
+	catch ( BitbusEndOfData & )
+	{
+		// The frames of a BITBUS frame cut off by the end of the data stay
+		mEndOfData = true;
+	}
+
+	return index < mFirstFrame + mFrames.size();
+}
+
+template <class Channel>
+BitbusFrame BitbusFrameReader<Channel>::GetFrame ( U64 index )
+{
+	if ( !HasFrame ( index ) )
+	{
+		BitbusFrame none = BitbusFrame();
+		return none;
+	}
+	return mFrames[ index - mFirstFrame ];
+}
+
+template <class Channel>
+bool BitbusFrameReader<Channel>::UpdateExportProgressAndCheckForCancel ( U64 /*completed_frames*/ )
+{
+	return false;
+}
+
+template <class Channel>
+U64 BitbusFrameReader<Channel>::GetDecodedFrameCount() const
+{
+	return mFirstFrame + mFrames.size();
+}
+
+template <class Channel>
+U64 BitbusFrameReader<Channel>::GetFcsErrorCount() const
+{
+	return mFcsErrors;
+}
+
+template <class Channel>
+const BitbusHuntStats & BitbusFrameReader<Channel>::GetHuntStats() const
+{
+	return mDecoder.GetHuntStats();
+}
+
+template <class Channel>
+const BitbusDecodeStats & BitbusFrameReader<Channel>::GetStats() const
+{
+	return mDecoder.GetStats();
+}
+
+template <class Channel>
+void BitbusFrameReader<Channel>::AddDecodedFrame ( const BitbusFrame & frame )
+{
+	mFrames.push_back ( frame );
+}
+
+template <class Channel>
+void BitbusFrameReader<Channel>::AddDecodedMarker ( U64 /*sample*/, BitbusMarkerType type )
+{
+	if ( type == BITBUS_MARKER_FCS_ERROR )
+	{
+		mFcsErrors++;
+	}
+}
+
+template <class Channel>
+void BitbusFrameReader<Channel>::BeforeChannelRead()
+{
+}
+
+#endif //BITBUS_FRAME_READER_H
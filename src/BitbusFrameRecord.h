@@ -0,0 +1,201 @@
+#ifndef BITBUS_FRAME_RECORD_H
+#define BITBUS_FRAME_RECORD_H
+
+#include "BitbusTypes.h"
+#include <vector>
+
+using namespace std;
+
+// What the analyzer emits: a Logic frame per field, and/or a FrameV2
+// record per BITBUS frame (the information bytes as one byte array)
+enum BitbusOutputMode
+{
+	BITBUS_OUTPUT_FIELDS = 0,
+	BITBUS_OUTPUT_FIELDS_AND_RECORDS = 1,
+	BITBUS_OUTPUT_RECORDS = 2 // no frame per information byte
+};
+
+// For BitbusFrameRecord::mErrors
+#define BITBUS_RECORD_FCS_ERROR ( 1 << 0 )
+#define BITBUS_RECORD_FRAMING_ERROR ( 1 << 1 )
+#define BITBUS_RECORD_ABORTED ( 1 << 2 )
+
+// One BITBUS frame as a single record (a Logic 2 FrameV2): from its start
+// flag to its end flag or abort, the information bytes as they were sent
+struct BitbusFrameRecord
+{
+	U64 mStartingSample;
+	U64 mEndingSample;
+	bool mHasAddress;
+	U64 mAddress;
+	vector<U8> mPayload;
+	bool mHasFcs;
+	U64 mFcsRead;
+	U64 mFcsCalculated;
+	U32 mErrors; // BITBUS_RECORD_*
+};
+
+// Gathers a record from the fields of a BITBUS frame in order, like
+// BitbusPacketSummary. The payload buffer is reused from frame to frame.
+class BitbusFrameRecordBuilder
+{
+public:
+	BitbusFrameRecordBuilder() : mOpen ( false )
+	{
+	}
+
+	// True when field closes the record (end flag or abort); GetRecord()
+	// holds it until the next Add()
+	bool Add ( const BitbusFrame & field )
+	{
+		if ( !mOpen )
+		{
+			mRecord.mStartingSample = field.mStartingSampleInclusive;
+			mRecord.mHasAddress = false;
+			mRecord.mAddress = 0;
+			mRecord.mPayload.clear();
+			mRecord.mHasFcs = false;
+			mRecord.mFcsRead = 0;
+			mRecord.mFcsCalculated = 0;
+			mRecord.mErrors = 0;
+			mOpen = true;
+		}
+		mRecord.mEndingSample = field.mEndingSampleInclusive;
+		mRecord.mErrors |= ( field.mFlags & BITBUS_FRAMING_ERROR ) ? BITBUS_RECORD_FRAMING_ERROR : 0;
+
+		switch ( field.mType )
+		{
+		case BITBUS_FIELD_FLAG:
+			if ( field.mData1 == BITBUS_FLAG_START )
+			{
+				// Fill flags before it are not part of the frame
+				mRecord.mStartingSample = field.mStartingSampleInclusive;
+			}
+			mOpen = ( field.mData1 != BITBUS_FLAG_END );
+			break;
+		case BITBUS_FIELD_ADDRESS:
+			// An escaped field holds the byte as it was on the wire (a one
+			// byte address, as with BITBUS_ADDRESS_ADDR_RESERVED, may be)
+			mRecord.mHasAddress = true;
+			mRecord.mAddress = ( field.mFlags & BITBUS_ESCAPED_BYTE ) ? BitbusDecoderSettings::Bit5Inv ( U8 ( field.mData1 ) )
+			                                                         : field.mData1;
+			break;
+		case BITBUS_FIELD_INFORMATION:
+			mRecord.mPayload.push_back ( ( field.mFlags & BITBUS_ESCAPED_BYTE ) ? BitbusDecoderSettings::Bit5Inv ( U8 ( field.mData1 ) )
+			                                                                   : U8 ( field.mData1 ) );
+			break;
+		case BITBUS_FIELD_FCS:
+			mRecord.mHasFcs = true;
+			mRecord.mFcsRead = field.mData1;
+			mRecord.mFcsCalculated = field.mData2;
+			mRecord.mErrors |= ( field.mFlags & BITBUS_DISPLAY_AS_ERROR ) ? BITBUS_RECORD_FCS_ERROR : 0;
+			break;
+		case BITBUS_ABORT_SEQ:
+			mRecord.mErrors |= BITBUS_RECORD_ABORTED;
+			mOpen = false;
+			break;
+		}
+		return !mOpen;
+	}
+
+	// Drops an open record (a packet of fill flags only)
+	void Clear()
+	{
+		mOpen = false;
+	}
+
+	const BitbusFrameRecord & GetRecord() const
+	{
+		return mRecord;
+	}
+
+protected:
+	BitbusFrameRecord mRecord;
+	bool mOpen;
+};
+
+// The columns of a field's own FrameV2, as its tabular text has them; Out
+// takes them like the SDK's FrameV2. Returns the FrameV2 type.
+template <class Out>
+const char* BitbusAddFieldColumns ( Out & out, const BitbusFrame & field )
+{
+	const char* type = "abort";
+	bool escaped = ( field.mFlags & BITBUS_ESCAPED_BYTE ) != 0;
+	S64 value = S64 ( escaped ? BitbusDecoderSettings::Bit5Inv ( U8 ( field.mData1 ) ) : field.mData1 );
+
+	switch ( field.mType )
+	{
+	case BITBUS_FIELD_FLAG:
+		type = "flag";
+		out.AddString ( "flag", ( field.mData1 == BITBUS_FLAG_START ) ? "start" : ( field.mData1 == BITBUS_FLAG_END ) ? "end" : "fill" );
+		if ( ( field.mData1 == BITBUS_FLAG_END ) && ( field.mData2 != 0 ) )
+		{
+			out.AddInteger ( "bit_rate", S64 ( field.mData2 ) );
+		}
+		break;
+	case BITBUS_FIELD_ADDRESS:
+	case BITBUS_FIELD_SOH:
+	case BITBUS_FIELD_RESERVED:
+		type = ( field.mType == BITBUS_FIELD_ADDRESS ) ? "address" : ( field.mType == BITBUS_FIELD_SOH ) ? "soh" : "reserved";
+		out.AddInteger ( "value", value );
+		out.AddBoolean ( "escaped", escaped );
+		break;
+	case BITBUS_FIELD_INFORMATION:
+		type = "information";
+		out.AddInteger ( "index", S64 ( field.mData2 ) );
+		out.AddInteger ( "value", value );
+		out.AddBoolean ( "escaped", escaped );
+		break;
+	case BITBUS_FIELD_FCS:
+		type = "fcs";
+		out.AddInteger ( "fcs", S64 ( field.mData1 ) );
+		out.AddInteger ( "fcs_calculated", S64 ( field.mData2 ) );
+		out.AddBoolean ( "fcs_error", ( field.mFlags & BITBUS_DISPLAY_AS_ERROR ) != 0 );
+		break;
+	}
+	out.AddBoolean ( "framing_error", ( field.mFlags & BITBUS_FRAMING_ERROR ) != 0 );
+	return type;
+}
+
+// The FrameV2 output of an output mode: a record per field in the Fields
+// mode, else one per BITBUS frame. Out takes them with
+//   void AddFieldRecord ( const BitbusFrame & field );
+//   void AddFrameRecord ( const BitbusFrameRecord & record );
+class BitbusRecordOutput
+{
+public:
+	BitbusRecordOutput() : mMode ( BITBUS_OUTPUT_FIELDS )
+	{
+	}
+
+	// Before a run: the output mode is only known once the settings are loaded
+	void Start ( BitbusOutputMode mode )
+	{
+		mMode = mode;
+		mBuilder.Clear();
+	}
+
+	template <class Out>
+	void Add ( Out & out, const BitbusFrame & field )
+	{
+		if ( mMode == BITBUS_OUTPUT_FIELDS )
+		{
+			out.AddFieldRecord ( field );
+		}
+		else if ( mBuilder.Add ( field ) )
+		{
+			out.AddFrameRecord ( mBuilder.GetRecord() );
+		}
+	}
+
+	void Clear()
+	{
+		mBuilder.Clear();
+	}
+
+protected:
+	BitbusOutputMode mMode;
+	BitbusFrameRecordBuilder mBuilder;
+};
+
+#endif //BITBUS_FRAME_RECORD_H
@@ -0,0 +1,176 @@
+#include "BitbusLineEncoder.h"
+#include "BitbusCrc.h"
+
+BitbusLineEncoder::BitbusLineEncoder ( const BitbusDecoderSettings & settings, U64 samplesPerBit ) :
+	mSettings ( settings ), mSamplesPerBit ( samplesPerBit ),
+	mInitialState ( BIT_HIGH ), mLevel ( BIT_HIGH ), mSample ( 0 ), mConsecutiveOnes ( 0 )
+{
+	// NRZI has no idle level, start low like the simulator does
+	if ( mSettings.mTransmissionMode == BITBUS_TRANSMISSION_BIT_SYNC )
+	{
+		mInitialState = BIT_LOW;
+		mLevel = BIT_LOW;
+	}
+}
+
+bool BitbusLineEncoder::IsBitSync() const
+{
+	return mSettings.mTransmissionMode != BITBUS_TRANSMISSION_BYTE_ASYNC;
+}
+
+void BitbusLineEncoder::Cell ( BitState level )
+{
+	if ( level != mLevel )
+	{
+		mEdges.push_back ( mSample );
+		mLevel = level;
+	}
+	mSample += mSamplesPerBit;
+}
+
+void BitbusLineEncoder::SyncBit ( U8 bit )
+{
+	if ( mSettings.mTransmissionMode == BITBUS_TRANSMISSION_BIT_SYNC_NRZ )
+	{
+		Cell ( bit ? BIT_HIGH : BIT_LOW );
+	}
+	else // NRZI: a 0 toggles the line
+	{
+		Cell ( bit ? mLevel : ( ( mLevel == BIT_LOW ) ? BIT_HIGH : BIT_LOW ) );
+	}
+}
+
+void BitbusLineEncoder::SyncByte ( U8 value, bool stuffed )
+{
+	for ( U32 i=0; i < 8; ++i ) // LSB first
+	{
+		U8 bit = ( value >> i ) & 1;
+		SyncBit ( bit );
+		mConsecutiveOnes = bit ? mConsecutiveOnes + 1 : 0;
+
+		if ( stuffed && mConsecutiveOnes == 5 ) // five 1s in a row: insert a 0
+		{
+			SyncBit ( 0 );
+			mConsecutiveOnes = 0;
+		}
+	}
+	if ( !stuffed )
+	{
+		mConsecutiveOnes = 0;
+	}
+}
+
+void BitbusLineEncoder::AsyncByte ( U8 value )
+{
+	Cell ( BIT_LOW ); // start bit
+	for ( U32 i=0; i < 8; ++i )
+	{
+		Cell ( ( ( value >> i ) & 1 ) ? BIT_HIGH : BIT_LOW );
+	}
+	Cell ( BIT_HIGH ); // stop bit
+}
+
+void BitbusLineEncoder::FrameByte ( U8 value )
+{
+	if ( IsBitSync() )
+	{
+		SyncByte ( value, true );
+	}
+	else if ( ( value == BITBUS_FLAG_VALUE ) || ( value == BITBUS_ESCAPE_SEQ_VALUE ) )
+	{
+		AsyncByte ( BITBUS_ESCAPE_SEQ_VALUE );
+		AsyncByte ( BitbusDecoderSettings::Bit5Inv ( value ) );
+	}
+	else
+	{
+		AsyncByte ( value );
+	}
+}
+
+void BitbusLineEncoder::AddIdle ( U32 bits )
+{
+	for ( U32 i=0; i < bits; ++i )
+	{
+		if ( IsBitSync() )
+		{
+			SyncBit ( 1 );
+		}
+		else
+		{
+			Cell ( BIT_HIGH );
+		}
+	}
+	mConsecutiveOnes = 0;
+}
+
+void BitbusLineEncoder::AddFlags ( U32 count )
+{
+	for ( U32 i=0; i < count; ++i )
+	{
+		if ( IsBitSync() )
+		{
+			SyncByte ( BITBUS_FLAG_VALUE, false );
+		}
+		else
+		{
+			AsyncByte ( BITBUS_FLAG_VALUE );
+		}
+	}
+}
+
+void BitbusLineEncoder::AddFrame ( const U8* bytes, U32 count, bool corruptFcs )
+{
+	mFrameBytes.assign ( bytes, bytes + count );
+
+	U32 fcs = ( mSettings.mFcsType == BITBUS_FCS_CRC32 ) ? BitbusCrc32::Compute ( bytes, count )
+	          : BitbusCrc16::Compute ( bytes, count );
+	if ( corruptFcs )
+	{
+		fcs = ~fcs;
+	}
+	for ( U32 i=0; i < BitbusDecoderSettings::FcsBytes ( mSettings.mFcsType ); ++i )
+	{
+		mFrameBytes.push_back ( U8 ( fcs >> ( 8 * i ) ) );
+	}
+
+	AddFlags ( 1 );
+	for ( U32 i=0; i < mFrameBytes.size(); ++i )
+	{
+		FrameByte ( mFrameBytes[ i ] );
+	}
+	AddFlags ( 1 );
+}
+
+void BitbusLineEncoder::AddAbortedFrame ( const U8* bytes, U32 count )
+{
+	AddFlags ( 1 );
+	for ( U32 i=0; i < count; ++i )
+	{
+		FrameByte ( bytes[ i ] );
+	}
+
+	if ( IsBitSync() ) // eight 1s, not stuffed
+	{
+		SyncByte ( 0xFF, false );
+	}
+	else
+	{
+		AsyncByte ( BITBUS_ESCAPE_SEQ_VALUE );
+		AsyncByte ( BITBUS_FLAG_VALUE );
+	}
+}
+
+BitState BitbusLineEncoder::GetInitialState() const
+{
+	return mInitialState;
+}
+
+const vector<U64> & BitbusLineEncoder::GetEdges() const
+{
+	return mEdges;
+}
+
+U64 BitbusLineEncoder::GetEndSample() const
+{
+	return mSample;
+}
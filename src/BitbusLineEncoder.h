@@ -0,0 +1,48 @@
+#ifndef BITBUS_LINE_ENCODER_H
+#define BITBUS_LINE_ENCODER_H
+
+#include "BitbusTypes.h"
+#include <vector>
+
+using namespace std;
+
+// Builds the edge list of a BITBUS line from frames, for BitbusEdgeChannel.
+// Bit sync frames are bit-stuffed (NRZI or NRZ), byte async frames are
+// byte-stuffed start/stop characters. The FCS is computed and appended.
+class BitbusLineEncoder
+{
+public:
+	BitbusLineEncoder ( const BitbusDecoderSettings & settings, U64 samplesPerBit );
+
+	// Marking line (1 bits, or stop level in async)
+	void AddIdle ( U32 bits );
+	void AddFlags ( U32 count );
+	// Opening flag, stuffed bytes, FCS (inverted if corruptFcs), closing flag
+	void AddFrame ( const U8* bytes, U32 count, bool corruptFcs = false );
+	// Opening flag, the first count bytes, then an abort sequence
+	void AddAbortedFrame ( const U8* bytes, U32 count );
+
+	BitState GetInitialState() const;
+	const vector<U64> & GetEdges() const;
+	U64 GetEndSample() const;
+
+protected:
+	void Cell ( BitState level );
+	void SyncBit ( U8 bit );
+	void SyncByte ( U8 value, bool stuffed );
+	void AsyncByte ( U8 value );
+	void FrameByte ( U8 value );
+	bool IsBitSync() const;
+
+	const BitbusDecoderSettings & mSettings;
+	U64 mSamplesPerBit;
+
+	BitState mInitialState;
+	BitState mLevel;
+	U64 mSample;
+	U32 mConsecutiveOnes;
+	vector<U64> mEdges;
+	vector<U8> mFrameBytes;
+};
+
+#endif //BITBUS_LINE_ENCODER_H
@@ -0,0 +1,72 @@
+#include "BitbusPacketIndex.h"
+
+BitbusPacketSummary BitbusPacketEntry::GetSummary() const
+{
+	BitbusPacketSummary summary;
+	summary.mHasAddress = ( mFlags & BITBUS_PACKET_HAS_ADDRESS ) != 0;
+	summary.mAddress = mAddress;
+	summary.mInfoBytes = mInfoBytes;
+	summary.mHasFcs = ( mFlags & BITBUS_PACKET_HAS_FCS ) != 0;
+	summary.mFcsError = ( mFlags & BITBUS_PACKET_FCS_ERROR ) != 0;
+	summary.mAborted = ( mFlags & BITBUS_PACKET_ABORTED ) != 0;
+	return summary;
+}
+
+BitbusPacketIndex::BitbusPacketIndex()
+{
+	mOpen.mFrameCount = 0;
+}
+
+void BitbusPacketIndex::AddField ( U64 frameIndex, const BitbusFrame & frame )
+{
+	if ( mOpen.mFrameCount == 0 )
+	{
+		mOpen.mFirstFrame = frameIndex;
+		mOpen.mStartingSample = frame.mStartingSampleInclusive;
+		mOpenSummary = BitbusPacketSummary();
+	}
+	mOpen.mFrameCount++;
+	mOpenSummary.Add ( frame );
+}
+
+void BitbusPacketIndex::AddFoldedField ( const BitbusFrame & frame )
+{
+	mOpenSummary.Add ( frame );
+}
+
+void BitbusPacketIndex::EndPacket()
+{
+	if ( mOpen.mFrameCount == 0 )
+	{
+		return;
+	}
+
+	mOpen.mInfoBytes = U32 ( mOpenSummary.mInfoBytes );
+	mOpen.mAddress = U32 ( mOpenSummary.mAddress );
+	mOpen.mFlags = ( mOpenSummary.mHasAddress ? BITBUS_PACKET_HAS_ADDRESS : 0 ) |
+	               ( mOpenSummary.mHasFcs ? BITBUS_PACKET_HAS_FCS : 0 ) |
+	               ( mOpenSummary.mFcsError ? BITBUS_PACKET_FCS_ERROR : 0 ) |
+	               ( mOpenSummary.mAborted ? BITBUS_PACKET_ABORTED : 0 );
+	{
+		lock_guard<mutex> lock ( mLock );
+		mPackets.push_back ( mOpen );
+	}
+	mOpen.mFrameCount = 0;
+}
+
+U64 BitbusPacketIndex::GetPacketCount() const
+{
+	lock_guard<mutex> lock ( mLock );
+	return mPackets.size();
+}
+
+bool BitbusPacketIndex::GetPacket ( U64 packet, BitbusPacketEntry & entry ) const
+{
+	lock_guard<mutex> lock ( mLock );
+	if ( packet >= mPackets.size() )
+	{
+		return false;
+	}
+	entry = mPackets[ size_t ( packet ) ];
+	return true;
+}
@@ -0,0 +1,161 @@
+#ifndef BITBUS_PACKET_INDEX_H
+#define BITBUS_PACKET_INDEX_H
+
+#include "BitbusCsvExport.h"
+#include "BitbusPacketText.h"
+#include "BitbusParallelExport.h"
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+// For BitbusPacketEntry::mFlags
+#define BITBUS_PACKET_HAS_ADDRESS ( 1 << 0 )
+#define BITBUS_PACKET_HAS_FCS ( 1 << 1 )
+#define BITBUS_PACKET_FCS_ERROR ( 1 << 2 )
+#define BITBUS_PACKET_ABORTED ( 1 << 3 )
+
+// One BITBUS frame (SDK packet) of the index
+struct BitbusPacketEntry
+{
+	U64 mFirstFrame;     // index of its first field
+	U64 mStartingSample; // of its first field
+	U32 mFrameCount;     // fields
+	U32 mInfoBytes;
+	U32 mAddress;        // with BITBUS_PACKET_HAS_ADDRESS
+	U32 mFlags;          // BITBUS_PACKET_*
+
+	BitbusPacketSummary GetSummary() const;
+};
+
+// Where each BITBUS frame's fields are, built as they are decoded, so a
+// packet is found without reading the fields before it, and the export
+// reads whole packets.
+//
+// AddField() and EndPacket() are called by the decoding thread only; the
+// packets it has ended can be read from any thread meanwhile.
+class BitbusPacketIndex
+{
+public:
+	BitbusPacketIndex();
+
+	// The next field of the open packet, with its frame index
+	void AddField ( U64 frameIndex, const BitbusFrame & frame );
+	// A field of the open packet with no frame of its own (an information
+	// byte carried by a frame record only); the packet has a field already
+	void AddFoldedField ( const BitbusFrame & frame );
+	// The open packet, if it has fields, is the next one
+	void EndPacket();
+
+	U64 GetPacketCount() const;
+	// false past the last packet
+	bool GetPacket ( U64 packet, BitbusPacketEntry & entry ) const;
+
+protected:
+	mutable mutex mLock;
+	vector<BitbusPacketEntry> mPackets;
+
+	// The open packet (decoding thread only)
+	BitbusPacketEntry mOpen;
+	BitbusPacketSummary mOpenSummary;
+};
+
+// A stretch of the fields, from the first field of a packet on, read as
+// BitbusWriteCsvExport reads the fields from the start
+template <class Frames>
+class BitbusFrameRange
+{
+public:
+	BitbusFrameRange ( Frames & frames, U64 firstFrame, U64 endFrame )
+		:	mFrames ( frames ), mFirstFrame ( firstFrame ), mEndFrame ( endFrame )
+	{
+	}
+
+	bool HasFrame ( U64 index )
+	{
+		return ( mFirstFrame + index < mEndFrame ) && mFrames.HasFrame ( mFirstFrame + index );
+	}
+
+	BitbusFrame GetFrame ( U64 index )
+	{
+		return mFrames.GetFrame ( mFirstFrame + index );
+	}
+
+	bool UpdateExportProgressAndCheckForCancel ( U64 completed_frames )
+	{
+		return mFrames.UpdateExportProgressAndCheckForCancel ( completed_frames );
+	}
+
+protected:
+	Frames & mFrames;
+	U64 mFirstFrame;
+	U64 mEndFrame;
+};
+
+// The text/csv export of packets [firstPacket, endPacket): only their fields
+// are read, and a packet whose fields frames does not have all of yet (not
+// committed) ends the export. A packet ends on its end flag or abort, so its
+// rows are the ones the whole export has for it, and the chunks formatted
+// on threads (as BitbusWriteCsvExportParallel) are whole packets.
+template <class Frames>
+void BitbusWriteCsvExportPackets ( ostream & fileStream, Frames & frames, const BitbusPacketIndex & index,
+                                   U64 firstPacket, U64 endPacket, const BitbusDecoderSettings & settings,
+                                   DisplayBase display_base, U64 triggerSample, U32 sampleRate,
+                                   BitbusNumberFormatter numberString, BitbusTimeFormatter timeString,
+                                   U32 threads = 1, U32 chunkFrames = BITBUS_EXPORT_CHUNK_FRAMES )
+{
+	BitbusPacketEntry last;
+	while ( ( firstPacket < endPacket ) &&
+	        ( !index.GetPacket ( endPacket - 1, last ) || !frames.HasFrame ( last.mFirstFrame + last.mFrameCount - 1 ) ) )
+	{
+		endPacket--;
+	}
+	BitbusPacketEntry first;
+	if ( ( firstPacket >= endPacket ) || !index.GetPacket ( firstPacket, first ) )
+	{
+		BitbusFrameRange<Frames> none ( frames, 0, 0 );
+		BitbusWriteCsvExport ( fileStream, none, settings, display_base, triggerSample, sampleRate, numberString, timeString );
+		return;
+	}
+
+	if ( threads <= 1 )
+	{
+		BitbusFrameRange<Frames> range ( frames, first.mFirstFrame, last.mFirstFrame + last.mFrameCount );
+		BitbusWriteCsvExport ( fileStream, range, settings, display_base, triggerSample, sampleRate, numberString, timeString );
+		return;
+	}
+
+	BitbusParallelCsvExport exporter ( fileStream, settings, display_base, triggerSample, sampleRate, numberString, timeString, threads );
+	vector<BitbusFrame> chunk;
+	U64 reported = 0;
+	BitbusPacketEntry packet;
+	for ( U64 p=firstPacket; ( p < endPacket ) && index.GetPacket ( p, packet ); ++p )
+	{
+		const U64 endFrame = packet.mFirstFrame + packet.mFrameCount;
+		for ( U64 i=packet.mFirstFrame; i < endFrame; ++i )
+		{
+			chunk.push_back ( frames.GetFrame ( i ) );
+		}
+		if ( chunk.size() >= chunkFrames )
+		{
+			exporter.AddChunk ( chunk, endFrame );
+
+			if ( exporter.GetWrittenFrames() != reported )
+			{
+				reported = exporter.GetWrittenFrames();
+				if ( frames.UpdateExportProgressAndCheckForCancel ( reported ) )
+				{
+					return;
+				}
+			}
+		}
+	}
+	if ( !chunk.empty() )
+	{
+		exporter.AddChunk ( chunk, last.mFirstFrame + last.mFrameCount );
+	}
+	exporter.Finish();
+	frames.UpdateExportProgressAndCheckForCancel ( last.mFirstFrame + last.mFrameCount );
+}
+
+#endif //BITBUS_PACKET_INDEX_H
@@ -0,0 +1,126 @@
+#ifndef BITBUS_PACKET_TEXT_H
+#define BITBUS_PACKET_TEXT_H
+
+#include "BitbusFormat.h"
+#include <string>
+
+using namespace std;
+
+// What the packet table shows of one BITBUS frame (one SDK packet), gathered
+// from its fields in order: start flag to end flag or abort.
+struct BitbusPacketSummary
+{
+	BitbusPacketSummary() :
+		mHasAddress ( false ), mAddress ( 0 ), mInfoBytes ( 0 ), mHasFcs ( false ), mFcsError ( false ), mAborted ( false )
+	{
+	}
+
+	void Add ( const BitbusFrame & frame )
+	{
+		switch ( frame.mType )
+		{
+		case BITBUS_FIELD_ADDRESS:
+			mHasAddress = true;
+			mAddress = frame.mData1;
+			break;
+		case BITBUS_FIELD_INFORMATION:
+			mInfoBytes++;
+			break;
+		case BITBUS_FIELD_FCS:
+			mHasFcs = true;
+			mFcsError = ( frame.mFlags & BITBUS_DISPLAY_AS_ERROR ) != 0;
+			break;
+		case BITBUS_ABORT_SEQ:
+			mAborted = true;
+			break;
+		}
+	}
+
+	bool mHasAddress;
+	U64 mAddress;
+	U64 mInfoBytes;
+	bool mHasFcs;
+	bool mFcsError;
+	bool mAborted;
+};
+
+// One-line packet text: address, information length, FCS status.
+//
+// Out takes the strings like the SDK's AnalyzerResults:
+//   void AddTabularText ( const char* str1, ... );
+template <class Out>
+class BitbusPacketText
+{
+public:
+	BitbusPacketText ( const BitbusDecoderSettings & settings, BitbusNumberFormatter numberString );
+
+	void Generate ( Out & out, const BitbusPacketSummary & packet, DisplayBase display_base );
+	string GetText ( const BitbusPacketSummary & packet, DisplayBase display_base );
+
+protected:
+	void GenText ( BitbusFixedText & text, const BitbusPacketSummary & packet, DisplayBase display_base );
+
+	const BitbusDecoderSettings & mSettings;
+	BitbusNumberFormatter mNumberString;
+};
+
+template <class Out>
+BitbusPacketText<Out>::BitbusPacketText ( const BitbusDecoderSettings & settings, BitbusNumberFormatter numberString )
+	:	mSettings ( settings ),
+	    mNumberString ( numberString )
+{
+}
+
+template <class Out>
+void BitbusPacketText<Out>::Generate ( Out & out, const BitbusPacketSummary & packet, DisplayBase display_base )
+{
+	BitbusFixedText text;
+	GenText ( text, packet, display_base );
+	out.AddTabularText ( text.c_str() );
+}
+
+template <class Out>
+string BitbusPacketText<Out>::GetText ( const BitbusPacketSummary & packet, DisplayBase display_base )
+{
+	BitbusFixedText text;
+	GenText ( text, packet, display_base );
+	return text.c_str();
+}
+
+template <class Out>
+void BitbusPacketText<Out>::GenText ( BitbusFixedText & text, const BitbusPacketSummary & packet, DisplayBase display_base )
+{
+	if ( packet.mHasAddress )
+	{
+		// One address byte with the reserved byte, two otherwise
+		U32 addressBits = ( mSettings.mBitbusAddressingMode == BITBUS_ADDRESS_ADDR_RESERVED ) ? 8 : 16;
+		text.Append ( "Address " );
+		text.AppendNumber ( packet.mAddress, display_base, addressBits, mNumberString );
+		text.Append ( ", " );
+		text.AppendNumber ( packet.mInfoBytes, Decimal, 64, mNumberString );
+		text.Append ( ( packet.mInfoBytes == 1 ) ? " byte, " : " bytes, " );
+	}
+	else if ( !packet.mAborted && !packet.mHasFcs )
+	{
+		// Flags the decoder went through before the line went idle
+		text.Append ( "Fill flags" );
+		return;
+	}
+
+	if ( packet.mAborted )
+	{
+		text.Append ( "ABORTED" );
+	}
+	else if ( packet.mHasFcs )
+	{
+		text.Append ( packet.mFcsError ? "!FCS CRC" : "FCS CRC" );
+		text.AppendNumber ( mSettings.FcsBits(), Decimal, 32, mNumberString );
+		text.Append ( packet.mFcsError ? " ERROR" : " OK" );
+	}
+	else
+	{
+		text.Append ( "no FCS" );
+	}
+}
+
+#endif //BITBUS_PACKET_TEXT_H
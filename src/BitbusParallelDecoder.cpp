@@ -0,0 +1,389 @@
+#include "BitbusParallelDecoder.h"
+#include <algorithm>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Frame boundaries decoded past a segment's end: decoders started apart
+// are normally in step from the first frame after an idle run
+#define PARALLEL_OVERRUN_BOUNDARIES 4
+// Idle run to split in, in bits (HDLC idles with 15 or more 1s)
+#define PARALLEL_SPLIT_IDLE_BITS 16
+// How far to look for one before splitting on a busy line anyway
+#define PARALLEL_SPLIT_SEARCH_BITS 4096
+#define PARALLEL_SEGMENTS_PER_THREAD 4
+// Bits of capture a segment is cut to at most, and segments decoded ahead
+// of the join per thread: what is held in memory at a time
+#define PARALLEL_SEGMENT_BITS ( 1 << 18 )
+#define PARALLEL_SEGMENTS_AHEAD 2
+
+void BitbusParallelDecoder::SegmentSink::AddDecodedFrame ( const BitbusFrame & frame )
+{
+	mSegment.mFrames.push_back ( frame );
+}
+
+void BitbusParallelDecoder::SegmentSink::AddDecodedMarker ( U64 sample, BitbusMarkerType type )
+{
+	BitbusDecodedMarker marker = { sample, type };
+	mSegment.mMarkers.push_back ( marker );
+}
+
+BitbusParallelDecoder::BitbusParallelDecoder ( const BitbusDecoderSettings & settings, U32 sampleRateHz, BitState initialState,
+                                               U64 endSample, BitbusEdgeSourceFactory & sources ) :
+	mSettings ( settings ), mSampleRateHz ( sampleRateHz ), mInitialState ( initialState ), mEndSample ( endSample ),
+	mSources ( sources ), mOverrunBoundaries ( PARALLEL_OVERRUN_BOUNDARIES ), mRedecodes ( 0 )
+{
+}
+
+bool BitbusParallelDecoder::Decode ( BitbusParallelOutput & output, U32 threads, U32 segments )
+{
+	threads = ( threads > 0 ) ? threads : 1;
+	if ( segments == 0 )
+	{
+		U64 bySize = mEndSample / max<U64> ( SamplesForBits ( PARALLEL_SEGMENT_BITS ), 1 ) + 1;
+		segments = ( threads > 1 ) ? U32 ( max<U64> ( threads * PARALLEL_SEGMENTS_PER_THREAD, bySize ) ) : 1;
+	}
+
+	vector<U64> splits = FindSplits ( segments );
+	mSegments.assign ( splits.size(), Segment() );
+	for ( U32 i=0; i < splits.size(); ++i )
+	{
+		mSegments[ i ].mStart = splits[ i ];
+		mSegments[ i ].mStop = ( i + 1 < splits.size() ) ? splits[ i + 1 ] : ~U64 ( 0 );
+	}
+	mStats = BitbusDecodeStats();
+	mStats.mBitRate = mSettings.mBitRate;
+	mRedecodes = 0;
+
+	// Pool: each thread takes the next segment not started yet, while no more
+	// than PARALLEL_SEGMENTS_AHEAD per thread are started past the one joining
+	mutex lock;
+	condition_variable changed;
+	U32 nextSegment = 0;
+	U32 joining = 0;
+	bool stop = false;
+	const U32 ahead = threads * PARALLEL_SEGMENTS_AHEAD;
+	auto work = [ & ]()
+	{
+		unique_lock<mutex> guard ( lock );
+		for ( ; ; )
+		{
+			changed.wait ( guard, [ & ]() { return stop || ( nextSegment >= mSegments.size() ) || ( nextSegment <= joining + ahead ); } );
+			if ( stop || ( nextSegment >= mSegments.size() ) )
+			{
+				return;
+			}
+			Segment & segment = mSegments[ nextSegment++ ];
+			guard.unlock();
+			DecodeSegment ( segment );
+			guard.lock();
+			segment.mDecoded = true;
+			changed.notify_all();
+		}
+	};
+	auto waitFor = [ & ]( U32 i )
+	{
+		unique_lock<mutex> guard ( lock );
+		changed.wait ( guard, [ & ]() { return mSegments[ i ].mDecoded; } );
+	};
+	vector<thread> pool;
+	for ( U32 i=0; i < min ( threads, U32 ( mSegments.size() ) ); ++i )
+	{
+		pool.push_back ( thread ( work ) );
+	}
+
+	// Join the segments in order
+	waitFor ( 0 );
+	// The output of the current segment is taken from its boundary `from`
+	U32 current = 0;
+	U64 fromBoundary = 0;
+	Boundary from = Boundary();
+	for ( U32 next=1; next < mSegments.size(); ++next )
+	{
+		Segment & before = mSegments[ current ];
+		if ( before.mReachedEnd ) // it has decoded the rest of the capture
+		{
+			break;
+		}
+		waitFor ( next );
+
+		U64 beforeBoundary;
+		U64 afterBoundary;
+		if ( FindJoin ( before, fromBoundary, mSegments[ next ], beforeBoundary, afterBoundary ) )
+		{
+			Boundary to = before.mBoundaries[ beforeBoundary ];
+			Append ( output, before, from, &to );
+			fromBoundary = afterBoundary;
+			from = mSegments[ next ].mBoundaries[ afterBoundary ];
+		}
+		else
+		{
+			// before is right up to its last boundary: decode on from there
+			// until in step with the next segment, no further than its end
+			Boundary last = before.mBoundaries.back();
+			Append ( output, before, from, &last );
+			Segment & after = mSegments[ next ];
+			Segment again = Segment();
+			again.mStart = last.mKey.mSample;
+			again.mStop = after.mStop;
+			DecodeSegment ( again, &last.mKey, &after );
+			again.mDecoded = true;
+			mRedecodes++;
+
+			if ( FindJoin ( again, 0, after, beforeBoundary, afterBoundary ) )
+			{
+				Boundary to = again.mBoundaries[ beforeBoundary ];
+				Append ( output, again, Boundary(), &to );
+				fromBoundary = afterBoundary;
+				from = after.mBoundaries[ afterBoundary ];
+				before.mWork.AddWork ( again.mWork );
+			}
+			else
+			{
+				again.mWork.AddWork ( after.mWork );
+				after = std::move ( again );
+				fromBoundary = 0;
+				from = Boundary();
+			}
+		}
+		current = next;
+		{
+			lock_guard<mutex> guard ( lock );
+			joining = current;
+		}
+		changed.notify_all();
+	}
+	Append ( output, mSegments[ current ], from, 0 );
+
+	{
+		lock_guard<mutex> guard ( lock );
+		stop = true;
+	}
+	changed.notify_all();
+	for ( U32 i=0; i < pool.size(); ++i )
+	{
+		pool[ i ].join();
+	}
+
+	bool ok = true;
+	for ( U32 i=0; i < mSegments.size(); ++i )
+	{
+		ok = ok && !mSegments[ i ].mFailed;
+	}
+	return ok;
+}
+
+// Segment starts: 0, then one in the first idle run after each equal
+// share of the capture, or between two edges PARALLEL_SPLIT_SEARCH_BITS on
+// if there is none by then (the join decodes again if it must).
+vector<U64> BitbusParallelDecoder::FindSplits ( U32 segments )
+{
+	vector<U64> splits;
+	splits.push_back ( 0 );
+
+	unique_ptr<BitbusEdgeSource> source ( ( segments > 1 ) ? mSources.CreateSource() : 0 );
+	if ( source.get() == 0 )
+	{
+		return splits;
+	}
+
+	U64 idleSamples = SamplesForBits ( PARALLEL_SPLIT_IDLE_BITS );
+	U64 searchSamples = SamplesForBits ( PARALLEL_SPLIT_SEARCH_BITS );
+	// NRZI idles without edges at either level, NRZ and async idle high
+	bool anyLevel = ( mSettings.mTransmissionMode == BITBUS_TRANSMISSION_BIT_SYNC );
+
+	for ( U32 i=1; i < segments; ++i )
+	{
+		U64 target = mEndSample / segments * i;
+		if ( target <= splits.back() )
+		{
+			continue;
+		}
+
+		BitState level;
+		if ( !source->Seek ( target, level ) )
+		{
+			break;
+		}
+		U64 from = target;
+		U64 edge;
+		bool found = false;
+		while ( source->NextEdge ( edge ) )
+		{
+			bool idle = ( edge - from > idleSamples ) && ( anyLevel || ( level == BIT_HIGH ) );
+			if ( idle || ( edge - target > searchSamples ) )
+			{
+				found = true;
+				break;
+			}
+			from = edge;
+			level = BitbusEdgeChannel::Inverted ( level );
+		}
+		if ( !found )
+		{
+			break;
+		}
+		splits.push_back ( from + ( edge - from ) / 2 );
+	}
+	return splits;
+}
+
+void BitbusParallelDecoder::DecodeSegment ( Segment & segment, const BitbusResumeKey* resume, const Segment* inStepWith )
+{
+	segment.mReachedEnd = false;
+	segment.mFailed = false;
+
+	unique_ptr<BitbusEdgeSource> source ( mSources.CreateSource() );
+	if ( source.get() == 0 )
+	{
+		segment.mFailed = true;
+		segment.mReachedEnd = true;
+		return;
+	}
+
+	BitbusStreamChannel channel ( mInitialState, *source );
+	if ( ( segment.mStart > 0 ) && !channel.Seek ( segment.mStart ) )
+	{
+		segment.mFailed = true;
+		segment.mReachedEnd = true;
+		return;
+	}
+
+	BitbusCountingChannel< BitbusStreamChannel > countingChannel;
+	countingChannel.Setup ( &channel );
+	SegmentSink sink ( segment );
+	BitbusDecoder< BitbusCountingChannel< BitbusStreamChannel >, SegmentSink > decoder ( mSettings, sink );
+	decoder.Setup ( &countingChannel, mSampleRateHz );
+
+	U32 overrun = 0;
+	U64 inStepFrom = 0;
+	U64 inStepAt;
+	try
+	{
+		if ( resume != 0 )
+		{
+			decoder.Resume ( *resume );
+		}
+		else
+		{
+			decoder.Start();
+		}
+		for ( ; ; )
+		{
+			Boundary boundary = { decoder.GetResumeKey(), segment.mFrames.size(), segment.mMarkers.size() };
+			segment.mBoundaries.push_back ( boundary );
+			if ( ( boundary.mKey.mSample >= segment.mStop ) && ( ++overrun >= mOverrunBoundaries ) )
+			{
+				break;
+			}
+			if ( ( inStepWith != 0 ) && ( boundary.mKey.mSample >= inStepWith->mStart ) &&
+			     FindBoundary ( *inStepWith, boundary.mKey, inStepFrom, inStepAt ) )
+			{
+				break;
+			}
+			decoder.ProcessBITBUSFrame();
+		}
+	}
+	catch ( BitbusEndOfData & )
+	{
+		// As with one decoder, the frames of a BITBUS frame cut off by the end stay
+		segment.mReachedEnd = true;
+	}
+
+	BitbusDecodeStats work = decoder.GetStats();
+	work.mEdges = countingChannel.GetEdgeCount();
+	work.mChannelCalls = countingChannel.GetCallCount();
+	segment.mWork.AddWork ( work );
+}
+
+// The boundary of segment with key, from boundary next on; next is moved up
+// to key's sample, for keys looked for in sample order
+bool BitbusParallelDecoder::FindBoundary ( const Segment & segment, const BitbusResumeKey & key, U64 & next, U64 & boundary ) const
+{
+	while ( ( next < segment.mBoundaries.size() ) && ( segment.mBoundaries[ next ].mKey.mSample < key.mSample ) )
+	{
+		next++;
+	}
+	for ( U64 k=next; ( k < segment.mBoundaries.size() ) && ( segment.mBoundaries[ k ].mKey.mSample == key.mSample ); ++k )
+	{
+		if ( segment.mBoundaries[ k ].mKey == key )
+		{
+			boundary = k;
+			return true;
+		}
+	}
+	return false;
+}
+
+// First boundary of before from firstBoundary on, past the start of after,
+// where after's decoder was in the same state. Boundaries are in sample
+// order in both.
+bool BitbusParallelDecoder::FindJoin ( const Segment & before, U64 firstBoundary, const Segment & after,
+                                       U64 & beforeBoundary, U64 & afterBoundary ) const
+{
+	U64 next = 0;
+	for ( U64 i=firstBoundary; i < before.mBoundaries.size(); ++i )
+	{
+		if ( ( before.mBoundaries[ i ].mKey.mSample >= after.mStart ) && FindBoundary ( after, before.mBoundaries[ i ].mKey, next, afterBoundary ) )
+		{
+			beforeBoundary = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Output of segment from one boundary to another (0: to its end), then its memory is let go
+void BitbusParallelDecoder::Append ( BitbusParallelOutput & output, Segment & segment, const Boundary & from, const Boundary * to )
+{
+	U64 frames = ( to != 0 ) ? to->mFrames : segment.mFrames.size();
+	U64 markers = ( to != 0 ) ? to->mMarkers : segment.mMarkers.size();
+	for ( U64 i=from.mFrames; i < frames; ++i )
+	{
+		mStats.AddField ( segment.mFrames[ i ] );
+	}
+	for ( U64 i=from.mMarkers; i < markers; ++i )
+	{
+		mStats.AddMarker ( segment.mMarkers[ i ].mType );
+	}
+	if ( ( frames > from.mFrames ) || ( markers > from.mMarkers ) )
+	{
+		output.AddDecoded ( segment.mFrames.data() + from.mFrames, frames - from.mFrames,
+		                    segment.mMarkers.data() + from.mMarkers, markers - from.mMarkers );
+	}
+
+	vector<BitbusFrame>().swap ( segment.mFrames );
+	vector<BitbusDecodedMarker>().swap ( segment.mMarkers );
+	vector<Boundary>().swap ( segment.mBoundaries );
+}
+
+// Samples in bits at the bit rate set, at least 1 a bit, from the bit period
+// in fixed point as the decoder has it (not whole samples a bit)
+U64 BitbusParallelDecoder::SamplesForBits ( U64 bits ) const
+{
+	U32 bitRate = mSettings.mBitRate;
+	U64 period = ( bitRate > 0 ) ? ( ( U64 ( mSampleRateHz ) << BITBUS_PERIOD_FRACTION_BITS ) + bitRate / 2 ) / bitRate : 0;
+	period = max<U64> ( period, U64 ( 1 ) << BITBUS_PERIOD_FRACTION_BITS );
+	return ( period * bits ) >> BITBUS_PERIOD_FRACTION_BITS;
+}
+
+U32 BitbusParallelDecoder::GetSegmentCount() const
+{
+	return U32 ( mSegments.size() );
+}
+
+U32 BitbusParallelDecoder::GetRedecodeCount() const
+{
+	return mRedecodes;
+}
+
+BitbusDecodeStats BitbusParallelDecoder::GetStats() const
+{
+	BitbusDecodeStats stats = mStats;
+	for ( U32 i=0; i < mSegments.size(); ++i )
+	{
+		stats.AddWork ( mSegments[ i ].mWork );
+	}
+	return stats;
+}
@@ -0,0 +1,128 @@
+#ifndef BITBUS_PARALLEL_DECODER_H
+#define BITBUS_PARALLEL_DECODER_H
+
+#include "BitbusDecoder.h"
+#include "BitbusEdgeChannel.h"
+#include <vector>
+
+using namespace std;
+
+// Gives each decoding thread its own reader of the same capture
+class BitbusEdgeSourceFactory
+{
+public:
+	virtual ~BitbusEdgeSourceFactory() {}
+
+	// A new seekable source at the start of the capture, 0 on failure
+	virtual BitbusEdgeSource* CreateSource() = 0;
+};
+
+struct BitbusDecodedMarker
+{
+	U64 mSample;
+	BitbusMarkerType mType;
+};
+
+// Takes the output of BitbusParallelDecoder as each segment is joined to
+// the ones before it: the frames and markers from the last join to this
+// one, in capture order, on the thread running Decode()
+class BitbusParallelOutput
+{
+public:
+	virtual ~BitbusParallelOutput() {}
+
+	virtual void AddDecoded ( const BitbusFrame* frames, U64 frameCount, const BitbusDecodedMarker* markers, U64 markerCount ) = 0;
+};
+
+// Decodes a seekable capture on several threads, with the same frames and
+// markers, in the same order, as one BitbusDecoder from sample 0:
+//  1. the capture is split in idle runs too long for any frame (the bit
+//     sync decoder aborts there and restarts on the next edge), or on a
+//     line busy for long between two edges;
+//  2. the segments are decoded on a pool of threads, each one running on
+//     a little past its end, no more than PARALLEL_SEGMENTS_AHEAD per
+//     thread ahead of the join;
+//  3. neighbouring segments are joined, in order as they are decoded, at
+//     the first frame boundary where their decoders are in the same state
+//     (BitbusResumeKey). If there is none, the first one's decoder is
+//     resumed from its last boundary and runs on until it is in step with
+//     the second one, or to the second one's end, which it then stands in
+//     for. The output up to each join goes out and its segment is let go,
+//     so the memory held goes with the threads, not the capture.
+class BitbusParallelDecoder
+{
+public:
+	BitbusParallelDecoder ( const BitbusDecoderSettings & settings, U32 sampleRateHz, BitState initialState,
+	                        U64 endSample, BitbusEdgeSourceFactory & sources );
+	virtual ~BitbusParallelDecoder() {}
+
+	// segments 0 picks a few per thread, more for a long capture. False if a
+	// source could not be created.
+	bool Decode ( BitbusParallelOutput & output, U32 threads, U32 segments = 0 );
+
+	U32 GetSegmentCount() const;
+	// Joins that needed a decode again
+	U32 GetRedecodeCount() const;
+	// Counters of the frames and markers output, and the work of every
+	// segment decoded (overruns and decodes again included)
+	BitbusDecodeStats GetStats() const;
+
+protected:
+	struct Boundary
+	{
+		BitbusResumeKey mKey;
+		U64 mFrames;
+		U64 mMarkers;
+	};
+
+	struct Segment
+	{
+		U64 mStart;
+		U64 mStop; // decoded on to the first few boundaries past this
+		bool mReachedEnd;
+		bool mFailed;
+		bool mDecoded; // for the join to wait on
+		vector<BitbusFrame> mFrames;
+		vector<BitbusDecodedMarker> mMarkers;
+		vector<Boundary> mBoundaries;
+		BitbusDecodeStats mWork;
+	};
+
+	// Collects one segment's output
+	class SegmentSink
+	{
+	public:
+		explicit SegmentSink ( Segment & segment ) : mSegment ( segment ) {}
+
+		void AddDecodedFrame ( const BitbusFrame & frame );
+		void AddDecodedMarker ( U64 sample, BitbusMarkerType type );
+		void BeforeChannelRead() {}
+
+	protected:
+		Segment & mSegment;
+	};
+
+	// Segment starts, 0 first (virtual for the tests, to split anywhere)
+	virtual vector<U64> FindSplits ( U32 segments );
+	// From segment.mStart, or resumed from *resume there; stops early at a
+	// boundary in step with inStepWith
+	void DecodeSegment ( Segment & segment, const BitbusResumeKey* resume = 0, const Segment* inStepWith = 0 );
+	bool FindBoundary ( const Segment & segment, const BitbusResumeKey & key, U64 & next, U64 & boundary ) const;
+	bool FindJoin ( const Segment & before, U64 firstBoundary, const Segment & after, U64 & beforeBoundary, U64 & afterBoundary ) const;
+	void Append ( BitbusParallelOutput & output, Segment & segment, const Boundary & from, const Boundary * to );
+	U64 SamplesForBits ( U64 bits ) const;
+
+	const BitbusDecoderSettings & mSettings;
+	U32 mSampleRateHz;
+	BitState mInitialState;
+	U64 mEndSample;
+	BitbusEdgeSourceFactory & mSources;
+	// Boundaries decoded past a segment's stop, to join the next one in
+	U32 mOverrunBoundaries;
+
+	vector<Segment> mSegments;
+	BitbusDecodeStats mStats; // of the output
+	U32 mRedecodes;
+};
+
+#endif //BITBUS_PARALLEL_DECODER_H
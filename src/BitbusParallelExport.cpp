@@ -0,0 +1,151 @@
+#include "BitbusParallelExport.h"
+
+// Text of a chunk to start with, grown as needed
+#define PARALLEL_EXPORT_CHUNK_TEXT_BYTES ( 64 * 1024 )
+
+BitbusParallelCsvExport::BitbusParallelCsvExport ( ostream & out, const BitbusDecoderSettings & settings, DisplayBase display_base,
+                                                   U64 triggerSample, U32 sampleRate, BitbusNumberFormatter numberString,
+                                                   BitbusTimeFormatter timeString, U32 threads, U32 chunkFrames ) :
+	mOut ( out ), mSettings ( settings ), mDisplayBase ( display_base ), mTriggerSample ( triggerSample ),
+	mSampleRate ( sampleRate ), mNumberString ( numberString ), mTimeString ( timeString ),
+	mMaxInFlight ( size_t ( ( threads > 0 ) ? threads : 1 ) * BITBUS_EXPORT_CHUNKS_PER_THREAD ),
+	mChunkFrames ( chunkFrames ), mAddedFrames ( 0 ), mStop ( false ), mWrittenFrames ( 0 )
+{
+	mOut.write ( BITBUS_CSV_HEADER, sizeof ( BITBUS_CSV_HEADER ) - 1 );
+	for ( U32 i=0; i < threads; ++i )
+	{
+		mThreads.push_back ( thread ( &BitbusParallelCsvExport::Work, this ) );
+	}
+}
+
+BitbusParallelCsvExport::~BitbusParallelCsvExport()
+{
+	{
+		lock_guard<mutex> lock ( mLock );
+		mStop = true;
+	}
+	mWorkReady.notify_all();
+	for ( U32 i=0; i < mThreads.size(); ++i )
+	{
+		mThreads[ i ].join();
+	}
+}
+
+void BitbusParallelCsvExport::AddChunk ( vector<BitbusFrame> & frames, U64 endFrame )
+{
+	unique_ptr<Chunk> chunk ( new Chunk() );
+	chunk->mFrames.swap ( frames );
+	chunk->mEndFrame = endFrame;
+	chunk->mDone = false;
+	if ( !mSpareText.empty() )
+	{
+		chunk->mText.swap ( mSpareText.back() );
+		mSpareText.pop_back();
+	}
+	{
+		lock_guard<mutex> lock ( mLock );
+		mToFormat.push_back ( chunk.get() );
+		mInFlight.push_back ( std::move ( chunk ) );
+	}
+	mWorkReady.notify_one();
+
+	WriteChunks ( mMaxInFlight - 1 );
+
+	if ( !mSpareFrames.empty() )
+	{
+		frames.swap ( mSpareFrames.back() );
+		mSpareFrames.pop_back();
+	}
+}
+
+void BitbusParallelCsvExport::AddFrame ( const BitbusFrame & frame )
+{
+	bool rowBreak = ( frame.mType == BITBUS_FIELD_FLAG ) || ( frame.mType == BITBUS_ABORT_SEQ );
+	if ( rowBreak && ( mChunk.size() >= mChunkFrames ) )
+	{
+		// The flag or abort ends this chunk and starts the next one
+		mChunk.push_back ( frame );
+		AddChunk ( mChunk, mAddedFrames );
+	}
+	mChunk.push_back ( frame );
+	mAddedFrames++;
+}
+
+void BitbusParallelCsvExport::Finish()
+{
+	if ( !mChunk.empty() )
+	{
+		AddChunk ( mChunk, mAddedFrames );
+	}
+	WriteChunks ( 0 );
+}
+
+U64 BitbusParallelCsvExport::GetWrittenFrames() const
+{
+	return mWrittenFrames;
+}
+
+void BitbusParallelCsvExport::Work()
+{
+	for ( ; ; )
+	{
+		Chunk* chunk;
+		{
+			unique_lock<mutex> lock ( mLock );
+			mWorkReady.wait ( lock, [ this ]() { return mStop || !mToFormat.empty(); } );
+			if ( mStop )
+			{
+				return;
+			}
+			chunk = mToFormat.front();
+			mToFormat.pop_front();
+		}
+
+		Format ( *chunk );
+
+		{
+			lock_guard<mutex> lock ( mLock );
+			chunk->mDone = true;
+		}
+		mChunkDone.notify_all();
+	}
+}
+
+void BitbusParallelCsvExport::Format ( Chunk & chunk )
+{
+	BitbusCsvWriter out ( mNumberString, PARALLEL_EXPORT_CHUNK_TEXT_BYTES, chunk.mText );
+	ChunkFrames frames ( chunk.mFrames );
+	BitbusWriteCsvRows ( out, frames, mSettings, mDisplayBase, mTriggerSample, mSampleRate, mTimeString );
+	out.TakeText ( chunk.mText );
+}
+
+void BitbusParallelCsvExport::WriteChunks ( size_t keep )
+{
+	for ( ; ; )
+	{
+		unique_ptr<Chunk> chunk;
+		{
+			unique_lock<mutex> lock ( mLock );
+			if ( mInFlight.size() <= keep )
+			{
+				return;
+			}
+			Chunk* front = mInFlight.front().get();
+			mChunkDone.wait ( lock, [ front ]() { return front->mDone; } );
+			chunk = std::move ( mInFlight.front() );
+			mInFlight.pop_front();
+		}
+
+		if ( !chunk->mText.empty() )
+		{
+			mOut.write ( &chunk->mText[ 0 ], chunk->mText.size() );
+		}
+		mWrittenFrames = chunk->mEndFrame;
+
+		chunk->mFrames.clear();
+		mSpareFrames.push_back ( vector<BitbusFrame>() );
+		mSpareFrames.back().swap ( chunk->mFrames );
+		mSpareText.push_back ( vector<char>() );
+		mSpareText.back().swap ( chunk->mText );
+	}
+}
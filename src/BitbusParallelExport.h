@@ -0,0 +1,141 @@
+#ifndef BITBUS_PARALLEL_EXPORT_H
+#define BITBUS_PARALLEL_EXPORT_H
+
+#include "BitbusCsvExport.h"
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Fields per chunk of the parallel export (a chunk runs on to the next
+// flag or abort), and chunks in flight per thread: read, formatting or
+// formatted and waiting for the ones before them to be written
+#ifndef BITBUS_EXPORT_CHUNK_FRAMES
+#define BITBUS_EXPORT_CHUNK_FRAMES 16384
+#endif
+#ifndef BITBUS_EXPORT_CHUNKS_PER_THREAD
+#define BITBUS_EXPORT_CHUNKS_PER_THREAD 2
+#endif
+
+// Formats chunks of the text/csv export on a pool of threads and writes
+// their text in order. The chunks are given in order, each from a flag or
+// an abort field (or the first field) to the next one, that flag or abort
+// included: the rows of a chunk are the export's rows from its first field
+// (BitbusWriteCsvRows). Or the fields are given one by one and chunked
+// here, at chunkFrames.
+class BitbusParallelCsvExport
+{
+public:
+	// Writes the header
+	BitbusParallelCsvExport ( ostream & out, const BitbusDecoderSettings & settings, DisplayBase display_base,
+	                          U64 triggerSample, U32 sampleRate, BitbusNumberFormatter numberString,
+	                          BitbusTimeFormatter timeString, U32 threads, U32 chunkFrames = BITBUS_EXPORT_CHUNK_FRAMES );
+	// Chunks not written yet are dropped (a cancelled export)
+	~BitbusParallelCsvExport();
+
+	// Takes the fields of the next chunk (frames is left empty, with room
+	// from a chunk already written); endFrame is the index of the field after
+	// it. Waits while too many chunks are in flight, writing the finished ones.
+	void AddChunk ( vector<BitbusFrame> & frames, U64 endFrame );
+	// The next field, for fields not chunked by the caller: a chunk is cut
+	// at the first flag or abort once it holds chunkFrames of them
+	void AddFrame ( const BitbusFrame & frame );
+	// Writes the remaining chunks, the fields added since the last one first
+	void Finish();
+	// endFrame of the last chunk written
+	U64 GetWrittenFrames() const;
+
+protected:
+	struct Chunk
+	{
+		vector<BitbusFrame> mFrames;
+		vector<char> mText;
+		U64 mEndFrame;
+		bool mDone;
+	};
+
+	// A chunk's fields as BitbusWriteCsvRows reads them
+	class ChunkFrames
+	{
+	public:
+		explicit ChunkFrames ( const vector<BitbusFrame> & frames ) : mFrames ( frames ) {}
+
+		bool HasFrame ( U64 index ) { return index < mFrames.size(); }
+		BitbusFrame GetFrame ( U64 index ) { return mFrames[ index ]; }
+		bool UpdateExportProgressAndCheckForCancel ( U64 ) { return false; }
+
+	protected:
+		const vector<BitbusFrame> & mFrames;
+	};
+
+	void Work();
+	void Format ( Chunk & chunk );
+	// Writes chunks in order until no more than keep are in flight
+	void WriteChunks ( size_t keep );
+
+	ostream & mOut;
+	const BitbusDecoderSettings & mSettings;
+	DisplayBase mDisplayBase;
+	U64 mTriggerSample;
+	U32 mSampleRate;
+	BitbusNumberFormatter mNumberString;
+	BitbusTimeFormatter mTimeString;
+	size_t mMaxInFlight;
+	U32 mChunkFrames;
+	vector<BitbusFrame> mChunk; // by AddFrame()
+	U64 mAddedFrames;
+
+	mutex mLock;
+	condition_variable mWorkReady;
+	condition_variable mChunkDone;
+	deque< unique_ptr<Chunk> > mInFlight; // in export order
+	deque<Chunk*> mToFormat;
+	// Buffers of written chunks, used again
+	vector< vector<BitbusFrame> > mSpareFrames;
+	vector< vector<char> > mSpareText;
+	bool mStop;
+	vector<thread> mThreads;
+	U64 mWrittenFrames;
+};
+
+// BitbusWriteCsvExport with the formatting on threads. The frames are read
+// on this thread, forward only, and progress and cancel are checked here
+// as each chunk is written. One thread (or none) formats as
+// BitbusWriteCsvExport does.
+template <class Frames>
+void BitbusWriteCsvExportParallel ( ostream & fileStream, Frames & frames, const BitbusDecoderSettings & settings,
+                                    DisplayBase display_base, U64 triggerSample, U32 sampleRate,
+                                    BitbusNumberFormatter numberString, BitbusTimeFormatter timeString,
+                                    U32 threads, U32 chunkFrames = BITBUS_EXPORT_CHUNK_FRAMES )
+{
+	if ( threads <= 1 )
+	{
+		BitbusWriteCsvExport ( fileStream, frames, settings, display_base, triggerSample, sampleRate, numberString, timeString );
+		return;
+	}
+
+	BitbusParallelCsvExport exporter ( fileStream, settings, display_base, triggerSample, sampleRate, numberString, timeString,
+	                                   threads, chunkFrames );
+	U64 reported = 0;
+	U64 frameNumber = 0;
+	for ( ; frames.HasFrame ( frameNumber ); ++frameNumber )
+	{
+		exporter.AddFrame ( frames.GetFrame ( frameNumber ) );
+		if ( exporter.GetWrittenFrames() != reported )
+		{
+			reported = exporter.GetWrittenFrames();
+			if ( frames.UpdateExportProgressAndCheckForCancel ( reported ) )
+			{
+				return;
+			}
+		}
+	}
+	exporter.Finish();
+	frames.UpdateExportProgressAndCheckForCancel ( frameNumber );
+}
+
+#endif //BITBUS_PARALLEL_EXPORT_H
@@ -0,0 +1,438 @@
+#include "BitbusRunLengthCapture.h"
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <stdint.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+template <class T>
+static void PutField ( U8* to, T value )
+{
+	memcpy ( to, &value, sizeof ( value ) );
+}
+
+template <class T>
+static T GetField ( const U8* from )
+{
+	T value;
+	memcpy ( &value, from, sizeof ( value ) );
+	return value;
+}
+
+//
+/////////////// WRITER ///////////////////////////////////////////////
+//
+
+BitbusRunLengthWriter::BitbusRunLengthWriter() :
+	mFile ( 0 ), mWriteError ( false ), mEdgesPerBlock ( BITBUS_RLE_EDGES_PER_BLOCK ), mSampleRate ( 0 ),
+	mInitialState ( BIT_LOW ), mTriggerSample ( 0 ), mEdgeCount ( 0 ), mLastEdge ( 0 ), mOffset ( 0 )
+{
+}
+
+BitbusRunLengthWriter::~BitbusRunLengthWriter()
+{
+	if ( mFile != 0 )
+	{
+		fclose ( mFile );
+	}
+}
+
+bool BitbusRunLengthWriter::Create ( const char* path, U32 sampleRate, BitState initialState, U64 triggerSample, string & error,
+                                     U32 edgesPerBlock )
+{
+	mFile = fopen ( path, "wb" );
+	if ( mFile == 0 )
+	{
+		error = string ( "cannot write " ) + path;
+		return false;
+	}
+
+	mEdgesPerBlock = ( edgesPerBlock > 0 ) ? edgesPerBlock : BITBUS_RLE_EDGES_PER_BLOCK;
+	mSampleRate = sampleRate;
+	mInitialState = initialState;
+	mTriggerSample = triggerSample;
+	mBlock.reserve ( mEdgesPerBlock * 2 );
+
+	// Placeholder until Close() knows the counts
+	mOffset = BITBUS_RLE_HEADER_SIZE;
+	return WriteHeader ( 0, 0 );
+}
+
+bool BitbusRunLengthWriter::AddEdge ( U64 sample )
+{
+	if ( ( mEdgeCount > 0 ) && ( sample <= mLastEdge ) )
+	{
+		return false;
+	}
+
+	if ( mIndex.empty() || ( mIndex.back().mEdgeCount == mEdgesPerBlock ) )
+	{
+		FlushBlock();
+		BitbusRunLengthBlock block;
+		block.mFirstEdge = sample;
+		block.mOffset = mOffset;
+		block.mEdgeCount = 1;
+		block.mStateBefore = ( ( mEdgeCount & 1 ) == 0 ) ? mInitialState : ( mInitialState == BIT_LOW ? BIT_HIGH : BIT_LOW );
+		mIndex.push_back ( block );
+	}
+	else
+	{
+		U64 delta = sample - mLastEdge;
+		while ( delta >= 0x80 )
+		{
+			mBlock.push_back ( U8 ( delta | 0x80 ) );
+			delta >>= 7;
+		}
+		mBlock.push_back ( U8 ( delta ) );
+		mIndex.back().mEdgeCount++;
+	}
+
+	mLastEdge = sample;
+	mEdgeCount++;
+	return true;
+}
+
+void BitbusRunLengthWriter::FlushBlock()
+{
+	if ( !mBlock.empty() )
+	{
+		mWriteError |= ( fwrite ( mBlock.data(), 1, mBlock.size(), mFile ) != mBlock.size() );
+		mOffset += mBlock.size();
+		mBlock.clear();
+	}
+}
+
+bool BitbusRunLengthWriter::Close ( U64 endSample )
+{
+	if ( mFile == 0 )
+	{
+		return false;
+	}
+
+	FlushBlock();
+
+	U64 indexOffset = mOffset;
+	for ( U32 i=0; i < mIndex.size(); ++i )
+	{
+		U8 entry[ BITBUS_RLE_INDEX_ENTRY_SIZE ];
+		PutField<U64> ( entry, mIndex[ i ].mFirstEdge );
+		PutField<U64> ( entry + 8, mIndex[ i ].mOffset );
+		PutField<U32> ( entry + 16, mIndex[ i ].mEdgeCount );
+		PutField<U32> ( entry + 20, mIndex[ i ].mStateBefore );
+		mWriteError |= ( fwrite ( entry, 1, sizeof ( entry ), mFile ) != sizeof ( entry ) );
+	}
+
+	bool ok = ( fseek ( mFile, 0, SEEK_SET ) == 0 ) && WriteHeader ( ( endSample > mLastEdge ) ? endSample : mLastEdge, indexOffset );
+	ok = ( fclose ( mFile ) == 0 ) && ok && !mWriteError;
+	mFile = 0;
+	return ok;
+}
+
+U64 BitbusRunLengthWriter::GetSize() const
+{
+	return mOffset + mBlock.size();
+}
+
+bool BitbusRunLengthWriter::WriteHeader ( U64 endSample, U64 indexOffset )
+{
+	U8 header[ BITBUS_RLE_HEADER_SIZE ];
+	memcpy ( header, BITBUS_RLE_ID, 8 );
+	PutField<U32> ( header + 8, BITBUS_RLE_VERSION );
+	PutField<U32> ( header + 12, mEdgesPerBlock );
+	PutField<U32> ( header + 16, mSampleRate );
+	PutField<U32> ( header + 20, mInitialState );
+	PutField<U64> ( header + 24, mTriggerSample );
+	PutField<U64> ( header + 32, endSample );
+	PutField<U64> ( header + 40, mEdgeCount );
+	PutField<U64> ( header + 48, mIndex.size() );
+	PutField<U64> ( header + 56, indexOffset );
+	return fwrite ( header, 1, sizeof ( header ), mFile ) == sizeof ( header );
+}
+
+//
+/////////////// READER ///////////////////////////////////////////////
+//
+
+BitbusRunLengthReader::BitbusRunLengthReader() :
+	mData ( 0 ), mSize ( 0 ), mEdgeCount ( 0 ), mBlockCount ( 0 ), mIndexOffset ( 0 ),
+	mBlock ( 0 ), mEdgeInBlock ( 0 ), mCursor ( 0 ), mLastEdge ( 0 )
+{
+	mCurrent = BitbusRunLengthBlock();
+}
+
+BitbusRunLengthReader::~BitbusRunLengthReader()
+{
+	Unmap();
+}
+
+void BitbusRunLengthReader::Unmap()
+{
+	if ( mData != 0 )
+	{
+#ifdef _WIN32
+		UnmapViewOfFile ( mData );
+#else
+		munmap ( const_cast<U8*> ( mData ), size_t ( mSize ) );
+#endif
+	}
+	mData = 0;
+	mSize = 0;
+}
+
+bool BitbusRunLengthReader::IsRunLength ( const char* path )
+{
+	FILE* file = fopen ( path, "rb" );
+	if ( file == 0 )
+	{
+		return false;
+	}
+	char id[ 8 ];
+	bool isRunLength = ( fread ( id, 1, sizeof ( id ), file ) == sizeof ( id ) ) && ( memcmp ( id, BITBUS_RLE_ID, 8 ) == 0 );
+	fclose ( file );
+	return isRunLength;
+}
+
+bool BitbusRunLengthReader::Open ( const char* path, U32 sampleRate, string & error )
+{
+	Unmap();
+	error = string ( "cannot read " ) + path;
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA ( path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0 );
+	if ( file == INVALID_HANDLE_VALUE )
+	{
+		return false;
+	}
+	LARGE_INTEGER size;
+	const void* data = 0;
+	if ( GetFileSizeEx ( file, &size ) && ( size.QuadPart > 0 ) && ( U64 ( size.QuadPart ) <= U64 ( SIZE_MAX ) ) )
+	{
+		// The view keeps the mapping open
+		HANDLE mapping = CreateFileMappingA ( file, 0, PAGE_READONLY, 0, 0, 0 );
+		if ( mapping != 0 )
+		{
+			data = MapViewOfFile ( mapping, FILE_MAP_READ, 0, 0, 0 );
+			CloseHandle ( mapping );
+		}
+	}
+	CloseHandle ( file );
+	if ( data == 0 )
+	{
+		return false;
+	}
+	mData = static_cast<const U8*> ( data );
+	mSize = U64 ( size.QuadPart );
+#else
+	int fd = open ( path, O_RDONLY );
+	if ( fd < 0 )
+	{
+		return false;
+	}
+	struct stat info;
+	void* data = MAP_FAILED;
+	if ( ( fstat ( fd, &info ) == 0 ) && ( info.st_size > 0 ) )
+	{
+		data = mmap ( 0, size_t ( info.st_size ), PROT_READ, MAP_SHARED, fd, 0 );
+	}
+	close ( fd );
+	if ( data == MAP_FAILED )
+	{
+		return false;
+	}
+	mData = static_cast<const U8*> ( data );
+	mSize = U64 ( info.st_size );
+#endif
+
+	error = string ( path ) + " is not a BITBUS run-length capture";
+	if ( ( mSize < BITBUS_RLE_HEADER_SIZE ) || ( memcmp ( mData, BITBUS_RLE_ID, 8 ) != 0 ) ||
+	     ( GetField<U32> ( mData + 8 ) != BITBUS_RLE_VERSION ) )
+	{
+		return false;
+	}
+
+	mSampleRate = ( sampleRate != 0 ) ? sampleRate : GetField<U32> ( mData + 16 );
+	mInitialState = ( GetField<U32> ( mData + 20 ) != 0 ) ? BIT_HIGH : BIT_LOW;
+	mTriggerSample = GetField<U64> ( mData + 24 );
+	mEndSample = GetField<U64> ( mData + 32 );
+	mEdgeCount = GetField<U64> ( mData + 40 );
+	mBlockCount = GetField<U64> ( mData + 48 );
+	mIndexOffset = GetField<U64> ( mData + 56 );
+
+	// Everything the reader later relies on is checked here
+	if ( ( mIndexOffset < BITBUS_RLE_HEADER_SIZE ) || ( mIndexOffset > mSize ) ||
+	     ( mBlockCount > ( mSize - mIndexOffset ) / BITBUS_RLE_INDEX_ENTRY_SIZE ) )
+	{
+		error = string ( path ) + " is truncated or damaged";
+		return false;
+	}
+	U64 edges = 0;
+	for ( U64 i=0; i < mBlockCount; ++i )
+	{
+		BitbusRunLengthBlock block = GetBlock ( i );
+		if ( ( block.mOffset < BITBUS_RLE_HEADER_SIZE ) || ( block.mOffset > mIndexOffset ) || ( block.mEdgeCount == 0 ) )
+		{
+			error = string ( path ) + " is truncated or damaged";
+			return false;
+		}
+		edges += block.mEdgeCount;
+	}
+	if ( edges != mEdgeCount )
+	{
+		error = string ( path ) + " is truncated or damaged";
+		return false;
+	}
+	if ( mSampleRate == 0 )
+	{
+		error = string ( path ) + " has no sample rate, it has to be given";
+		return false;
+	}
+
+	error.clear();
+	StartBlock ( 0 );
+	return true;
+}
+
+BitbusRunLengthBlock BitbusRunLengthReader::GetBlock ( U64 block ) const
+{
+	const U8* entry = mData + mIndexOffset + block * BITBUS_RLE_INDEX_ENTRY_SIZE;
+	BitbusRunLengthBlock result;
+	result.mFirstEdge = GetField<U64> ( entry );
+	result.mOffset = GetField<U64> ( entry + 8 );
+	result.mEdgeCount = GetField<U32> ( entry + 16 );
+	result.mStateBefore = GetField<U32> ( entry + 20 );
+	return result;
+}
+
+void BitbusRunLengthReader::StartBlock ( U64 block )
+{
+	mBlock = block;
+	mEdgeInBlock = 0;
+	if ( block < mBlockCount )
+	{
+		mCurrent = GetBlock ( block );
+		mCursor = mData + mCurrent.mOffset;
+	}
+}
+
+bool BitbusRunLengthReader::ReadEdge ( U64 & sample )
+{
+	while ( ( mBlock < mBlockCount ) && ( mEdgeInBlock == mCurrent.mEdgeCount ) )
+	{
+		StartBlock ( mBlock + 1 );
+	}
+	if ( mBlock >= mBlockCount )
+	{
+		return false;
+	}
+
+	if ( mEdgeInBlock == 0 )
+	{
+		mLastEdge = mCurrent.mFirstEdge;
+	}
+	else
+	{
+		// A damaged block cannot read past the index
+		const U8* end = mData + mIndexOffset;
+		U64 delta = 0;
+		U32 shift = 0;
+		while ( ( mCursor < end ) && ( *mCursor & 0x80 ) && ( shift < 63 ) )
+		{
+			delta |= U64 ( *mCursor++ & 0x7F ) << shift;
+			shift += 7;
+		}
+		if ( mCursor >= end )
+		{
+			mBlock = mBlockCount;
+			return false;
+		}
+		delta |= U64 ( *mCursor++ ) << shift;
+		mLastEdge += delta;
+	}
+
+	mEdgeInBlock++;
+	sample = mLastEdge;
+	return true;
+}
+
+// The writer only stores ascending edges, there is nothing to cancel
+bool BitbusRunLengthReader::NextEdge ( U64 & sample )
+{
+	return ReadEdge ( sample );
+}
+
+bool BitbusRunLengthReader::Seek ( U64 sample, BitState & state )
+{
+	// Last block starting at or before sample
+	U64 low = 0;
+	U64 high = mBlockCount;
+	while ( low < high )
+	{
+		U64 middle = low + ( high - low ) / 2;
+		if ( GetBlock ( middle ).mFirstEdge <= sample )
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	if ( low == 0 )
+	{
+		StartBlock ( 0 );
+		state = mInitialState;
+		return true;
+	}
+
+	StartBlock ( low - 1 );
+	state = mCurrent.mStateBefore ? BIT_HIGH : BIT_LOW;
+
+	// Walk the block up to sample, keeping the first edge after it for NextEdge()
+	for ( ; ; )
+	{
+		const U8* cursor = mCursor;
+		U32 edgeInBlock = mEdgeInBlock;
+		U64 lastEdge = mLastEdge;
+		U64 edge;
+		if ( !ReadEdge ( edge ) )
+		{
+			break;
+		}
+		if ( edge > sample )
+		{
+			// Back to before that edge; it may have started the next block
+			if ( mBlock == low - 1 )
+			{
+				mCursor = cursor;
+				mEdgeInBlock = edgeInBlock;
+				mLastEdge = lastEdge;
+			}
+			else
+			{
+				StartBlock ( mBlock );
+			}
+			break;
+		}
+		state = ( state == BIT_LOW ) ? BIT_HIGH : BIT_LOW;
+	}
+	return true;
+}
+
+U64 BitbusRunLengthReader::GetEdgeCount() const
+{
+	return mEdgeCount;
+}
+
+U64 BitbusRunLengthReader::GetBlockCount() const
+{
+	return mBlockCount;
+}
@@ -0,0 +1,108 @@
+#ifndef BITBUS_RUN_LENGTH_CAPTURE_H
+#define BITBUS_RUN_LENGTH_CAPTURE_H
+
+#include "BitbusCaptureReader.h"
+#include <vector>
+
+// BITBUS run-length capture (.bbrl): one digital channel stored as the
+// distances between edges. A slow line sampled fast is nearly all idle
+// samples, so this is a small fraction of a sample-per-bit capture.
+//
+// Little endian, in this order:
+//   header   BITBUS_RLE_HEADER_SIZE bytes: "BITBUSRL", version, edges per
+//            block, sample rate, initial state, trigger sample, end sample,
+//            edge count, block count, offset of the block index
+//   blocks   per block, the varint (7 bits per byte, low bits first)
+//            distances from each edge to the one before it; the block's
+//            first edge is in the index
+//   index    per block: sample of the first edge, file offset of the
+//            block, its edge count, line state before its first edge
+
+#define BITBUS_RLE_ID "BITBUSRL"
+#define BITBUS_RLE_VERSION 1
+#define BITBUS_RLE_HEADER_SIZE 64
+#define BITBUS_RLE_INDEX_ENTRY_SIZE 24
+#define BITBUS_RLE_EDGES_PER_BLOCK 4096
+
+struct BitbusRunLengthBlock
+{
+	U64 mFirstEdge;
+	U64 mOffset;
+	U32 mEdgeCount;
+	U32 mStateBefore; // BitState
+};
+
+class BitbusRunLengthWriter
+{
+public:
+	BitbusRunLengthWriter();
+	~BitbusRunLengthWriter();
+
+	bool Create ( const char* path, U32 sampleRate, BitState initialState, U64 triggerSample, string & error,
+	              U32 edgesPerBlock = BITBUS_RLE_EDGES_PER_BLOCK );
+	// Edges must be ascending; one at or before the last is refused
+	bool AddEdge ( U64 sample );
+	// Writes the last block, the index and the final header
+	bool Close ( U64 endSample );
+
+	// Bytes of edges so far, the header included and the index not
+	U64 GetSize() const;
+
+protected:
+	void FlushBlock();
+	bool WriteHeader ( U64 endSample, U64 indexOffset );
+
+	FILE* mFile;
+	bool mWriteError;
+	U32 mEdgesPerBlock;
+	U32 mSampleRate;
+	BitState mInitialState;
+	U64 mTriggerSample;
+
+	U64 mEdgeCount;
+	U64 mLastEdge;
+	U64 mOffset;
+	vector<U8> mBlock;
+	vector<BitbusRunLengthBlock> mIndex;
+};
+
+// Reads a .bbrl capture memory-mapped. Seek() finds a sample with a binary
+// search of the block index plus a walk through one block.
+class BitbusRunLengthReader : public BitbusCaptureReader
+{
+public:
+	BitbusRunLengthReader();
+	virtual ~BitbusRunLengthReader();
+
+	// sampleRate overrides the one in the file if not 0
+	virtual bool Open ( const char* path, U32 sampleRate, string & error );
+	virtual bool NextEdge ( U64 & sample );
+	virtual bool Seek ( U64 sample, BitState & state );
+
+	U64 GetEdgeCount() const;
+	U64 GetBlockCount() const;
+
+	// Does the file start like a run-length capture?
+	static bool IsRunLength ( const char* path );
+
+protected:
+	virtual bool ReadEdge ( U64 & sample );
+	BitbusRunLengthBlock GetBlock ( U64 block ) const;
+	void StartBlock ( U64 block );
+	void Unmap();
+
+	const U8* mData;
+	U64 mSize;
+
+	U64 mEdgeCount;
+	U64 mBlockCount;
+	U64 mIndexOffset;
+
+	U64 mBlock; // current block, mBlockCount at the end
+	BitbusRunLengthBlock mCurrent;
+	U32 mEdgeInBlock; // edges of mCurrent already read
+	const U8* mCursor;
+	U64 mLastEdge;
+};
+
+#endif //BITBUS_RUN_LENGTH_CAPTURE_H
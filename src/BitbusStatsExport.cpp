@@ -0,0 +1,37 @@
+#include "BitbusStatsExport.h"
+
+static void WriteCounter ( ostream & out, const char* name, U64 value )
+{
+	out << name << ',' << value << '\n';
+}
+
+void BitbusWriteStatsExport ( ostream & out, const BitbusDecodeStats & stats )
+{
+	out << BITBUS_STATS_HEADER;
+	WriteCounter ( out, "bit_rate", stats.mBitRate );
+	WriteCounter ( out, "fields", stats.mFields );
+	WriteCounter ( out, "frames", stats.mPackets );
+	WriteCounter ( out, "information_bytes", stats.mInformationBytes );
+	WriteCounter ( out, "flags", stats.mFlags );
+	WriteCounter ( out, "fill_flags", stats.mFillFlags );
+	WriteCounter ( out, "aborts", stats.mAborts );
+	WriteCounter ( out, "fcs_errors", stats.mFcsErrors );
+	WriteCounter ( out, "stuffed_bits", stats.mStuffedBits );
+	WriteCounter ( out, "framing_errors", stats.mFramingErrors );
+	WriteCounter ( out, "edges", stats.mEdges );
+	WriteCounter ( out, "channel_calls", stats.mChannelCalls );
+	WriteCounter ( out, "resyncs", stats.mResyncs );
+	WriteCounter ( out, "buffer_allocations", stats.mAllocations );
+	WriteCounter ( out, "flag_hunts", stats.mHunt.mHunts );
+	WriteCounter ( out, "flag_hunt_edges", stats.mHunt.mEdgesSkipped );
+	WriteCounter ( out, "flag_hunt_samples", stats.mHunt.mSamplesSkipped );
+	WriteCounter ( out, "flag_hunt_ns", stats.mHunt.mNanoseconds );
+#ifdef BITBUS_PHASE_TIMING
+	// Not measured otherwise: no rows rather than zeros
+	WriteCounter ( out, "flag_phase_ns", stats.mFlagNanoseconds );
+	WriteCounter ( out, "byte_phase_ns", stats.mByteNanoseconds );
+#endif
+	WriteCounter ( out, "commits", stats.mCommits );
+	WriteCounter ( out, "committed_frames", stats.mCommittedPackets );
+	WriteCounter ( out, "commit_ns", stats.mCommitNanoseconds );
+}
@@ -0,0 +1,15 @@
+#ifndef BITBUS_STATS_EXPORT_H
+#define BITBUS_STATS_EXPORT_H
+
+#include "BitbusDecoder.h"
+#include <ostream>
+
+using namespace std;
+
+#define BITBUS_STATS_HEADER "Counter,Value\n"
+
+// The decode counters export: one "name,value" line per counter of
+// BitbusDecodeStats, times in nanoseconds
+void BitbusWriteStatsExport ( ostream & out, const BitbusDecodeStats & stats );
+
+#endif //BITBUS_STATS_EXPORT_H
@@ -0,0 +1,183 @@
+#ifndef BITBUS_TEXT_CACHE_H
+#define BITBUS_TEXT_CACHE_H
+
+#include "BitbusFormat.h"
+#include <string.h>
+#include <vector>
+
+using namespace std;
+
+// Fields whose text is kept (a power of two), and room for the strings of
+// one of them (a field with more text is not kept)
+#ifndef BITBUS_TEXT_CACHE_ENTRIES
+#define BITBUS_TEXT_CACHE_ENTRIES 1024
+#endif
+#define BITBUS_TEXT_CACHE_ENTRY_BYTES 256
+
+// The bubble or tabular strings last generated for a field, given out again
+// when the same field is asked for in the same display base: the SDK asks
+// for the text of every field in view on each redraw. Direct mapped on the
+// frame index. The text only depends on the field and the settings, and
+// neither changes for the life of the analyzer results.
+//
+// Stands in for Out while the text is generated: after StartEntry(), each
+// string is put together from its pieces, passed on to Out and kept.
+template <class Out>
+class BitbusTextCache
+{
+public:
+	BitbusTextCache();
+
+	// Gives the kept strings of the field to out; false if they are not kept
+	bool Replay ( Out & out, U64 frame_index, DisplayBase display_base, bool tabular );
+	// The strings added next are the field's, for out
+	void StartEntry ( Out & out, U64 frame_index, DisplayBase display_base, bool tabular );
+
+	void AddResultString ( const char* str1, const char* str2 = 0, const char* str3 = 0,
+	                       const char* str4 = 0, const char* str5 = 0, const char* str6 = 0 );
+	void AddTabularText ( const char* str1, const char* str2 = 0, const char* str3 = 0,
+	                      const char* str4 = 0, const char* str5 = 0, const char* str6 = 0 );
+
+	U64 GetHits() const;
+	U64 GetMisses() const;
+
+protected:
+	struct Entry
+	{
+		U64 mFrameIndex;
+		DisplayBase mDisplayBase;
+		bool mTabular;
+		bool mValid;
+		U32 mStrings;
+		U32 mLength;
+		char mText[ BITBUS_TEXT_CACHE_ENTRY_BYTES ]; // the strings, each ended by a 0
+	};
+
+	Entry & EntryOf ( U64 frame_index );
+	// Joins the pieces and keeps the string in the open entry
+	const char* Keep ( const char* str1, const char* str2, const char* str3,
+	                   const char* str4, const char* str5, const char* str6 );
+
+	vector<Entry> mEntries;
+	Out* mOut;
+	Entry* mEntry;
+	BitbusFixedText mString;
+	U64 mHits;
+	U64 mMisses;
+};
+
+static_assert ( ( BITBUS_TEXT_CACHE_ENTRIES & ( BITBUS_TEXT_CACHE_ENTRIES - 1 ) ) == 0, "text cache entries must be a power of two" );
+
+template <class Out>
+BitbusTextCache<Out>::BitbusTextCache()
+	:	mEntries ( BITBUS_TEXT_CACHE_ENTRIES ),
+	    mOut ( 0 ), mEntry ( 0 ), mHits ( 0 ), mMisses ( 0 )
+{
+	for ( U32 i=0; i < mEntries.size(); ++i )
+	{
+		mEntries[ i ].mValid = false;
+	}
+}
+
+template <class Out>
+typename BitbusTextCache<Out>::Entry & BitbusTextCache<Out>::EntryOf ( U64 frame_index )
+{
+	return mEntries[ frame_index & ( BITBUS_TEXT_CACHE_ENTRIES - 1 ) ];
+}
+
+template <class Out>
+bool BitbusTextCache<Out>::Replay ( Out & out, U64 frame_index, DisplayBase display_base, bool tabular )
+{
+	const Entry & entry = EntryOf ( frame_index );
+	if ( !entry.mValid || ( entry.mFrameIndex != frame_index ) ||
+	        ( entry.mDisplayBase != display_base ) || ( entry.mTabular != tabular ) )
+	{
+		mMisses++;
+		return false;
+	}
+
+	const char* str = entry.mText;
+	for ( U32 i=0; i < entry.mStrings; ++i )
+	{
+		if ( tabular )
+		{
+			out.AddTabularText ( str );
+		}
+		else
+		{
+			out.AddResultString ( str );
+		}
+		str += strlen ( str ) + 1;
+	}
+	mHits++;
+	return true;
+}
+
+template <class Out>
+void BitbusTextCache<Out>::StartEntry ( Out & out, U64 frame_index, DisplayBase display_base, bool tabular )
+{
+	mOut = &out;
+	mEntry = &EntryOf ( frame_index );
+	mEntry->mFrameIndex = frame_index;
+	mEntry->mDisplayBase = display_base;
+	mEntry->mTabular = tabular;
+	mEntry->mValid = true;
+	mEntry->mStrings = 0;
+	mEntry->mLength = 0;
+}
+
+template <class Out>
+const char* BitbusTextCache<Out>::Keep ( const char* str1, const char* str2, const char* str3,
+                                         const char* str4, const char* str5, const char* str6 )
+{
+	mString.Clear();
+	const char* pieces[] = { str1, str2, str3, str4, str5, str6 };
+	for ( U32 i=0; i < 6; ++i )
+	{
+		if ( pieces[ i ] != 0 )
+		{
+			mString.Append ( pieces[ i ] );
+		}
+	}
+
+	U32 length = mString.GetLength() + 1;
+	if ( mEntry->mLength + length > BITBUS_TEXT_CACHE_ENTRY_BYTES )
+	{
+		mEntry->mValid = false;
+	}
+	else if ( mEntry->mValid )
+	{
+		memcpy ( mEntry->mText + mEntry->mLength, mString.c_str(), length );
+		mEntry->mLength += length;
+		mEntry->mStrings++;
+	}
+	return mString.c_str();
+}
+
+template <class Out>
+void BitbusTextCache<Out>::AddResultString ( const char* str1, const char* str2, const char* str3,
+                                             const char* str4, const char* str5, const char* str6 )
+{
+	mOut->AddResultString ( Keep ( str1, str2, str3, str4, str5, str6 ) );
+}
+
+template <class Out>
+void BitbusTextCache<Out>::AddTabularText ( const char* str1, const char* str2, const char* str3,
+                                            const char* str4, const char* str5, const char* str6 )
+{
+	mOut->AddTabularText ( Keep ( str1, str2, str3, str4, str5, str6 ) );
+}
+
+template <class Out>
+U64 BitbusTextCache<Out>::GetHits() const
+{
+	return mHits;
+}
+
+template <class Out>
+U64 BitbusTextCache<Out>::GetMisses() const
+{
+	return mMisses;
+}
+
+#endif //BITBUS_TEXT_CACHE_H
@@ -0,0 +1,172 @@
+#include "BitbusTrace.h"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <stdlib.h>
+#include <string.h>
+
+template <class T>
+static void PutField ( U8* to, T value )
+{
+	memcpy ( to, &value, sizeof ( value ) );
+}
+
+template <class T>
+static T GetField ( const U8* from )
+{
+	T value;
+	memcpy ( &value, from, sizeof ( value ) );
+	return value;
+}
+
+static const char* const sEventNames[ BITBUS_TRACE_EVENTS ] =
+{
+	"setup", "frame_start", "byte", "marker", "flag_hunt", "abort", "frame_end", "resync", "bit_rate", "commit", "abort_storm"
+};
+
+static std::atomic<U32> sThreads ( 0 );
+static std::atomic<bool> sDumpOnExit ( false );
+static std::mutex sDirectoryMutex;
+static string sDirectory;
+
+const char* BitbusTraceEventName ( U32 event )
+{
+	return ( event < BITBUS_TRACE_EVENTS ) ? sEventNames[ event ] : "unknown";
+}
+
+BitbusTraceRing::BitbusTraceRing() :
+	mRecords ( BITBUS_TRACE_RECORDS ), mRecorded ( 0 ), mThread ( sThreads++ ), mDumps ( 0 ), mAbortsInARow ( 0 )
+{
+}
+
+U64 BitbusTraceRing::GetRecordedCount() const
+{
+	return mRecorded;
+}
+
+U32 BitbusTraceRing::GetThread() const
+{
+	return mThread;
+}
+
+void BitbusTraceRing::Write ( ostream & out, const char* reason ) const
+{
+	const U64 kept = min<U64> ( mRecorded, BITBUS_TRACE_RECORDS );
+
+	U8 header[ BITBUS_TRACE_HEADER_SIZE ] = {};
+	memcpy ( header, BITBUS_TRACE_ID, 8 );
+	PutField<U32> ( header + 8, BITBUS_TRACE_VERSION );
+	PutField<U32> ( header + 12, mThread );
+	PutField<U64> ( header + 16, mRecorded );
+	PutField<U64> ( header + 24, kept );
+	strncpy ( reinterpret_cast<char*> ( header + 32 ), reason, BITBUS_TRACE_REASON_SIZE - 1 );
+	out.write ( reinterpret_cast<const char*> ( header ), sizeof ( header ) );
+
+	for ( U64 i=mRecorded - kept; i < mRecorded; ++i )
+	{
+		const BitbusTraceRecord & record = mRecords[ i & ( BITBUS_TRACE_RECORDS - 1 ) ];
+		U8 bytes[ BITBUS_TRACE_RECORD_SIZE ];
+		PutField<U64> ( bytes, record.mSample );
+		PutField<U32> ( bytes + 8, record.mEvent );
+		PutField<U32> ( bytes + 12, record.mPayload );
+		out.write ( reinterpret_cast<const char*> ( bytes ), sizeof ( bytes ) );
+	}
+}
+
+// A thread's ring, dumped as the thread exits if Configure() asked for it
+class BitbusThreadTrace
+{
+public:
+	~BitbusThreadTrace()
+	{
+		if ( sDumpOnExit && ( mRing.GetRecordedCount() > 0 ) )
+		{
+			mRing.Dump ( "exit" );
+		}
+	}
+
+	BitbusTraceRing mRing;
+};
+
+BitbusTraceRing & BitbusTraceRing::ForThisThread()
+{
+	static thread_local BitbusThreadTrace trace;
+	return trace.mRing;
+}
+
+void BitbusTraceRing::Configure ( const string & directory, bool dumpOnExit )
+{
+	std::lock_guard<std::mutex> lock ( sDirectoryMutex );
+	sDirectory = directory;
+	sDumpOnExit = dumpOnExit;
+}
+
+void BitbusTraceRing::Trace ( U32 event, U64 sample, U32 payload )
+{
+	Record ( event, sample, payload );
+	if ( event == BITBUS_TRACE_FRAME_END )
+	{
+		mAbortsInARow = 0;
+	}
+	else if ( ( event == BITBUS_TRACE_ABORT ) && ( ++mAbortsInARow == BITBUS_TRACE_STORM_ABORTS ) )
+	{
+		Record ( BITBUS_TRACE_ABORT_STORM, sample, mAbortsInARow );
+		if ( mDumps < BITBUS_TRACE_MAX_DUMPS )
+		{
+			Dump ( "abort storm" );
+		}
+	}
+}
+
+string BitbusTraceRing::Dump ( const char* reason )
+{
+	string directory;
+	{
+		std::lock_guard<std::mutex> lock ( sDirectoryMutex );
+		directory = sDirectory;
+	}
+	if ( directory.empty() )
+	{
+		const char* environment = getenv ( "BITBUS_TRACE_DIR" );
+		directory = ( environment != 0 ) ? environment : ".";
+	}
+
+	string path = directory + "/bitbus-trace-" + to_string ( mThread ) + "-" + to_string ( mDumps++ ) + ".bbtr";
+	ofstream file ( path.c_str(), ios::out | ios::binary );
+	Write ( file, reason );
+	return file ? path : string();
+}
+
+bool BitbusReadTrace ( istream & in, BitbusTraceHeader & header, vector<BitbusTraceRecord> & records, string & error )
+{
+	U8 bytes[ BITBUS_TRACE_HEADER_SIZE ];
+	if ( !in.read ( reinterpret_cast<char*> ( bytes ), sizeof ( bytes ) ) || ( memcmp ( bytes, BITBUS_TRACE_ID, 8 ) != 0 ) )
+	{
+		error = "not a BITBUS trace";
+		return false;
+	}
+	if ( GetField<U32> ( bytes + 8 ) != BITBUS_TRACE_VERSION )
+	{
+		error = "unknown trace version";
+		return false;
+	}
+	header.mThread = GetField<U32> ( bytes + 12 );
+	header.mRecorded = GetField<U64> ( bytes + 16 );
+	header.mKept = GetField<U64> ( bytes + 24 );
+	header.mReason = string ( reinterpret_cast<const char*> ( bytes + 32 ), strnlen ( reinterpret_cast<const char*> ( bytes + 32 ), BITBUS_TRACE_REASON_SIZE ) );
+
+	records.clear();
+	for ( U64 i=0; i < header.mKept; ++i )
+	{
+		U8 record[ BITBUS_TRACE_RECORD_SIZE ];
+		if ( !in.read ( reinterpret_cast<char*> ( record ), sizeof ( record ) ) )
+		{
+			error = "trace cut short";
+			return false;
+		}
+		BitbusTraceRecord r = { GetField<U64> ( record ), GetField<U32> ( record + 8 ), GetField<U32> ( record + 12 ) };
+		records.push_back ( r );
+	}
+	return true;
+}
@@ -0,0 +1,127 @@
+#ifndef BITBUS_TRACE_H
+#define BITBUS_TRACE_H
+
+#include "BitbusTypes.h"
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Decoder trace: fixed size binary records kept in a ring per thread, the
+// latest BITBUS_TRACE_RECORDS of them, written to a file on demand or when
+// the line goes wrong (BITBUS_TRACE_STORM_ABORTS aborts in a row). Decode
+// a dump with BitbusTraceDump.
+//
+// Recording is compiled in with -DBITBUS_TRACE (cmake -DBITBUS_TRACE=ON).
+// Without it BITBUS_TRACE_EVENT expands to nothing, arguments included.
+//
+// Dump file, little endian, in this order:
+//   header   BITBUS_TRACE_HEADER_SIZE bytes: "BITBUSTR", version, thread
+//            number, records recorded in all, records kept, reason
+//   records  the ones kept, oldest first: sample, event, payload
+
+#define BITBUS_TRACE_ID "BITBUSTR"
+#define BITBUS_TRACE_VERSION 1
+#define BITBUS_TRACE_HEADER_SIZE 64
+#define BITBUS_TRACE_RECORD_SIZE 16
+#define BITBUS_TRACE_REASON_SIZE 32
+
+// Records per thread, a power of two
+#ifndef BITBUS_TRACE_RECORDS
+#define BITBUS_TRACE_RECORDS 65536
+#endif
+#ifndef BITBUS_TRACE_STORM_ABORTS
+#define BITBUS_TRACE_STORM_ABORTS 16
+#endif
+// Dumps a thread writes for anomalies, so a noisy line does not fill the disk
+#ifndef BITBUS_TRACE_MAX_DUMPS
+#define BITBUS_TRACE_MAX_DUMPS 4
+#endif
+
+enum BitbusTraceEvent
+{
+	BITBUS_TRACE_SETUP,          // payload: bit rate
+	BITBUS_TRACE_FRAME_START,    // the address byte
+	BITBUS_TRACE_BYTE,           // payload: value
+	BITBUS_TRACE_MARKER,         // payload: BitbusMarkerType
+	BITBUS_TRACE_FLAG_HUNT,
+	BITBUS_TRACE_ABORT,
+	BITBUS_TRACE_FRAME_END,      // the end flag
+	BITBUS_TRACE_RESYNC,         // payload: 1 after an idle line, 0 after an abort
+	BITBUS_TRACE_BIT_RATE,       // payload: bit rate detected
+	BITBUS_TRACE_COMMIT,         // payload: frames committed
+	BITBUS_TRACE_ABORT_STORM,    // payload: aborts in a row
+	BITBUS_TRACE_EVENTS
+};
+
+struct BitbusTraceRecord
+{
+	U64 mSample;
+	U32 mEvent;
+	U32 mPayload;
+};
+
+struct BitbusTraceHeader
+{
+	U32 mThread;
+	U64 mRecorded;
+	U64 mKept;
+	string mReason;
+};
+
+// Name of a BitbusTraceEvent, for the dump tool
+const char* BitbusTraceEventName ( U32 event );
+
+class BitbusTraceRing
+{
+public:
+	BitbusTraceRing();
+
+	void Record ( U32 event, U64 sample, U32 payload )
+	{
+		BitbusTraceRecord & record = mRecords[ mRecorded & ( BITBUS_TRACE_RECORDS - 1 ) ];
+		record.mSample = sample;
+		record.mEvent = event;
+		record.mPayload = payload;
+		mRecorded++;
+	}
+
+	U64 GetRecordedCount() const;
+	U32 GetThread() const;
+
+	// Header and the records kept, oldest first
+	void Write ( ostream & out, const char* reason ) const;
+
+	// The ring of the calling thread, made on first use. Anomalies dump it
+	// to the trace directory, and so does the thread exiting if asked to.
+	static BitbusTraceRing & ForThisThread();
+	// Where dumps go (empty: BITBUS_TRACE_DIR from the environment, else the
+	// current directory) and whether every thread dumps when it exits
+	static void Configure ( const string & directory, bool dumpOnExit );
+
+	// Records an event and looks for an anomaly to dump on
+	void Trace ( U32 event, U64 sample, U32 payload );
+	// To bitbus-trace-<thread>-<n>.bbtr in the trace directory; the path, or
+	// empty if it could not be written
+	string Dump ( const char* reason );
+
+protected:
+	vector<BitbusTraceRecord> mRecords;
+	U64 mRecorded;
+	U32 mThread;
+	U32 mDumps;
+	U32 mAbortsInARow;
+};
+
+bool BitbusReadTrace ( istream & in, BitbusTraceHeader & header, vector<BitbusTraceRecord> & records, string & error );
+
+#ifdef BITBUS_TRACE
+#define BITBUS_TRACE_EVENT( event, sample, payload ) \
+	BitbusTraceRing::ForThisThread().Trace ( ( event ), ( sample ), U32 ( payload ) )
+#else
+#define BITBUS_TRACE_EVENT( event, sample, payload ) do { } while ( 0 )
+#endif
+
+#endif //BITBUS_TRACE_H
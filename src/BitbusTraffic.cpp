@@ -0,0 +1,71 @@
+#include "BitbusTraffic.h"
+#include <string.h>
+
+BitbusRandom::BitbusRandom ( U64 seed )
+	:	mState ( seed ? seed : 0x9E3779B97F4A7C15ULL ) // xorshift never leaves 0
+{
+}
+
+BitbusTrafficProfile::BitbusTrafficProfile()
+	:	mInfoBytesMin ( 0 ), mInfoBytesMax ( 0 ),
+	    mGapFlagsMin ( 4 ), mGapFlagsMax ( 4 ),
+	    mByteFillMaxBits ( 7 ),
+	    mStuffingPerMille ( 0 ), mAbortPerMille ( 0 ), mFcsErrorPerMille ( 0 )
+{
+}
+
+BitbusTrafficProfile BitbusTrafficProfile::Get ( BitbusTrafficType type )
+{
+	BitbusTrafficProfile profile; // fixed
+	if ( type == BITBUS_TRAFFIC_FIXED )
+	{
+		return profile;
+	}
+
+	if ( type == BITBUS_TRAFFIC_STUFFING )
+	{
+		profile.mInfoBytesMin = 200;
+		profile.mInfoBytesMax = 255;
+		profile.mGapFlagsMin = 1;
+		profile.mGapFlagsMax = 1;
+		profile.mByteFillMaxBits = 0;
+		profile.mStuffingPerMille = 1000;
+		return profile;
+	}
+
+	// Mixed: a few nodes, short to medium messages
+	static const U8 addresses[] = { 0x00, 0x01, 0x02, 0x03, 0x10, 0x20, 0x7E, 0xFF };
+	profile.mInfoBytesMin = 0;
+	profile.mInfoBytesMax = 64;
+	profile.mAddresses.assign ( addresses, addresses + sizeof ( addresses ) );
+	profile.mGapFlagsMin = 1;
+	profile.mGapFlagsMax = 8;
+	profile.mStuffingPerMille = 50;
+
+	if ( type == BITBUS_TRAFFIC_FAULTS )
+	{
+		profile.mAbortPerMille = 50;
+		profile.mFcsErrorPerMille = 50;
+	}
+	return profile;
+}
+
+static const char* const sTrafficNames[ BITBUS_TRAFFIC_TYPES ] = { "fixed", "mixed", "stuffing", "faults" };
+
+const char* BitbusTrafficProfile::GetName ( BitbusTrafficType type )
+{
+	return ( U32 ( type ) < BITBUS_TRAFFIC_TYPES ) ? sTrafficNames[ type ] : "";
+}
+
+bool BitbusTrafficProfile::Find ( const char* name, BitbusTrafficType & type )
+{
+	for ( U32 i=0; i < BITBUS_TRAFFIC_TYPES; ++i )
+	{
+		if ( strcmp ( name, sTrafficNames[ i ] ) == 0 )
+		{
+			type = BitbusTrafficType ( i );
+			return true;
+		}
+	}
+	return false;
+}
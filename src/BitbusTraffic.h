@@ -0,0 +1,341 @@
+#ifndef BITBUS_TRAFFIC_H
+#define BITBUS_TRAFFIC_H
+
+#include "BitbusCrc.h"
+#include "BitbusWaveform.h"
+#include <vector>
+
+using namespace std;
+
+// Random numbers for one traffic generator (xorshift64*): its traffic
+// depends on its seed only, not on other users of rand()
+class BitbusRandom
+{
+public:
+	explicit BitbusRandom ( U64 seed );
+
+	U32 Next()
+	{
+		mState ^= mState >> 12;
+		mState ^= mState << 25;
+		mState ^= mState >> 27;
+		return U32 ( ( mState * 2685821657736338717ULL ) >> 32 );
+	}
+
+	// In [0, n)
+	U32 Below ( U32 n )
+	{
+		return U32 ( ( U64 ( Next() ) * n ) >> 32 );
+	}
+
+	// In [low, high]
+	U32 Between ( U32 low, U32 high )
+	{
+		return low + Below ( high - low + 1 );
+	}
+
+	// True rate times in 1000
+	bool PerMille ( U32 rate )
+	{
+		return Below ( 1000 ) < rate;
+	}
+
+protected:
+	U64 mState;
+};
+
+// Simulated traffic presets
+enum BitbusTrafficType
+{
+	BITBUS_TRAFFIC_FIXED,    // the same empty frame, addresses counting up
+	BITBUS_TRAFFIC_MIXED,    // payloads of 0 to 64 bytes, a few addresses, varied gaps
+	BITBUS_TRAFFIC_STUFFING, // long payloads that are all stuffing, back to back
+	BITBUS_TRAFFIC_FAULTS,   // mixed, with aborts and FCS errors
+};
+#define BITBUS_TRAFFIC_TYPES 4
+
+// The shape of simulated traffic
+struct BitbusTrafficProfile
+{
+	BitbusTrafficProfile();
+
+	static BitbusTrafficProfile Get ( BitbusTrafficType type );
+	// Short name ("fixed", "mixed", ...), and the type of one (false if none)
+	static const char* GetName ( BitbusTrafficType type );
+	static bool Find ( const char* name, BitbusTrafficType & type );
+
+	U32 mInfoBytesMin; // information bytes per frame, evenly spread
+	U32 mInfoBytesMax;
+	vector<U8> mAddresses;   // picked at random; counting up if none
+	U32 mGapFlagsMin;        // flags before each frame's opening flag
+	U32 mGapFlagsMax;
+	U32 mByteFillMaxBits;    // byte async: 0 to this many idle bits after a byte
+	U32 mStuffingPerMille;   // information bytes that all need stuffing
+	U32 mAbortPerMille;      // frames aborted part way
+	U32 mFcsErrorPerMille;   // frames with a bit of the FCS flipped
+};
+
+// A generated frame, as it went on the line: what a decoder should find
+struct BitbusTrafficFrame
+{
+	vector<U8> mBytes;  // address and information sent, not stuffed, no FCS
+	U32 mAddressBytes;
+	U32 mFcs;           // as sent (not sent if aborted)
+	bool mFcsError;
+	bool mAborted;
+	U64 mStartSample;   // of the opening flag
+	U64 mEndSample;     // after the closing flag or the abort
+};
+
+// Sends simulated BITBUS frames on a line driven like the SDK's
+// SimulationChannelDescriptor:
+//   void Transition();
+//   void TransitionIfNeeded ( BitState bit_state );
+//   void Advance ( U32 num_samples_to_advance );
+//   BitState GetCurrentBitState();
+//   U64 GetCurrentSampleNumber();
+template <class Line>
+class BitbusTrafficWriter
+{
+public:
+	BitbusTrafficWriter ( const BitbusDecoderSettings & settings, const BitbusTrafficProfile & profile,
+	                      U64 samplesPerBit, U64 seed );
+
+	// The gap flags and the next frame
+	const BitbusTrafficFrame & SendFrame ( Line & line );
+	void SendFlag ( Line & line );
+
+protected:
+	void MakeFrame();
+	void SendFrameBytes ( Line & line, const U8* bytes, U32 count );
+	void SendAbort ( Line & line );
+
+	// Bit sync
+	void SendBitSyncByte ( Line & line, U8 byte );
+	void SendNrzBit ( Line & line, U32 bit );
+	// Byte async
+	void SendAsyncByte ( Line & line, U8 byte );
+	void SendAsyncFill ( Line & line, U32 bits );
+
+	const BitbusDecoderSettings & mSettings;
+	BitbusTrafficProfile mProfile;
+	const BitbusWaveformTables & mWaveform;
+	U64 mSamplesPerBit;
+	BitbusRandom mRandom;
+
+	U8 mNextAddress;
+	U32 mConsecutiveOnes;
+	BitbusTrafficFrame mFrame;
+	vector<U8> mFcsBytes;
+};
+
+template <class Line>
+BitbusTrafficWriter<Line>::BitbusTrafficWriter ( const BitbusDecoderSettings & settings, const BitbusTrafficProfile & profile,
+                                                 U64 samplesPerBit, U64 seed )
+	:	mSettings ( settings ), mProfile ( profile ), mWaveform ( BitbusWaveformTables::Get() ),
+	    mSamplesPerBit ( samplesPerBit ), mRandom ( seed ), mNextAddress ( 0 ), mConsecutiveOnes ( 0 )
+{
+}
+
+template <class Line>
+void BitbusTrafficWriter<Line>::MakeFrame()
+{
+	BitbusTrafficFrame & frame = mFrame;
+	frame.mBytes.clear();
+
+	// Address field: SOF then the address, or the address byte after a 0
+	U8 address = mProfile.mAddresses.empty() ? mNextAddress++ : mProfile.mAddresses[ mRandom.Below ( U32 ( mProfile.mAddresses.size() ) ) ];
+	frame.mBytes.push_back ( ( mSettings.mBitbusAddressingMode == BITBUS_ADDRESS_SOF ) ? 0x01 : 0x00 );
+	frame.mBytes.push_back ( address );
+	frame.mAddressBytes = 2;
+
+	U32 infoBytes = mRandom.Between ( mProfile.mInfoBytesMin, mProfile.mInfoBytesMax );
+	for ( U32 i=0; i < infoBytes; ++i )
+	{
+		if ( mRandom.PerMille ( mProfile.mStuffingPerMille ) )
+		{
+			// Worst case: a stuffed 0 every five bits, or every byte escaped
+			const bool bitSync = mSettings.mTransmissionMode != BITBUS_TRANSMISSION_BYTE_ASYNC;
+			frame.mBytes.push_back ( bitSync ? 0xFF : ( ( mRandom.Next() & 1 ) ? BITBUS_FLAG_VALUE : BITBUS_ESCAPE_SEQ_VALUE ) );
+		}
+		else
+		{
+			frame.mBytes.push_back ( U8 ( mRandom.Next() ) );
+		}
+	}
+
+	frame.mFcs = ( mSettings.mFcsType == BITBUS_FCS_CRC32 ) ? BitbusCrc32::Compute ( frame.mBytes.data(), U32 ( frame.mBytes.size() ) )
+	             : BitbusCrc16::Compute ( frame.mBytes.data(), U32 ( frame.mBytes.size() ) );
+	frame.mFcsError = mRandom.PerMille ( mProfile.mFcsErrorPerMille );
+	U32 fcsBytes = BitbusDecoderSettings::FcsBytes ( mSettings.mFcsType );
+	if ( frame.mFcsError )
+	{
+		frame.mFcs ^= 1U << mRandom.Below ( 8 * fcsBytes );
+	}
+	mFcsBytes.clear();
+	for ( U32 i=0; i < fcsBytes; ++i ) // low byte first
+	{
+		mFcsBytes.push_back ( U8 ( frame.mFcs >> ( 8 * i ) ) );
+	}
+
+	// Aborted after the address and part of the information
+	frame.mAborted = mRandom.PerMille ( mProfile.mAbortPerMille );
+	if ( frame.mAborted )
+	{
+		frame.mBytes.resize ( frame.mAddressBytes + mRandom.Below ( infoBytes + 1 ) );
+		frame.mFcsError = false;
+	}
+}
+
+template <class Line>
+const BitbusTrafficFrame & BitbusTrafficWriter<Line>::SendFrame ( Line & line )
+{
+	MakeFrame();
+
+	U32 gapFlags = mRandom.Between ( mProfile.mGapFlagsMin, mProfile.mGapFlagsMax );
+	for ( U32 i=0; i < gapFlags; ++i )
+	{
+		SendFlag ( line );
+	}
+
+	mFrame.mStartSample = line.GetCurrentSampleNumber();
+	SendFlag ( line );
+	SendFrameBytes ( line, mFrame.mBytes.data(), U32 ( mFrame.mBytes.size() ) );
+	if ( mFrame.mAborted )
+	{
+		SendAbort ( line );
+	}
+	else
+	{
+		SendFrameBytes ( line, mFcsBytes.data(), U32 ( mFcsBytes.size() ) );
+		SendFlag ( line );
+	}
+	mFrame.mEndSample = line.GetCurrentSampleNumber();
+	return mFrame;
+}
+
+template <class Line>
+void BitbusTrafficWriter<Line>::SendFlag ( Line & line )
+{
+	switch ( mSettings.mTransmissionMode )
+	{
+	case BITBUS_TRANSMISSION_BIT_SYNC: // 0111 1110, not stuffed
+		line.Transition();
+		line.Advance ( U32 ( 7 * mSamplesPerBit ) );
+		line.Transition();
+		line.Advance ( U32 ( mSamplesPerBit ) );
+		break;
+	case BITBUS_TRANSMISSION_BIT_SYNC_NRZ:
+		for ( U32 i=0; i < 8; ++i )
+		{
+			SendNrzBit ( line, ( BITBUS_FLAG_VALUE >> i ) & 1 );
+		}
+		break;
+	default:
+		SendAsyncByte ( line, BITBUS_FLAG_VALUE );
+		break;
+	}
+	mConsecutiveOnes = 0;
+}
+
+template <class Line>
+void BitbusTrafficWriter<Line>::SendFrameBytes ( Line & line, const U8* bytes, U32 count )
+{
+	for ( U32 i=0; i < count; ++i )
+	{
+		if ( mSettings.mTransmissionMode != BITBUS_TRANSMISSION_BYTE_ASYNC )
+		{
+			SendBitSyncByte ( line, bytes[ i ] );
+			continue;
+		}
+
+		if ( ( bytes[ i ] == BITBUS_FLAG_VALUE ) || ( bytes[ i ] == BITBUS_ESCAPE_SEQ_VALUE ) )
+		{
+			SendAsyncByte ( line, BITBUS_ESCAPE_SEQ_VALUE );
+			SendAsyncByte ( line, BitbusDecoderSettings::Bit5Inv ( bytes[ i ] ) );
+		}
+		else
+		{
+			SendAsyncByte ( line, bytes[ i ] );
+		}
+		// Idle between bytes
+		SendAsyncFill ( line, mRandom.Below ( mProfile.mByteFillMaxBits + 1 ) );
+	}
+}
+
+template <class Line>
+void BitbusTrafficWriter<Line>::SendAbort ( Line & line )
+{
+	if ( mSettings.mTransmissionMode == BITBUS_TRANSMISSION_BYTE_ASYNC )
+	{
+		SendAsyncByte ( line, BITBUS_ESCAPE_SEQ_VALUE );
+		SendAsyncByte ( line, BITBUS_FLAG_VALUE );
+	}
+	else if ( mSettings.mTransmissionMode == BITBUS_TRANSMISSION_BIT_SYNC_NRZ )
+	{
+		for ( U32 i=0; i < 8; ++i )
+		{
+			SendNrzBit ( line, 1 );
+		}
+	}
+	else // eight 1s, not stuffed: no transition
+	{
+		line.Advance ( U32 ( 8 * mSamplesPerBit ) );
+	}
+	mConsecutiveOnes = 0;
+}
+
+template <class Line>
+void BitbusTrafficWriter<Line>::SendBitSyncByte ( Line & line, U8 byte )
+{
+	if ( mSettings.mTransmissionMode == BITBUS_TRANSMISSION_BIT_SYNC )
+	{
+		mConsecutiveOnes = BitbusSendSyncByte ( line, mWaveform, byte, mConsecutiveOnes, mSamplesPerBit );
+		return;
+	}
+
+	// NRZ, bit by bit
+	for ( U32 i=0; i < 8; ++i )
+	{
+		U32 bit = ( byte >> i ) & 1;
+		SendNrzBit ( line, bit );
+		mConsecutiveOnes = bit ? mConsecutiveOnes + 1 : 0;
+		if ( mConsecutiveOnes == 5 ) // five 1s in a row: insert a 0
+		{
+			SendNrzBit ( line, 0 );
+			mConsecutiveOnes = 0;
+		}
+	}
+}
+
+template <class Line>
+void BitbusTrafficWriter<Line>::SendNrzBit ( Line & line, U32 bit )
+{
+	line.TransitionIfNeeded ( bit ? BIT_HIGH : BIT_LOW );
+	line.Advance ( U32 ( mSamplesPerBit ) );
+}
+
+// ISO/IEC 13239:2002(E) page 17
+template <class Line>
+void BitbusTrafficWriter<Line>::SendAsyncByte ( Line & line, U8 byte )
+{
+	// The line must be at the stop level first
+	if ( line.GetCurrentBitState() == BIT_LOW )
+	{
+		line.Transition();
+		line.Advance ( U32 ( mSamplesPerBit ) );
+	}
+	BitbusSendAsyncByte ( line, mWaveform, byte, mSamplesPerBit );
+}
+
+template <class Line>
+void BitbusTrafficWriter<Line>::SendAsyncFill ( Line & line, U32 bits )
+{
+	if ( line.GetCurrentBitState() == BIT_LOW )
+	{
+		line.Transition();
+	}
+	line.Advance ( U32 ( mSamplesPerBit * bits ) );
+}
+
+#endif //BITBUS_TRAFFIC_H
@@ -0,0 +1,124 @@
+#ifndef BITBUS_TYPES
+#define BITBUS_TYPES
+
+// Types shared by the analyzer plugin and the SDK-independent decode core.
+// Nothing here needs the Logic SDK: with BITBUS_STANDALONE defined the SDK
+// base types are declared locally (same definitions as AnalyzerTypes.h).
+
+#ifdef BITBUS_STANDALONE
+typedef char S8;
+typedef short S16;
+typedef int S32;
+typedef long long int S64;
+
+typedef unsigned char U8;
+typedef unsigned short U16;
+typedef unsigned int U32;
+typedef unsigned long long int U64;
+
+enum BitState { BIT_LOW, BIT_HIGH };
+enum DisplayBase { Binary, Decimal, Hexadecimal, ASCII, AsciiHex };
+#else
+#include <AnalyzerTypes.h>
+#endif
+
+/////////////////////////////////////
+
+// NOTE: terminology:
+//    * BITBUS Frame == Saleae Logic Packet
+//    * BITBUS Field == Saleae Logic Frame
+//    * BITBUS transactions not supported
+
+// Inner frames types of BITBUS frame (address, control, data, fcs, etc)
+enum BitbusFieldType {
+    BITBUS_FIELD_FLAG,
+    BITBUS_FIELD_SOH,
+    BITBUS_FIELD_ADDRESS,
+    BITBUS_FIELD_PACKET_TYPE,
+    BITBUS_FIELD_INFORMATION,
+    BITBUS_FIELD_FCS,
+    BITBUS_ABORT_SEQ,
+    BITBUS_FIELD_RESERVED,
+};
+
+//
+enum BitbusAddressingMode {
+    BITBUS_ADDRESS_SOF,
+    BITBUS_ADDRESS_EXTENDED,
+    BITBUS_ADDRESS_ADDR_RESERVED,
+};
+
+// Transmission mode (bit stuffing or byte stuffing)
+enum BitbusTransmissionModeType {
+        BITBUS_TRANSMISSION_BIT_SYNC = 0,
+        BITBUS_TRANSMISSION_BIT_SYNC_NRZ,
+        BITBUS_TRANSMISSION_BYTE_ASYNC
+};
+
+// Frame check sequence width
+enum BitbusFcsType {
+        BITBUS_FCS_CRC16 = 0,
+        BITBUS_FCS_CRC32
+};
+
+// Flag Field Type (Start, End or Fill), in mData1. A bit sync End flag
+// carries the bit rate measured over its frame in mData2 (bit/s).
+enum BitbusFlagType { BITBUS_FLAG_START = 0, BITBUS_FLAG_END = 1, BITBUS_FLAG_FILL = 2 };
+
+// Special values for Byte Asynchronous Transmission
+#define BITBUS_FLAG_VALUE 0x7E
+#define BITBUS_FILL_VALUE 0xFF
+#define BITBUS_ESCAPE_SEQ_VALUE 0x7F
+
+// For Frame::mFlag
+#define BITBUS_ESCAPED_BYTE ( 1 << 0 )
+// For Frame::mFlag: byte async, a stop bit of the field read low
+#define BITBUS_FRAMING_ERROR ( 1 << 1 )
+// For Frame::mFlag, the same bit as the SDK's DISPLAY_AS_ERROR_FLAG
+#define BITBUS_DISPLAY_AS_ERROR ( 1 << 7 )
+
+// A decoded BITBUS field, laid out like the SDK's Frame
+struct BitbusFrame
+{
+	U64 mStartingSampleInclusive;
+	U64 mEndingSampleInclusive;
+	U64 mData1;
+	U64 mData2;
+	U8 mType;
+	U8 mFlags;
+};
+
+// Bit5Inv() and FcsBits() are used by the results and the simulator too
+struct BitbusDecoderSettings
+{
+	BitbusDecoderSettings() :
+		mBitRate ( 62500 ),
+		mTransmissionMode ( BITBUS_TRANSMISSION_BIT_SYNC ),
+		mBitbusAddressingMode ( BITBUS_ADDRESS_SOF ),
+		mFcsType ( BITBUS_FCS_CRC16 )
+	{
+	}
+
+	static U8 Bit5Inv ( U8 value )
+	{
+		return value ^ 0x20;
+	}
+
+	static U32 FcsBytes ( BitbusFcsType fcsType )
+	{
+		return ( fcsType == BITBUS_FCS_CRC32 ) ? 4 : 2;
+	}
+
+	U32 FcsBits() const
+	{
+		return 8 * FcsBytes ( mFcsType );
+	}
+
+	U32 mBitRate;
+
+	BitbusTransmissionModeType mTransmissionMode;
+	BitbusAddressingMode mBitbusAddressingMode;
+	BitbusFcsType mFcsType;
+};
+
+#endif //BITBUS_TYPES
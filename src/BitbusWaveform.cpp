@@ -0,0 +1,73 @@
+#include "BitbusWaveform.h"
+
+const BitbusWaveformTables & BitbusWaveformTables::Get()
+{
+	static const BitbusWaveformTables tables;
+	return tables;
+}
+
+static void AddOneCell ( BitbusSyncByteCells & cells )
+{
+	if ( cells.mZeros == 0 )
+	{
+		cells.mLeadingOnes++;
+	}
+	else
+	{
+		cells.mRuns[ cells.mZeros - 1 ]++;
+	}
+}
+
+static void AddZeroCell ( BitbusSyncByteCells & cells )
+{
+	cells.mRuns[ cells.mZeros++ ] = 1;
+}
+
+BitbusWaveformTables::BitbusWaveformTables()
+{
+	for ( U32 onesBefore=0; onesBefore < 5; ++onesBefore )
+	{
+		for ( U32 byte=0; byte < 256; ++byte )
+		{
+			BitbusSyncByteCells & cells = mSync[ onesBefore ][ byte ];
+			cells.mLeadingOnes = 0;
+			cells.mZeros = 0;
+			U32 ones = onesBefore;
+			for ( U32 i=0; i < 8; ++i ) // LSB first
+			{
+				if ( ( byte >> i ) & 1 )
+				{
+					AddOneCell ( cells );
+					if ( ++ones == 5 ) // five 1s in a row: a 0 is stuffed
+					{
+						AddZeroCell ( cells );
+						ones = 0;
+					}
+				}
+				else
+				{
+					AddZeroCell ( cells );
+					ones = 0;
+				}
+			}
+			cells.mOnesAfter = U8 ( ones );
+		}
+	}
+
+	for ( U32 byte=0; byte < 256; ++byte )
+	{
+		BitbusAsyncByteCells & cells = mAsync[ byte ];
+		cells.mRunCount = 0;
+		U32 level = 2; // none yet
+		for ( U32 i=0; i < 10; ++i )
+		{
+			U32 cell = ( i == 0 ) ? 0 : ( i == 9 ) ? 1 : ( ( byte >> ( i - 1 ) ) & 1 );
+			if ( cell != level )
+			{
+				cells.mRuns[ cells.mRunCount++ ] = 0;
+				level = cell;
+			}
+			cells.mRuns[ cells.mRunCount - 1 ]++;
+		}
+	}
+}
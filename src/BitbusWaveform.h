@@ -0,0 +1,83 @@
+#ifndef BITBUS_WAVEFORM_H
+#define BITBUS_WAVEFORM_H
+
+#include "BitbusTypes.h"
+
+// The line cells of one byte as runs, worked out once for every byte value
+// (and, bit sync, every count of 1s sent before it), so a byte goes out as
+// a few transitions and advances instead of bit by bit.
+
+// Bit sync (NRZI): a 0 cell toggles the line, a 1 cell leaves it. Bit
+// stuffed: a 0 is sent after five 1s in a row.
+struct BitbusSyncByteCells
+{
+	U8 mLeadingOnes; // 1 cells before the first 0 cell
+	U8 mZeros;       // 0 cells, stuffed ones included
+	U8 mOnesAfter;   // 1s in a row at the end (below five)
+	U8 mRuns[ 10 ];  // per 0 cell: it and the 1 cells after it
+};
+
+// Byte async: start bit, 8 data bits LSB first, stop bit
+struct BitbusAsyncByteCells
+{
+	U8 mRunCount;
+	U8 mRuns[ 10 ]; // cells per level, alternating from the low start bit
+};
+
+class BitbusWaveformTables
+{
+public:
+	static const BitbusWaveformTables & Get();
+
+	const BitbusSyncByteCells & SyncByte ( U32 onesBefore, U8 byte ) const
+	{
+		return mSync[ onesBefore ][ byte ];
+	}
+
+	const BitbusAsyncByteCells & AsyncByte ( U8 byte ) const
+	{
+		return mAsync[ byte ];
+	}
+
+protected:
+	BitbusWaveformTables();
+
+	BitbusSyncByteCells mSync[ 5 ][ 256 ];
+	BitbusAsyncByteCells mAsync[ 256 ];
+};
+
+// Line is driven like the SDK's SimulationChannelDescriptor:
+//   void Transition();
+//   void Advance ( U32 num_samples_to_advance );
+
+// Sends byte bit stuffed in NRZI, onesBefore 1s having been sent; returns
+// the 1s it ends with
+template <class Line>
+U32 BitbusSendSyncByte ( Line & line, const BitbusWaveformTables & tables, U8 byte, U32 onesBefore, U64 samplesPerBit )
+{
+	const BitbusSyncByteCells & cells = tables.SyncByte ( onesBefore, byte );
+	if ( cells.mLeadingOnes > 0 )
+	{
+		line.Advance ( U32 ( cells.mLeadingOnes * samplesPerBit ) );
+	}
+	for ( U32 i=0; i < cells.mZeros; ++i )
+	{
+		line.Transition();
+		line.Advance ( U32 ( cells.mRuns[ i ] * samplesPerBit ) );
+	}
+	return cells.mOnesAfter;
+}
+
+// Sends byte as an async character; the line must be high (stop level)
+template <class Line>
+void BitbusSendAsyncByte ( Line & line, const BitbusWaveformTables & tables, U8 byte, U64 samplesPerBit )
+{
+	const BitbusAsyncByteCells & cells = tables.AsyncByte ( byte );
+	for ( U32 i=0; i < cells.mRunCount; ++i )
+	{
+		line.Transition();
+		line.Advance ( U32 ( cells.mRuns[ i ] * samplesPerBit ) );
+	}
+}
+
+#endif //BITBUS_WAVEFORM_H
@@ -0,0 +1,1924 @@
+// Drives the SDK-independent BITBUS decoder with in-memory edge lists.
+// Build with -DBITBUS_STANDALONE_CORE=ON, run with ctest.
+
+#include "BitbusBitRate.h"
+#include "BitbusCaptureReader.h"
+#include "BitbusCrc.h"
+#include "BitbusCsvExport.h"
+#include "BitbusDecoder.h"
+#include "BitbusEdgeChannel.h"
+#include "BitbusFieldText.h"
+#include "BitbusFrameReader.h"
+#include "BitbusFrameRecord.h"
+#include "BitbusLineEncoder.h"
+#include "BitbusPacketIndex.h"
+#include "BitbusPacketText.h"
+#include "BitbusParallelDecoder.h"
+#include "BitbusParallelExport.h"
+#include "BitbusRunLengthCapture.h"
+#include "BitbusStatsExport.h"
+#include "BitbusTextCache.h"
+#include "BitbusTrace.h"
+#include "BitbusTraffic.h"
+#include "BitbusWaveform.h"
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdio.h>
+#include <vector>
+
+using namespace std;
+
+static U32 sFailures = 0;
+
+#define CHECK( condition ) \
+	do { if ( !( condition ) ) { printf ( "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition ); sFailures++; } } while ( 0 )
+
+struct TestSink
+{
+	void AddDecodedFrame ( const BitbusFrame & frame )
+	{
+		mFrames.push_back ( frame );
+	}
+
+	void AddDecodedMarker ( U64 /*sample*/, BitbusMarkerType type )
+	{
+		switch ( type )
+		{
+		case BITBUS_MARKER_FCS_ERROR:
+			mFcsErrorMarkers++;
+			break;
+		case BITBUS_MARKER_FRAMING_ERROR:
+			mFramingErrorMarkers++;
+			break;
+		default:
+			mStuffedBitMarkers++;
+			break;
+		}
+	}
+
+	void BeforeChannelRead()
+	{
+	}
+
+	U32 Count ( U8 type ) const
+	{
+		U32 count = 0;
+		for ( U32 i=0; i < mFrames.size(); ++i )
+		{
+			count += ( mFrames[ i ].mType == type ) ? 1 : 0;
+		}
+		return count;
+	}
+
+	vector<BitbusFrame> mFrames;
+	U32 mStuffedBitMarkers = 0;
+	U32 mFcsErrorMarkers = 0;
+	U32 mFramingErrorMarkers = 0;
+};
+
+typedef BitbusDecoder< BitbusEdgeChannel, TestSink > TestDecoder;
+
+static const U32 kSamplesPerBit = 16;
+static const U32 kSampleRate = 62500 * kSamplesPerBit;
+
+static BitbusDecoderSettings MakeSettings ( BitbusTransmissionModeType mode, BitbusFcsType fcs = BITBUS_FCS_CRC16 )
+{
+	BitbusDecoderSettings settings;
+	settings.mBitRate = 62500;
+	settings.mTransmissionMode = mode;
+	settings.mFcsType = fcs;
+	return settings;
+}
+
+struct NoFrameCallback
+{
+	void operator()() const
+	{
+	}
+};
+
+// Decode to the end of the data, where the channel ends the run by throwing;
+// beforeFrame() is called before each ProcessBITBUSFrame(). Without start,
+// the decoder goes on from where Resume() put it.
+template <class Decoder, class BeforeFrame = NoFrameCallback>
+static void Decode ( Decoder & decoder, BeforeFrame beforeFrame = BeforeFrame(), bool start = true )
+{
+	try
+	{
+		if ( start )
+		{
+			decoder.Start();
+		}
+		for ( ; ; )
+		{
+			beforeFrame();
+			decoder.ProcessBITBUSFrame();
+		}
+	}
+	catch ( BitbusEndOfData & )
+	{
+	}
+}
+
+// Decode the whole line
+static U64 Decode ( const BitbusDecoderSettings & settings, const BitbusLineEncoder & line, TestSink & sink )
+{
+	BitbusEdgeChannel channel ( line.GetInitialState(), line.GetEdges().data(), line.GetEdges().size(), line.GetEndSample() );
+	TestDecoder decoder ( settings, sink );
+	decoder.Setup ( &channel, kSampleRate );
+	Decode ( decoder );
+	return decoder.GetAllocationCount();
+}
+
+static void TestGoodFrames ( BitbusTransmissionModeType mode, BitbusFcsType fcs )
+{
+	BitbusDecoderSettings settings = MakeSettings ( mode, fcs );
+	BitbusLineEncoder line ( settings, kSamplesPerBit );
+
+	// Information bytes that need bit stuffing and byte stuffing
+	const U8 frame[] = { 0x01, 0x42, 0xFF, 0x7E, 0x7F, 0x00, 0x3F, 0xF8 };
+	const U32 frames = 20;
+
+	line.AddIdle ( 16 );
+	line.AddFlags ( 2 );
+	for ( U32 i=0; i < frames; ++i )
+	{
+		line.AddFrame ( frame, sizeof ( frame ) );
+		line.AddFlags ( 1 );
+	}
+	line.AddIdle ( 16 );
+
+	TestSink sink;
+	Decode ( settings, line, sink );
+
+	CHECK ( sink.Count ( BITBUS_FIELD_FCS ) == frames );
+	CHECK ( sink.Count ( BITBUS_FIELD_SOH ) == frames );
+	CHECK ( sink.Count ( BITBUS_FIELD_INFORMATION ) == frames * ( sizeof ( frame ) - 2 ) );
+	CHECK ( sink.Count ( BITBUS_ABORT_SEQ ) == 0 );
+	CHECK ( sink.mFcsErrorMarkers == 0 );
+	CHECK ( sink.mFramingErrorMarkers == 0 );
+
+	U32 info = 0;
+	for ( U32 i=0; i < sink.mFrames.size(); ++i )
+	{
+		const BitbusFrame & f = sink.mFrames[ i ];
+		if ( f.mType == BITBUS_FIELD_FCS )
+		{
+			CHECK ( f.mData1 == f.mData2 );
+			CHECK ( ( f.mFlags & BITBUS_DISPLAY_AS_ERROR ) == 0 );
+			info = 0;
+		}
+		else if ( f.mType == BITBUS_FIELD_INFORMATION )
+		{
+			// Escaped bytes are reported as they appear on the wire
+			U64 value = ( f.mFlags & BITBUS_ESCAPED_BYTE ) ? BitbusDecoderSettings::Bit5Inv ( U8 ( f.mData1 ) ) : f.mData1;
+			CHECK ( value == frame[ 2 + info ] );
+			CHECK ( f.mData2 == info );
+			info++;
+		}
+		CHECK ( f.mStartingSampleInclusive <= f.mEndingSampleInclusive );
+	}
+
+	if ( mode != BITBUS_TRANSMISSION_BYTE_ASYNC )
+	{
+		CHECK ( sink.mStuffedBitMarkers >= frames );
+	}
+}
+
+static void TestFcsError ( BitbusTransmissionModeType mode )
+{
+	BitbusDecoderSettings settings = MakeSettings ( mode );
+	BitbusLineEncoder line ( settings, kSamplesPerBit );
+
+	const U8 frame[] = { 0x01, 0x10, 0x20, 0x30 };
+	line.AddIdle ( 16 );
+	line.AddFlags ( 2 );
+	line.AddFrame ( frame, sizeof ( frame ) );
+	line.AddFrame ( frame, sizeof ( frame ), true );
+	line.AddFrame ( frame, sizeof ( frame ) );
+	line.AddFlags ( 2 );
+	line.AddIdle ( 16 );
+
+	TestSink sink;
+	Decode ( settings, line, sink );
+
+	CHECK ( sink.Count ( BITBUS_FIELD_FCS ) == 3 );
+	CHECK ( sink.mFcsErrorMarkers == 1 );
+}
+
+static void TestAbort ( BitbusTransmissionModeType mode )
+{
+	BitbusDecoderSettings settings = MakeSettings ( mode );
+	BitbusLineEncoder line ( settings, kSamplesPerBit );
+
+	const U8 frame[] = { 0x01, 0x10, 0x20, 0x30, 0x40 };
+	line.AddIdle ( 16 );
+	line.AddFlags ( 2 );
+	line.AddFrame ( frame, sizeof ( frame ) );
+	line.AddFlags ( 1 );
+	line.AddAbortedFrame ( frame, 4 );
+	line.AddIdle ( 16 );
+	line.AddFlags ( 2 );
+	line.AddFrame ( frame, sizeof ( frame ) );
+	line.AddFlags ( 2 );
+	line.AddIdle ( 16 );
+
+	TestSink sink;
+	Decode ( settings, line, sink );
+
+	CHECK ( sink.Count ( BITBUS_ABORT_SEQ ) == 1 );
+	CHECK ( sink.Count ( BITBUS_FIELD_FCS ) == 2 );
+	CHECK ( sink.mFcsErrorMarkers == 0 );
+}
+
+// One packet per ProcessBITBUSFrame(), as the analyzer commits them
+struct PacketTextOut
+{
+	void AddTabularText ( const char* str )
+	{
+		mText = str;
+	}
+
+	string mText;
+};
+
+static void TestPacketText()
+{
+	BitbusDecoderSettings settings = MakeSettings ( BITBUS_TRANSMISSION_BIT_SYNC );
+	BitbusLineEncoder line ( settings, kSamplesPerBit );
+
+	const U8 frame[] = { 0x01, 0x10, 0x20, 0x30, 0x40 };
+	line.AddIdle ( 16 );
+	line.AddFlags ( 2 );
+	line.AddFrame ( frame, sizeof ( frame ) );
+	line.AddFlags ( 1 );
+	line.AddFrame ( frame, sizeof ( frame ), true );
+	line.AddFlags ( 1 );
+	line.AddAbortedFrame ( frame, 4 );
+	line.AddIdle ( 16 );
+
+	BitbusEdgeChannel channel ( line.GetInitialState(), line.GetEdges().data(), line.GetEdges().size(), line.GetEndSample() );
+	TestSink sink;
+	TestDecoder decoder ( settings, sink );
+	decoder.Setup ( &channel, kSampleRate );
+
+	BitbusPacketText<PacketTextOut> packetText ( settings, &BitbusGetNumberString );
+	vector<string> packets;
+	U64 first = 0;
+	auto commitPacket = [&]()
+	{
+		BitbusPacketSummary packet;
+		for ( U64 i=first; i < sink.mFrames.size(); ++i )
+		{
+			packet.Add ( sink.mFrames[ i ] );
+		}
+		if ( first < sink.mFrames.size() )
+		{
+			PacketTextOut out;
+			packetText.Generate ( out, packet, Hexadecimal );
+			packets.push_back ( out.mText );
+		}
+		first = sink.mFrames.size();
+	};
+	// Each frame's fields are a packet, as the analyzer commits them
+	Decode ( decoder, commitPacket );
+	commitPacket();
+
+	CHECK ( packets.size() == 3 );
+	if ( packets.size() == 3 )
+	{
+		CHECK ( packets[ 0 ] == "Address 0x0110, 3 bytes, FCS CRC16 OK" );
+		CHECK ( packets[ 1 ] == "Address 0x0110, 3 bytes, !FCS CRC16 ERROR" );
+		CHECK ( packets[ 2 ].find ( "ABORTED" ) != string::npos );
+	}
+}
+
+// Bubble and tabular strings, each joined from its pieces
+struct FieldTextOut
+{
+	void AddResultString ( const char* str1, const char* str2 = 0, const char* str3 = 0,
+	                       const char* str4 = 0, const char* str5 = 0, const char* str6 = 0 )
+	{
+		const char* pieces[] = { str1, str2, str3, str4, str5, str6 };
+		string text;
+		for ( U32 i=0; i < 6; ++i )
+		{
+			if ( pieces[ i ] != 0 )
+			{
+				text += pieces[ i ];
+			}
+		}
+		mStrings.push_back ( text );
+	}
+
+	void AddTabularText ( const char* str1, const char* str2 = 0, const char* str3 = 0,
+	                      const char* str4 = 0, const char* str5 = 0, const char* str6 = 0 )
+	{
+		AddResultString ( "T:", str1, str2, str3, str4, str5 );
+		mStrings.back() += ( str6 != 0 ) ? str6 : "";
+	}
+
+	vector<string> mStrings;
+};
+
+static void TestFieldText()
+{
+	BitbusDecoderSettings settings = MakeSettings ( BITBUS_TRANSMISSION_BYTE_ASYNC );
+	const BitbusFrame fields[] =
+	{
+		{ 0, 7, BITBUS_FLAG_START, 0, BITBUS_FIELD_FLAG, 0 },
+		{ 8, 15, 0x5E, 0, BITBUS_FIELD_ADDRESS, BITBUS_ESCAPED_BYTE },
+		{ 16, 23, 200, 12, BITBUS_FIELD_INFORMATION, 0 },
+		{ 24, 39, 0x1234, 0xBEEF, BITBUS_FIELD_FCS, BITBUS_DISPLAY_AS_ERROR },
+	};
+
+	BitbusFieldText<FieldTextOut> text ( settings, &BitbusGetNumberString );
+	FieldTextOut out;
+	text.Generate ( out, fields[ 1 ], Hexadecimal, true );
+	text.Generate ( out, fields[ 2 ], Hexadecimal, true );
+	text.Generate ( out, fields[ 3 ], Hexadecimal, true );
+	CHECK ( out.mStrings.size() == 3 );
+	if ( out.mStrings.size() == 3 )
+	{
+		CHECK ( out.mStrings[ 0 ] == "T:Address 94 [0x5E] - ESCAPED: 0x7D-0x5E=0x7E" );
+		CHECK ( out.mStrings[ 1 ] == "T:Info 12 (200 [0xC8])" );
+		CHECK ( out.mStrings[ 2 ] == "T:!FCS CRC16 ERROR - CALC CRC[0xBEEF] != READ CRC[0x1234]" );
+	}
+
+	// Kept strings come back as generated, for the same field, base and kind only
+	BitbusFieldText< BitbusTextCache<FieldTextOut> > cachedText ( settings, &BitbusGetNumberString );
+	BitbusTextCache<FieldTextOut> cache;
+	const DisplayBase bases[] = { Hexadecimal, Decimal, Binary, ASCII };
+	for ( U32 b=0; b < 4; ++b )
+	{
+		for ( U32 i=0; i < 4; ++i )
+		{
+			for ( U32 tabular=0; tabular < 2; ++tabular )
+			{
+				FieldTextOut generated;
+				text.Generate ( generated, fields[ i ], bases[ b ], tabular != 0 );
+
+				for ( U32 pass=0; pass < 2; ++pass )
+				{
+					FieldTextOut cached;
+					if ( !cache.Replay ( cached, i, bases[ b ], tabular != 0 ) )
+					{
+						cache.StartEntry ( cached, i, bases[ b ], tabular != 0 );
+						cachedText.Generate ( cache, fields[ i ], bases[ b ], tabular != 0 );
+					}
+					CHECK ( cached.mStrings == generated.mStrings );
+				}
+			}
+		}
+	}
+	// Generated the first time, replayed the second
+	CHECK ( cache.GetMisses() == 4 * 4 * 2 );
+	CHECK ( cache.GetHits() == 4 * 4 * 2 );
+
+	FieldTextOut replayed;
+	CHECK ( cache.Replay ( replayed, 3, ASCII, true ) );
+	CHECK ( !cache.Replay ( replayed, 3 + BITBUS_TEXT_CACHE_ENTRIES, ASCII, true ) );
+}
+
+// The line as the SDK's SimulationChannelDescriptor records it
+// Byte async: a stop bit pulled low is a framing error on its field, the
+// byte and the frame around it decode as before
+static void TestFramingError()
+{
+	BitbusDecoderSettings settings = MakeSettings ( BITBUS_TRANSMISSION_BYTE_ASYNC );
+	BitbusLineEncoder line ( settings, kSamplesPerBit );
+
+	const U8 frame[] = { 0x01, 0x10, 0x20, 0x30 };
+	line.AddIdle ( 16 );
+	line.AddFlags ( 2 );
+	line.AddFrame ( frame, sizeof ( frame ) );
+	line.AddFlags ( 2 );
+	line.AddIdle ( 16 );
+
+	TestSink clean;
+	Decode ( settings, line, clean );
+
+	// A low pulse in the middle of the first information byte's stop bit,
+	// which starts where the byte ends
+	U64 stopBit = 0;
+	for ( U32 i=0; ( stopBit == 0 ) && ( i < clean.mFrames.size() ); ++i )
+	{
+		stopBit = ( clean.mFrames[ i ].mType == BITBUS_FIELD_INFORMATION ) ? clean.mFrames[ i ].mEndingSampleInclusive : 0;
+	}
+	vector<U64> edges = line.GetEdges();
+	edges.insert ( upper_bound ( edges.begin(), edges.end(), stopBit ), { stopBit + kSamplesPerBit / 4, stopBit + 3 * kSamplesPerBit / 4 } );
+
+	BitbusEdgeChannel channel ( line.GetInitialState(), edges.data(), edges.size(), line.GetEndSample() );
+	TestSink sink;
+	TestDecoder decoder ( settings, sink );
+	decoder.Setup ( &channel, kSampleRate );
+	Decode ( decoder );
+
+	CHECK ( sink.mFramingErrorMarkers == 1 );
+	CHECK ( sink.mFcsErrorMarkers == 0 );
+	CHECK ( sink.mFrames.size() == clean.mFrames.size() );
+	for ( U32 i=0; ( i < sink.mFrames.size() ) && ( i < clean.mFrames.size() ); ++i )
+	{
+		const BitbusFrame & f = sink.mFrames[ i ];
+		const bool damaged = ( f.mEndingSampleInclusive == stopBit );
+		CHECK ( f.mType == clean.mFrames[ i ].mType );
+		CHECK ( f.mData1 == clean.mFrames[ i ].mData1 );
+		CHECK ( ( ( f.mFlags & BITBUS_FRAMING_ERROR ) != 0 ) == damaged );
+		if ( damaged )
+		{
+			BitbusFieldText<FieldTextOut> text ( settings, &BitbusGetNumberString );
+			FieldTextOut out;
+			text.Generate ( out, f, Hexadecimal, true );
+			CHECK ( out.mStrings.size() == 1 );
+			CHECK ( ( out.mStrings.size() == 1 ) && ( out.mStrings[ 0 ] == "T:Info 0 (32 [0x20]) - FRAMING ERROR" ) );
+		}
+	}
+}
+
+struct EdgeLine
+{
+	EdgeLine() : mSample ( 0 ) {}
+
+	void Transition()
+	{
+		mEdges.push_back ( mSample );
+	}
+
+	void TransitionIfNeeded ( BitState state )
+	{
+		if ( state != GetCurrentBitState() )
+		{
+			Transition();
+		}
+	}
+
+	void Advance ( U32 samples )
+	{
+		mSample += samples;
+	}
+
+	// Starts low, as the simulation does
+	BitState GetCurrentBitState() const
+	{
+		return ( mEdges.size() & 1 ) ? BIT_HIGH : BIT_LOW;
+	}
+
+	U64 GetCurrentSampleNumber() const
+	{
+		return mSample;
+	}
+
+	U64 mSample;
+	vector<U64> mEdges;
+};
+
+// Bytes sent from the tables make the line the encoder makes bit by bit
+static void TestWaveformTables()
+{
+	const BitbusWaveformTables & tables = BitbusWaveformTables::Get();
+	vector<U8> bytes;
+	for ( U32 i=0; i < 256; ++i )
+	{
+		bytes.push_back ( U8 ( i ) );
+		bytes.push_back ( U8 ( ( i % 3 ) ? 0xFF : 0x7E ) ); // long runs of 1s across bytes
+	}
+
+	BitbusDecoderSettings settings = MakeSettings ( BITBUS_TRANSMISSION_BIT_SYNC );
+	BitbusLineEncoder line ( settings, kSamplesPerBit );
+	line.AddFrame ( bytes.data(), U32 ( bytes.size() ) );
+
+	vector<U8> framed = bytes;
+	U16 fcs = BitbusCrc16::Compute ( bytes.data(), U32 ( bytes.size() ) );
+	framed.push_back ( U8 ( fcs ) );
+	framed.push_back ( U8 ( fcs >> 8 ) );
+
+	EdgeLine sent;
+	for ( U32 flag=0; flag < 2; ++flag )
+	{
+		U32 ones = 0;
+		for ( U32 i=0; ( flag == 1 ) && ( i < framed.size() ); ++i )
+		{
+			ones = BitbusSendSyncByte ( sent, tables, framed[ i ], ones, kSamplesPerBit );
+		}
+		sent.Transition(); // 0111 1110, not stuffed
+		sent.Advance ( 7 * kSamplesPerBit );
+		sent.Transition();
+		sent.Advance ( kSamplesPerBit );
+	}
+	CHECK ( sent.mEdges == line.GetEdges() );
+	CHECK ( sent.mSample == line.GetEndSample() );
+
+	// Byte async: characters from the stop level, flags and escapes included
+	settings = MakeSettings ( BITBUS_TRANSMISSION_BYTE_ASYNC );
+	BitbusLineEncoder asyncLine ( settings, kSamplesPerBit );
+	asyncLine.AddFrame ( bytes.data(), U32 ( bytes.size() ) );
+
+	vector<U8> characters ( 1, BITBUS_FLAG_VALUE );
+	for ( U32 i=0; i < framed.size(); ++i )
+	{
+		if ( ( framed[ i ] == BITBUS_FLAG_VALUE ) || ( framed[ i ] == BITBUS_ESCAPE_SEQ_VALUE ) )
+		{
+			characters.push_back ( BITBUS_ESCAPE_SEQ_VALUE );
+			characters.push_back ( BitbusDecoderSettings::Bit5Inv ( framed[ i ] ) );
+		}
+		else
+		{
+			characters.push_back ( framed[ i ] );
+		}
+	}
+	characters.push_back ( BITBUS_FLAG_VALUE );
+
+	EdgeLine asyncSent;
+	for ( U32 i=0; i < characters.size(); ++i )
+	{
+		BitbusSendAsyncByte ( asyncSent, tables, characters[ i ], kSamplesPerBit );
+	}
+	CHECK ( asyncSent.mEdges == asyncLine.GetEdges() );
+	CHECK ( asyncSent.mSample == asyncLine.GetEndSample() );
+}
+
+// Simulated traffic decodes to the frames the writer says it sent
+// Sends frames of traffic, the line starting and ending idle
+static vector<BitbusTrafficFrame> SendTraffic ( const BitbusDecoderSettings & settings, BitbusTrafficType type, U32 samplesPerBit,
+                                                U32 frames, EdgeLine & line )
+{
+	BitbusTrafficWriter<EdgeLine> writer ( settings, BitbusTrafficProfile::Get ( type ), samplesPerBit, 5 );
+	line.Advance ( 16 * samplesPerBit );
+	vector<BitbusTrafficFrame> sent;
+	for ( U32 i=0; i < frames; ++i )
+	{
+		sent.push_back ( writer.SendFrame ( line ) );
+		CHECK ( sent.back().mStartSample < sent.back().mEndSample );
+	}
+	writer.SendFlag ( line );
+	writer.SendFlag ( line );
+	line.Advance ( 16 * samplesPerBit );
+	return sent;
+}
+
+static void Decode ( const BitbusDecoderSettings & settings, const EdgeLine & line, U32 sampleRate, TestSink & sink )
+{
+	BitbusEdgeChannel channel ( BIT_LOW, line.mEdges.data(), line.mEdges.size(), line.mSample );
+	TestDecoder decoder ( settings, sink );
+	decoder.Setup ( &channel, sampleRate );
+	Decode ( decoder );
+}
+
+// The decoded fields are the frames sent, in order
+static void CheckTraffic ( BitbusTransmissionModeType mode, BitbusTrafficType type, const vector<BitbusTrafficFrame> & sent,
+                           const TestSink & sink )
+{
+	U32 frame = 0;
+	U32 aborted = 0;
+	U32 fcsErrors = 0;
+	vector<U8> info;
+	for ( U32 i=0; ( i < sink.mFrames.size() ) && ( frame < sent.size() ); ++i )
+	{
+		const BitbusFrame & f = sink.mFrames[ i ];
+		const BitbusTrafficFrame & expected = sent[ frame ];
+		if ( f.mType == BITBUS_FIELD_ADDRESS )
+		{
+			// The address is shown as it is on the line, escaped or not
+			U8 address = expected.mBytes[ 1 ];
+			if ( ( mode == BITBUS_TRANSMISSION_BYTE_ASYNC ) && ( ( address == BITBUS_FLAG_VALUE ) || ( address == BITBUS_ESCAPE_SEQ_VALUE ) ) )
+			{
+				address = BitbusDecoderSettings::Bit5Inv ( address );
+			}
+			CHECK ( f.mData1 == ( ( U64 ( expected.mBytes[ 0 ] ) << 8 ) | address ) ); // SOF and address
+		}
+		else if ( f.mType == BITBUS_FIELD_INFORMATION )
+		{
+			info.push_back ( ( f.mFlags & BITBUS_ESCAPED_BYTE ) ? BitbusDecoderSettings::Bit5Inv ( U8 ( f.mData1 ) ) : U8 ( f.mData1 ) );
+		}
+		else if ( f.mType == BITBUS_FIELD_FCS )
+		{
+			CHECK ( !expected.mAborted );
+			CHECK ( info == vector<U8> ( expected.mBytes.begin() + expected.mAddressBytes, expected.mBytes.end() ) );
+			CHECK ( ( f.mData1 != f.mData2 ) == expected.mFcsError );
+			fcsErrors += expected.mFcsError ? 1 : 0;
+			info.clear();
+			frame++;
+		}
+		else if ( f.mType == BITBUS_ABORT_SEQ )
+		{
+			CHECK ( expected.mAborted );
+			aborted++;
+			info.clear();
+			frame++;
+		}
+	}
+	CHECK ( frame == sent.size() );
+	CHECK ( sink.Count ( BITBUS_ABORT_SEQ ) == aborted );
+	CHECK ( sink.mFcsErrorMarkers == fcsErrors );
+	if ( type == BITBUS_TRAFFIC_FAULTS )
+	{
+		CHECK ( ( aborted > 0 ) && ( fcsErrors > 0 ) );
+	}
+}
+
+static void TestTraffic ( BitbusTransmissionModeType mode, BitbusTrafficType type, BitbusFcsType fcs )
+{
+	BitbusDecoderSettings settings = MakeSettings ( mode, fcs );
+	EdgeLine line;
+	vector<BitbusTrafficFrame> sent = SendTraffic ( settings, type, kSamplesPerBit, 200, line );
+
+	TestSink sink;
+	Decode ( settings, line, kSampleRate, sink );
+	CheckTraffic ( mode, type, sent, sink );
+}
+
+// Traffic sent at 20 samples per bit is sampled at samplesPerBit/20 of that
+// by scaling its edges, and decoded at a sample rate of nominalPerBit
+// samples per bit; bit sync End flags carry the rate of the line
+static void TestBitClock ( BitbusTransmissionModeType mode, double samplesPerBit, double nominalPerBit )
+{
+	BitbusDecoderSettings settings = MakeSettings ( mode );
+	EdgeLine sentLine;
+	vector<BitbusTrafficFrame> sent = SendTraffic ( settings, BITBUS_TRAFFIC_MIXED, 20, 100, sentLine );
+
+	EdgeLine line;
+	for ( U32 i=0; i < sentLine.mEdges.size(); ++i )
+	{
+		line.mEdges.push_back ( U64 ( sentLine.mEdges[ i ] * samplesPerBit / 20 ) );
+	}
+	line.mSample = U64 ( sentLine.mSample * samplesPerBit / 20 );
+
+	const U32 sampleRate = U32 ( settings.mBitRate * nominalPerBit );
+	TestSink sink;
+	Decode ( settings, line, sampleRate, sink );
+	CheckTraffic ( mode, BITBUS_TRAFFIC_MIXED, sent, sink );
+
+	const double lineBitRate = sampleRate / samplesPerBit;
+	U32 endFlags = 0;
+	for ( U32 i=0; i < sink.mFrames.size(); ++i )
+	{
+		const BitbusFrame & f = sink.mFrames[ i ];
+		if ( ( f.mType == BITBUS_FIELD_FLAG ) && ( f.mData1 == BITBUS_FLAG_END ) )
+		{
+			if ( mode == BITBUS_TRANSMISSION_BYTE_ASYNC )
+			{
+				CHECK ( f.mData2 == 0 );
+			}
+			else
+			{
+				CHECK ( ( f.mData2 > lineBitRate * 0.99 ) && ( f.mData2 < lineBitRate * 1.01 ) );
+			}
+			endFlags++;
+		}
+	}
+	CHECK ( endFlags == sent.size() );
+}
+
+// Bit sync traffic whose clock drifts within each frame, from 5% slow at
+// its opening flag to 10% fast at its end (8 samples a bit nominal): the
+// bit clock follows it, where a mean of the frame so far falls behind
+static void TestBitClockDrift ( BitbusTransmissionModeType mode )
+{
+	BitbusDecoderSettings settings = MakeSettings ( mode );
+	EdgeLine sentLine;
+	vector<BitbusTrafficFrame> sent = SendTraffic ( settings, BITBUS_TRAFFIC_STUFFING, 20, 20, sentLine );
+
+	const double slow = 1.05;
+	const double fast = 0.90;
+	const double samplesPerBit = 8;
+	EdgeLine line;
+	double stretch = 0; // sent samples added by the frames before
+	U32 frame = 0;
+	for ( U32 i=0; i < sentLine.mEdges.size(); ++i )
+	{
+		const double edge = double ( sentLine.mEdges[ i ] );
+		while ( ( frame < sent.size() ) && ( sent[ frame ].mEndSample <= edge ) )
+		{
+			stretch += ( slow + fast - 2 ) / 2 * double ( sent[ frame ].mEndSample - sent[ frame ].mStartSample );
+			frame++;
+		}
+		double at = edge + stretch;
+		if ( ( frame < sent.size() ) && ( edge > sent[ frame ].mStartSample ) )
+		{
+			const double into = edge - sent[ frame ].mStartSample;
+			const double length = double ( sent[ frame ].mEndSample - sent[ frame ].mStartSample );
+			at += ( slow - 1 ) * into + ( fast - slow ) * into * into / ( 2 * length );
+		}
+		line.mEdges.push_back ( U64 ( at * samplesPerBit / 20 ) );
+	}
+	line.mSample = line.mEdges.back() + 16 * U64 ( samplesPerBit );
+
+	TestSink sink;
+	Decode ( settings, line, U32 ( settings.mBitRate * samplesPerBit ), sink );
+	CheckTraffic ( mode, BITBUS_TRAFFIC_STUFFING, sent, sink );
+	CHECK ( sink.mFcsErrorMarkers == 0 );
+}
+
+// The bit rate comes out of the first edges of traffic at any oversampling,
+// glitches or not
+static void TestBitRateDetection ( BitbusTransmissionModeType mode, double samplesPerBit )
+{
+	BitbusDecoderSettings settings = MakeSettings ( mode );
+	EdgeLine sentLine;
+	SendTraffic ( settings, BITBUS_TRAFFIC_MIXED, 20, 100, sentLine );
+
+	const U32 sampleRate = 25000000;
+	const double bitRate = sampleRate / samplesPerBit;
+	BitbusBitRateDetector detector ( sampleRate );
+	for ( U32 i=0; ( i < sentLine.mEdges.size() ) && ( i < BITBUS_AUTOBAUD_MAX_EDGES ); ++i )
+	{
+		U64 edge = U64 ( sentLine.mEdges[ i ] * samplesPerBit / 20 );
+		detector.AddEdge ( edge );
+		if ( i % 300 == 150 ) // a one-sample glitch
+		{
+			detector.AddEdge ( edge + 1 );
+			detector.AddEdge ( edge + 2 );
+		}
+	}
+	U32 detected = detector.GetBitRate();
+	CHECK ( ( detected > bitRate * 0.995 ) && ( detected < bitRate * 1.005 ) );
+
+	// A few edges do not tell
+	BitbusBitRateDetector few ( sampleRate );
+	for ( U32 i=0; i < 8; ++i )
+	{
+		few.AddEdge ( sentLine.mEdges[ i ] );
+	}
+	CHECK ( few.GetBitRate() == 0 );
+}
+
+// A rate given to Setup() (the one detected) is decoded at, whatever the
+// settings say
+static void TestSetupBitRate ( BitbusTransmissionModeType mode )
+{
+	BitbusDecoderSettings settings = MakeSettings ( mode );
+	BitbusLineEncoder line ( settings, kSamplesPerBit );
+	const U8 frame[] = { 0x01, 0x42, 0x7E, 0x00 };
+	line.AddIdle ( 16 );
+	line.AddFlags ( 2 );
+	for ( U32 i=0; i < 10; ++i )
+	{
+		line.AddFrame ( frame, sizeof ( frame ) );
+		line.AddFlags ( 1 );
+	}
+	line.AddIdle ( 16 );
+
+	BitbusDecoderSettings wrongRate = settings;
+	wrongRate.mBitRate = settings.mBitRate * 3 / 2;
+	TestSink sink;
+	BitbusEdgeChannel channel ( line.GetInitialState(), line.GetEdges().data(), line.GetEdges().size(), line.GetEndSample() );
+	TestDecoder decoder ( wrongRate, sink );
+	decoder.Setup ( &channel, kSampleRate, settings.mBitRate );
+	Decode ( decoder );
+
+	CHECK ( sink.Count ( BITBUS_FIELD_FCS ) == 10 );
+	CHECK ( sink.mFcsErrorMarkers == 0 );
+	CHECK ( decoder.GetSamplesPerBit() == kSamplesPerBit );
+	CHECK ( decoder.GetStats().mBitRate == settings.mBitRate );
+}
+
+// Reads the channel ahead in blocks as the decoder uses the edges up, the
+// way BitbusAnalyzer does
+struct ReadAheadSink : public TestSink
+{
+	void BeforeChannelRead()
+	{
+		if ( !mChannel->ReadAhead ( mBlock ) )
+		{
+			mWaits++;
+		}
+	}
+
+	BitbusReadAheadChannel<BitbusEdgeChannel>* mChannel;
+	U32 mBlock;
+	U32 mWaits;
+};
+
+// Decoding through a read ahead channel gives what decoding the channel
+// itself does, however far it was read ahead
+static void TestReadAheadChannel ( BitbusTransmissionModeType mode )
+{
+	BitbusDecoderSettings settings = MakeSettings ( mode );
+	EdgeLine line;
+	SendTraffic ( settings, BITBUS_TRAFFIC_FAULTS, kSamplesPerBit, 50, line );
+
+	TestSink expected;
+	Decode ( settings, line, kSampleRate, expected );
+
+	const U32 readAhead[] = { 0, 1, 37, 4096, 1000000 };
+	for ( U32 r=0; r < 5; ++r )
+	{
+		BitbusEdgeChannel channel ( BIT_LOW, line.mEdges.data(), line.mEdges.size(), line.mSample );
+		BitbusReadAheadChannel<BitbusEdgeChannel> readAheadChannel;
+		readAheadChannel.Setup ( &channel, readAhead[ r ] );
+		CHECK ( readAheadChannel.GetReadAheadEdges().size() == min<U64> ( readAhead[ r ], line.mEdges.size() ) );
+
+		ReadAheadSink sink;
+		sink.mChannel = &readAheadChannel;
+		sink.mBlock = readAhead[ r ];
+		sink.mWaits = 0;
+		BitbusDecoder< BitbusReadAheadChannel<BitbusEdgeChannel>, ReadAheadSink > decoder ( settings, sink );
+		decoder.Setup ( &readAheadChannel, kSampleRate );
+		Decode ( decoder );
+
+		CHECK ( sink.mFrames.size() == expected.mFrames.size() );
+		bool same = ( sink.mFrames.size() == expected.mFrames.size() );
+		for ( U32 i=0; same && ( i < sink.mFrames.size() ); ++i )
+		{
+			const BitbusFrame & a = sink.mFrames[ i ];
+			const BitbusFrame & b = expected.mFrames[ i ];
+			same = ( a.mStartingSampleInclusive == b.mStartingSampleInclusive ) && ( a.mEndingSampleInclusive == b.mEndingSampleInclusive ) &&
+			       ( a.mData1 == b.mData1 ) && ( a.mData2 == b.mData2 ) && ( a.mType == b.mType ) && ( a.mFlags == b.mFlags );
+		}
+		CHECK ( same );
+		// Only the reads past the last edge of the data may wait
+		CHECK ( ( readAhead[ r ] == 0 ) || ( sink.mWaits <= 2 ) );
+	}
+}
+
+// Traffic written as a binary export reads back edge for edge
+static void TestSaleaeBinaryWriter()
+{
+	BitbusDecoderSettings settings = MakeSettings ( BITBUS_TRANSMISSION_BIT_SYNC );
+	BitbusTrafficWriter<EdgeLine> traffic ( settings, BitbusTrafficProfile::Get ( BITBUS_TRAFFIC_MIXED ), kSamplesPerBit, 1 );
+	EdgeLine line;
+	line.Advance ( 16 * kSamplesPerBit );
+	for ( U32 i=0; i < 100; ++i )
+	{
+		traffic.SendFrame ( line );
+	}
+	const U64 endSample = line.mSample + 16 * kSamplesPerBit;
+
+	const char* path = "BitbusDecoderTest.bin";
+	BitbusSaleaeBinaryWriter writer;
+	string error;
+	CHECK ( writer.Create ( path, kSampleRate, BIT_LOW, error ) );
+	for ( U32 i=0; i < line.mEdges.size(); ++i )
+	{
+		CHECK ( writer.AddEdge ( line.mEdges[ i ] ) );
+	}
+	CHECK ( !writer.AddEdge ( line.mEdges.back() ) );
+	CHECK ( writer.GetSize() == 44 + 8 * line.mEdges.size() );
+	CHECK ( writer.Close ( endSample ) );
+
+	CHECK ( BitbusSaleaeBinaryReader::IsSaleaeBinary ( path ) );
+	BitbusSaleaeBinaryReader capture;
+	CHECK ( capture.Open ( path, kSampleRate, error ) );
+	CHECK ( capture.GetInitialState() == BIT_LOW );
+	CHECK ( capture.GetEndSample() == endSample );
+	U64 edge;
+	U32 count = 0;
+	while ( capture.NextEdge ( edge ) )
+	{
+		CHECK ( ( count < line.mEdges.size() ) && ( edge == line.mEdges[ count ] ) );
+		count++;
+	}
+	CHECK ( count == line.mEdges.size() );
+	remove ( path );
+}
+
+static void TestAllocationsFlat()
+{
+	BitbusDecoderSettings settings = MakeSettings ( BITBUS_TRANSMISSION_BIT_SYNC );
+	const U8 frame[] = { 0x01, 0x10, 0x20, 0x30, 0x40, 0x50, 0x60 };
+
+	U64 allocations[ 2 ];
+	const U32 frames[ 2 ] = { 10, 1000 };
+	for ( U32 run=0; run < 2; ++run )
+	{
+		BitbusLineEncoder line ( settings, kSamplesPerBit );
+		line.AddFlags ( 2 );
+		for ( U32 i=0; i < frames[ run ]; ++i )
+		{
+			line.AddFrame ( frame, sizeof ( frame ) );
+		}
+		line.AddFlags ( 2 );
+
+		TestSink sink;
+		allocations[ run ] = Decode ( settings, line, sink );
+		CHECK ( sink.Count ( BITBUS_FIELD_FCS ) == frames[ run ] );
+	}
+	CHECK ( allocations[ 0 ] == allocations[ 1 ] );
+}
+
+// Short noise intervals ahead of the frames: the decoder hunts through
+// them for a flag and still finds every frame after
+static void TestFlagHunt ( BitbusTransmissionModeType mode )
+{
+	BitbusDecoderSettings settings = MakeSettings ( mode );
+	BitbusLineEncoder line ( settings, kSamplesPerBit );
+
+	const U8 frame[] = { 0x01, 0x10, 0x20, 0x30, 0x40 };
+	const U32 frames = 5;
+	line.AddIdle ( 16 );
+	line.AddFlags ( 2 );
+	for ( U32 i=0; i < frames; ++i )
+	{
+		line.AddFrame ( frame, sizeof ( frame ) );
+		line.AddFlags ( 1 );
+	}
+	line.AddIdle ( 16 );
+
+	// Noise of 1 to 5 bit intervals, an even count to end at the line's level
+	vector<U64> edges;
+	U32 random = 1;
+	U64 sample = 0;
+	for ( U32 i=0; i < 200; ++i )
+	{
+		random = random * 1103515245 + 12345;
+		sample += ( 1 + ( random >> 16 ) % 5 ) * kSamplesPerBit;
+		edges.push_back ( sample );
+	}
+	sample += 16 * kSamplesPerBit;
+	for ( U32 i=0; i < line.GetEdges().size(); ++i )
+	{
+		edges.push_back ( sample + line.GetEdges()[ i ] );
+	}
+
+	BitbusEdgeChannel channel ( line.GetInitialState(), edges.data(), edges.size(), sample + line.GetEndSample() );
+	TestSink sink;
+	TestDecoder decoder ( settings, sink );
+	decoder.Setup ( &channel, kSampleRate );
+	Decode ( decoder );
+
+	CHECK ( sink.Count ( BITBUS_FIELD_FCS ) == frames );
+	CHECK ( sink.mFcsErrorMarkers == 0 );
+	CHECK ( decoder.GetHuntStats().mHunts > 0 );
+	CHECK ( decoder.GetHuntStats().mEdgesSkipped > 100 );
+}
+
+// The export's own hex and decimal match the standalone formatter
+static void TestCsvWriterNumbers()
+{
+	const U64 numbers[] = { 0, 1, 0x7E, 0xFF, 0x1234, 0xDEADBEEF, ~0ULL };
+	const U32 bits[] = { 8, 16, 32, 64 };
+	const DisplayBase bases[] = { Hexadecimal, Decimal, Binary, ASCII };
+	for ( U32 n=0; n < sizeof ( numbers ) / sizeof ( numbers[ 0 ] ); ++n )
+	{
+		for ( U32 b=0; b < 4; ++b )
+		{
+			for ( U32 d=0; d < 4; ++d )
+			{
+				char expected[ 128 ];
+				BitbusGetNumberString ( numbers[ n ], bases[ d ], bits[ b ], expected, sizeof ( expected ) );
+				stringstream text;
+				{
+					BitbusCsvWriter writer ( text, &BitbusGetNumberString );
+					writer.PutNumber ( numbers[ n ], bases[ d ], bits[ b ] );
+				}
+				CHECK ( text.str() == expected );
+			}
+		}
+	}
+}
+
+// Edge list file -> streamed channel -> frame reader -> text/csv export, as BitbusDecode does
+static void TestEdgeListExport()
+{
+	BitbusDecoderSettings settings = MakeSettings ( BITBUS_TRANSMISSION_BIT_SYNC );
+	BitbusLineEncoder line ( settings, kSamplesPerBit );
+	const U8 frame[] = { 0x01, 0x42, 0x7E, 0x7D, 0x00 };
+	const U32 frames = 50;
+	line.AddIdle ( 16 );
+	line.AddFlags ( 2 );
+	for ( U32 i=0; i < frames; ++i )
+	{
+		line.AddFrame ( frame, sizeof ( frame ) );
+		line.AddFlags ( 1 );
+	}
+	line.AddIdle ( 16 );
+
+	const char* path = "BitbusDecoderTest_edges.txt";
+	FILE* file = fopen ( path, "w" );
+	CHECK ( file != 0 );
+	if ( file == 0 )
+	{
+		return;
+	}
+	fprintf ( file, "# test capture\nsample_rate %u\ninitial %d\n", kSampleRate, ( line.GetInitialState() == BIT_HIGH ) ? 1 : 0 );
+	for ( U32 i=0; i < line.GetEdges().size(); ++i )
+	{
+		fprintf ( file, "%llu\n", ( unsigned long long ) line.GetEdges()[ i ] );
+	}
+	fclose ( file );
+
+	BitbusEdgeListReader capture;
+	string error;
+	CHECK ( capture.Open ( path, 0, error ) );
+	CHECK ( capture.GetSampleRate() == kSampleRate );
+
+	BitbusStreamChannel channel ( capture.GetInitialState(), capture );
+	BitbusFrameReader< BitbusStreamChannel > reader ( settings, channel, capture.GetSampleRate() );
+	ostringstream csv;
+	BitbusWriteCsvExport ( csv, reader, settings, Hexadecimal, capture.GetTriggerSample(), capture.GetSampleRate(),
+	                       &BitbusGetNumberString, &BitbusGetTimeString );
+	remove ( path );
+
+	CHECK ( reader.GetFcsErrorCount() == 0 );
+	U32 rows = 0;
+	istringstream lines ( csv.str() );
+	string row;
+	while ( getline ( lines, row ) )
+	{
+		rows++;
+	}
+	CHECK ( rows == frames + 1 );
+	CHECK ( csv.str().compare ( 0, 31, "Time[s],Address,Information,FCS" ) == 0 );
+}
+
+// Run-length capture: edges read back exactly, Seek() agrees with a plain walk of the edges
+// Decoded fields for the export; cancels at the first progress report past cancelAt
+class ExportFrames
+{
+public:
+	ExportFrames ( const vector<BitbusFrame> & frames, U64 cancelAt = ~0ULL ) :
+		mFrames ( frames ), mCancelAt ( cancelAt ), mProgress ( 0 ), mLastProgress ( 0 )
+	{
+	}
+
+	bool HasFrame ( U64 index )
+	{
+		return index < mFrames.size();
+	}
+
+	BitbusFrame GetFrame ( U64 index )
+	{
+		return mFrames[ index ];
+	}
+
+	bool UpdateExportProgressAndCheckForCancel ( U64 completed_frames )
+	{
+		mProgress++;
+		mLastProgress = completed_frames;
+		return completed_frames >= mCancelAt;
+	}
+
+	const vector<BitbusFrame> & mFrames;
+	U64 mCancelAt;
+	U32 mProgress;
+	U64 mLastProgress;
+};
+
+// Chunks formatted on threads make the same text as one pass
+static void TestParallelExport ( BitbusTransmissionModeType mode, BitbusAddressingMode addressing )
+{
+	BitbusDecoderSettings settings = MakeSettings ( mode );
+	settings.mBitbusAddressingMode = addressing;
+	BitbusLineEncoder line ( settings, kSamplesPerBit );
+
+	const U8 frame[] = { 0x01, 0x10, 0x7E, 0x7D, 0x40, 0x03 };
+	line.AddIdle ( 16 );
+	line.AddFlags ( 2 );
+	for ( U32 i=0; i < 40; ++i )
+	{
+		if ( ( i % 9 ) == 4 )
+		{
+			line.AddAbortedFrame ( frame, 3 + i % 3 );
+			line.AddIdle ( 16 );
+			line.AddFlags ( 2 );
+		}
+		line.AddFrame ( frame, 2 + i % ( sizeof ( frame ) - 1 ), ( i % 7 ) == 2 );
+		line.AddFlags ( 1 + i % 2 );
+	}
+	line.AddIdle ( 16 );
+
+	TestSink sink;
+	Decode ( settings, line, sink );
+
+	ostringstream serial;
+	ExportFrames serialFrames ( sink.mFrames );
+	BitbusWriteCsvExport ( serial, serialFrames, settings, Hexadecimal, 0, kSampleRate, &BitbusGetNumberString, &BitbusGetTimeString );
+	CHECK ( serial.str().size() > 40 * 10 );
+
+	const U32 threads[] = { 1, 2, 3, 8 };
+	const U32 chunkFrames[] = { 1, 5, 17, 100000 };
+	for ( U32 t=0; t < 4; ++t )
+	{
+		for ( U32 c=0; c < 4; ++c )
+		{
+			ostringstream parallel;
+			ExportFrames frames ( sink.mFrames );
+			BitbusWriteCsvExportParallel ( parallel, frames, settings, Hexadecimal, 0, kSampleRate,
+			                               &BitbusGetNumberString, &BitbusGetTimeString, threads[ t ], chunkFrames[ c ] );
+			CHECK ( parallel.str() == serial.str() );
+			CHECK ( frames.mLastProgress == sink.mFrames.size() );
+		}
+	}
+
+	// Cancelled part way: what was written is the start of the export
+	ostringstream cancelled;
+	ExportFrames frames ( sink.mFrames, sink.mFrames.size() / 2 );
+	BitbusWriteCsvExportParallel ( cancelled, frames, settings, Hexadecimal, 0, kSampleRate,
+	                               &BitbusGetNumberString, &BitbusGetTimeString, 4, 5 );
+	CHECK ( cancelled.str().size() < serial.str().size() );
+	CHECK ( serial.str().compare ( 0, cancelled.str().size(), cancelled.str() ) == 0 );
+}
+
+// The index finds each packet's fields, and the export of any run of
+// packets is their rows of the whole export
+static void TestPacketIndex ( BitbusTransmissionModeType mode )
+{
+	BitbusDecoderSettings settings = MakeSettings ( mode );
+	settings.mBitbusAddressingMode = BITBUS_ADDRESS_EXTENDED;
+	BitbusLineEncoder line ( settings, kSamplesPerBit );
+
+	const U8 frame[] = { 0x01, 0x10, 0x7E, 0x7D, 0x40, 0x03 };
+	line.AddIdle ( 16 );
+	line.AddFlags ( 2 );
+	for ( U32 i=0; i < 20; ++i )
+	{
+		if ( ( i % 9 ) == 4 )
+		{
+			line.AddAbortedFrame ( frame, 3 + i % 3 );
+			line.AddIdle ( 16 );
+			line.AddFlags ( 2 );
+		}
+		line.AddFrame ( frame, 2 + i % ( sizeof ( frame ) - 1 ), ( i % 7 ) == 2 );
+		line.AddFlags ( 1 + i % 2 );
+	}
+	line.AddIdle ( 16 );
+
+	BitbusEdgeChannel channel ( line.GetInitialState(), line.GetEdges().data(), line.GetEdges().size(), line.GetEndSample() );
+	TestSink sink;
+	TestDecoder decoder ( settings, sink );
+	decoder.Setup ( &channel, kSampleRate );
+
+	// Built as the analyzer builds it, with the packets' fields kept aside
+	BitbusPacketIndex index;
+	vector< vector<BitbusFrame> > packets;
+	U64 indexed = 0;
+	auto endPacket = [&]()
+	{
+		if ( indexed < sink.mFrames.size() )
+		{
+			packets.push_back ( vector<BitbusFrame> ( sink.mFrames.begin() + indexed, sink.mFrames.end() ) );
+		}
+		for ( ; indexed < sink.mFrames.size(); ++indexed )
+		{
+			index.AddField ( indexed, sink.mFrames[ indexed ] );
+		}
+		index.EndPacket();
+	};
+	Decode ( decoder, endPacket );
+	endPacket();
+
+	CHECK ( index.GetPacketCount() == packets.size() );
+	CHECK ( packets.size() > 20 );
+
+	BitbusPacketText<PacketTextOut> packetText ( settings, &BitbusGetNumberString );
+	U64 firstFrame = 0;
+	for ( U64 p=0; p < packets.size(); ++p )
+	{
+		BitbusPacketEntry entry;
+		CHECK ( index.GetPacket ( p, entry ) );
+		CHECK ( entry.mFirstFrame == firstFrame );
+		CHECK ( entry.mFrameCount == packets[ p ].size() );
+		CHECK ( entry.mStartingSample == packets[ p ][ 0 ].mStartingSampleInclusive );
+
+		BitbusPacketSummary walked;
+		for ( U32 i=0; i < packets[ p ].size(); ++i )
+		{
+			walked.Add ( packets[ p ][ i ] );
+		}
+		CHECK ( packetText.GetText ( entry.GetSummary(), Hexadecimal ) == packetText.GetText ( walked, Hexadecimal ) );
+		firstFrame += packets[ p ].size();
+	}
+	BitbusPacketEntry none;
+	CHECK ( !index.GetPacket ( packets.size(), none ) );
+
+	ostringstream whole;
+	ExportFrames wholeFrames ( sink.mFrames );
+	BitbusWriteCsvExport ( whole, wholeFrames, settings, Hexadecimal, 0, kSampleRate, &BitbusGetNumberString, &BitbusGetTimeString );
+	CHECK ( whole.str().size() > 20 * 10 );
+
+	const string header = BITBUS_CSV_HEADER;
+	const U64 runs[] = { 1, 3, 7 };
+	for ( U32 r=0; r < 3; ++r )
+	{
+		string joined = header;
+		for ( U64 p=0; p < packets.size(); p += runs[ r ] )
+		{
+			ostringstream part;
+			ExportFrames frames ( sink.mFrames );
+			BitbusWriteCsvExportPackets ( part, frames, index, p, min<U64> ( p + runs[ r ], packets.size() ), settings, Hexadecimal,
+			                              0, kSampleRate, &BitbusGetNumberString, &BitbusGetTimeString );
+			CHECK ( part.str().compare ( 0, header.size(), header ) == 0 );
+			joined += part.str().substr ( header.size() );
+		}
+		CHECK ( joined == whole.str() );
+	}
+
+	// On threads, in chunks of whole packets
+	const U32 chunkFrames[] = { 1, 5, 64, BITBUS_EXPORT_CHUNK_FRAMES };
+	for ( U32 c=0; c < 4; ++c )
+	{
+		ostringstream parallel;
+		ExportFrames frames ( sink.mFrames );
+		BitbusWriteCsvExportPackets ( parallel, frames, index, 0, packets.size(), settings, Hexadecimal,
+		                              0, kSampleRate, &BitbusGetNumberString, &BitbusGetTimeString, 3, chunkFrames[ c ] );
+		CHECK ( parallel.str() == whole.str() );
+	}
+
+	// Packets whose fields are not all committed are left out
+	vector<BitbusFrame> committed ( sink.mFrames.begin(), sink.mFrames.end() - 1 );
+	ostringstream cut;
+	ostringstream allButLast;
+	ExportFrames committedFrames ( committed );
+	ExportFrames allFrames ( sink.mFrames );
+	BitbusWriteCsvExportPackets ( cut, committedFrames, index, 0, packets.size(), settings, Hexadecimal,
+	                              0, kSampleRate, &BitbusGetNumberString, &BitbusGetTimeString, 2, 5 );
+	BitbusWriteCsvExportPackets ( allButLast, allFrames, index, 0, packets.size() - 1, settings, Hexadecimal,
+	                              0, kSampleRate, &BitbusGetNumberString, &BitbusGetTimeString );
+	CHECK ( cut.str() == allButLast.str() );
+
+	ostringstream empty;
+	ExportFrames frames ( sink.mFrames );
+	BitbusWriteCsvExportPackets ( empty, frames, index, 3, 3, settings, Hexadecimal,
+	                              0, kSampleRate, &BitbusGetNumberString, &BitbusGetTimeString );
+	CHECK ( empty.str() == header );
+}
+
+static void TestRunLengthCapture()
+{
+	BitbusDecoderSettings settings = MakeSettings ( BITBUS_TRANSMISSION_BIT_SYNC );
+	BitbusLineEncoder line ( settings, kSamplesPerBit );
+	const U8 frame[] = { 0x01, 0x42, 0x7E, 0x00, 0xFF };
+	const U32 frames = 40;
+	line.AddIdle ( 1000 );
+	line.AddFlags ( 2 );
+	for ( U32 i=0; i < frames; ++i )
+	{
+		line.AddFrame ( frame, sizeof ( frame ) );
+		line.AddIdle ( i * 50 );
+	}
+	line.AddIdle ( 16 );
+	const vector<U64> & edges = line.GetEdges();
+
+	const char* path = "BitbusDecoderTest.bbrl";
+	BitbusRunLengthWriter writer;
+	string error;
+	CHECK ( writer.Create ( path, kSampleRate, line.GetInitialState(), 0, error, 16 ) );
+	for ( U32 i=0; i < edges.size(); ++i )
+	{
+		CHECK ( writer.AddEdge ( edges[ i ] ) );
+	}
+	CHECK ( !writer.AddEdge ( edges.back() ) );
+	CHECK ( writer.Close ( line.GetEndSample() ) );
+
+	BitbusRunLengthReader capture;
+	CHECK ( capture.Open ( path, 0, error ) );
+	CHECK ( capture.GetEdgeCount() == edges.size() );
+	CHECK ( capture.GetBlockCount() == ( edges.size() + 15 ) / 16 );
+	CHECK ( capture.GetEndSample() == line.GetEndSample() );
+
+	U64 edge;
+	U32 count = 0;
+	while ( capture.NextEdge ( edge ) )
+	{
+		CHECK ( ( count < edges.size() ) && ( edge == edges[ count ] ) );
+		count++;
+	}
+	CHECK ( count == edges.size() );
+
+	// Around every edge, then back to the start
+	for ( U32 i=0; i <= edges.size(); ++i )
+	{
+		const U64 samples[ 3 ] = { ( i < edges.size() ) ? edges[ i ] - 1 : 0, ( i < edges.size() ) ? edges[ i ] : 0,
+		                           ( i < edges.size() ) ? edges[ i ] + 1 : line.GetEndSample() };
+		for ( U32 j=0; j < 3; ++j )
+		{
+			BitbusEdgeChannel reference ( line.GetInitialState(), edges.data(), edges.size(), line.GetEndSample() );
+			reference.Advance ( U32 ( samples[ j ] ) );
+
+			BitState state;
+			CHECK ( capture.Seek ( samples[ j ], state ) );
+			CHECK ( state == reference.GetBitState() );
+			bool hasEdge = capture.NextEdge ( edge );
+			CHECK ( hasEdge == reference.DoMoreTransitionsExistInCurrentData() );
+			if ( hasEdge && reference.DoMoreTransitionsExistInCurrentData() )
+			{
+				reference.AdvanceToNextEdge();
+				CHECK ( edge == reference.GetSampleNumber() );
+			}
+		}
+	}
+
+	// Decoding from a seek part way in finds the frames after it
+	BitbusStreamChannel channel ( capture.GetInitialState(), capture );
+	CHECK ( channel.Seek ( edges[ edges.size() / 2 ] ) );
+	BitbusFrameReader< BitbusStreamChannel > reader ( settings, channel, kSampleRate );
+	U32 fcsFields = 0;
+	for ( U64 i=0; reader.HasFrame ( i ); ++i )
+	{
+		fcsFields += ( reader.GetFrame ( i ).mType == BITBUS_FIELD_FCS ) ? 1 : 0;
+	}
+	CHECK ( ( fcsFields > 0 ) && ( fcsFields < frames ) );
+	CHECK ( reader.GetFcsErrorCount() == 0 );
+
+	remove ( path );
+}
+
+class EdgeArraySources : public BitbusEdgeSourceFactory
+{
+public:
+	explicit EdgeArraySources ( const BitbusLineEncoder & line ) : mLine ( line )
+	{
+	}
+
+	virtual BitbusEdgeSource* CreateSource()
+	{
+		return new BitbusEdgeArraySource ( mLine.GetInitialState(), mLine.GetEdges().data(), mLine.GetEdges().size(), mLine.GetEndSample() );
+	}
+
+protected:
+	const BitbusLineEncoder & mLine;
+};
+
+static bool SameFrame ( const BitbusFrame & a, const BitbusFrame & b )
+{
+	return ( a.mStartingSampleInclusive == b.mStartingSampleInclusive ) && ( a.mEndingSampleInclusive == b.mEndingSampleInclusive ) &&
+	       ( a.mType == b.mType ) && ( a.mData1 == b.mData1 ) && ( a.mData2 == b.mData2 ) && ( a.mFlags == b.mFlags );
+}
+
+// A decoder resumed from the key of any frame boundary goes on exactly as
+// the one that gave it
+static void TestResume ( BitbusTransmissionModeType mode )
+{
+	BitbusDecoderSettings settings = MakeSettings ( mode );
+	BitbusLineEncoder line ( settings, kSamplesPerBit );
+	U8 frame[] = { 0x01, 0x00, 0x7E, 0x7D, 0xFF, 0x3F, 0x00 };
+	line.AddIdle ( 16 );
+	line.AddFlags ( 2 );
+	for ( U32 i=0; i < 40; ++i )
+	{
+		frame[ 1 ] = U8 ( i * 7 );
+		if ( i % 9 == 4 )
+		{
+			line.AddAbortedFrame ( frame, 4 );
+		}
+		else
+		{
+			line.AddFrame ( frame, 3 + i % 5 );
+		}
+		if ( i % 3 == 0 )
+		{
+			line.AddIdle ( 12 + i % 20 );
+		}
+		line.AddFlags ( 1 + i % 2 );
+	}
+	line.AddIdle ( 16 );
+
+	BitbusEdgeChannel channel ( line.GetInitialState(), line.GetEdges().data(), line.GetEdges().size(), line.GetEndSample() );
+	TestSink serial;
+	TestDecoder decoder ( settings, serial );
+	decoder.Setup ( &channel, kSampleRate );
+	vector<BitbusResumeKey> keys;
+	vector<U64> framesAt;
+	Decode ( decoder, [&]()
+	{
+		keys.push_back ( decoder.GetResumeKey() );
+		framesAt.push_back ( serial.mFrames.size() );
+	} );
+	CHECK ( keys.size() > 40 );
+
+	EdgeArraySources sources ( line );
+	for ( U32 k=1; k < keys.size(); k += 3 )
+	{
+		unique_ptr<BitbusEdgeSource> source ( sources.CreateSource() );
+		BitbusStreamChannel resumed ( line.GetInitialState(), *source );
+		CHECK ( resumed.Seek ( keys[ k ].mSample ) );
+		TestSink sink;
+		BitbusDecoder<BitbusStreamChannel, TestSink> again ( settings, sink );
+		again.Setup ( &resumed, kSampleRate );
+		again.Resume ( keys[ k ] );
+		CHECK ( again.GetResumeKey() == keys[ k ] );
+		Decode ( again, NoFrameCallback(), false );
+
+		bool same = ( sink.mFrames.size() == serial.mFrames.size() - framesAt[ k ] );
+		for ( U32 i=0; same && ( i < sink.mFrames.size() ); ++i )
+		{
+			same = SameFrame ( sink.mFrames[ i ], serial.mFrames[ framesAt[ k ] + i ] );
+		}
+		CHECK ( same );
+	}
+}
+
+// Splits the capture anywhere, mid-frame too, and decodes one boundary past
+// each stop only: joins fail and are decoded again
+class SplitAnywhereDecoder : public BitbusParallelDecoder
+{
+public:
+	SplitAnywhereDecoder ( const BitbusDecoderSettings & settings, const BitbusLineEncoder & line, BitbusEdgeSourceFactory & sources ) :
+		BitbusParallelDecoder ( settings, kSampleRate, line.GetInitialState(), line.GetEndSample(), sources )
+	{
+		mOverrunBoundaries = 1;
+	}
+
+protected:
+	virtual vector<U64> FindSplits ( U32 segments )
+	{
+		vector<U64> splits;
+		for ( U32 i=0; i < segments; ++i )
+		{
+			splits.push_back ( mEndSample / segments * i + ( ( i > 0 ) ? 12345 % ( mEndSample / segments ) : 0 ) );
+		}
+		return splits;
+	}
+};
+
+// The parallel decoder's output, as one decoder's would be
+class CollectedOutput : public BitbusParallelOutput
+{
+public:
+	CollectedOutput() : mCalls ( 0 )
+	{
+	}
+
+	virtual void AddDecoded ( const BitbusFrame* frames, U64 frameCount, const BitbusDecodedMarker* markers, U64 markerCount )
+	{
+		mFrames.insert ( mFrames.end(), frames, frames + frameCount );
+		mMarkers.insert ( mMarkers.end(), markers, markers + markerCount );
+		mCalls++;
+	}
+
+	vector<BitbusFrame> mFrames;
+	vector<BitbusDecodedMarker> mMarkers;
+	U32 mCalls;
+};
+
+// Segmented decoding on several threads gives exactly what one decoder gives
+static void TestParallelDecode ( BitbusTransmissionModeType mode )
+{
+	BitbusDecoderSettings settings = MakeSettings ( mode );
+	BitbusLineEncoder line ( settings, kSamplesPerBit );
+
+	U8 frame[] = { 0x01, 0x00, 0x7E, 0x7D, 0xFF, 0x3F, 0x00, 0x00 };
+	line.AddIdle ( 16 );
+	line.AddFlags ( 2 );
+	for ( U32 i=0; i < 300; ++i )
+	{
+		frame[ 1 ] = U8 ( i );
+		U32 size = 3 + i % 6;
+		if ( i % 37 == 5 )
+		{
+			line.AddAbortedFrame ( frame, size );
+		}
+		else
+		{
+			line.AddFrame ( frame, size, ( i % 29 ) == 3 );
+		}
+		// Idle runs of different lengths, some too short to split in, and stretches of fill flags
+		if ( i % 5 == 0 )
+		{
+			line.AddFlags ( 1 + i % 4 );
+		}
+		else
+		{
+			line.AddIdle ( 10 + ( i % 7 ) * 6 );
+			line.AddFlags ( 1 );
+		}
+	}
+	line.AddIdle ( 16 );
+
+	TestSink serial;
+	Decode ( settings, line, serial );
+	CHECK ( serial.Count ( BITBUS_FIELD_FCS ) > 250 );
+
+	EdgeArraySources sources ( line );
+	const U32 segments[] = { 0, 7, 64, 500 };
+	U32 redecodes = 0;
+	for ( U32 run=0; run < 8; ++run )
+	{
+		BitbusParallelDecoder split ( settings, kSampleRate, line.GetInitialState(), line.GetEndSample(), sources );
+		SplitAnywhereDecoder splitAnywhere ( settings, line, sources );
+		BitbusParallelDecoder & parallel = ( run < 4 ) ? split : splitAnywhere;
+		CollectedOutput output;
+		CHECK ( parallel.Decode ( output, 4, segments[ run % 4 ] ) );
+		CHECK ( parallel.GetSegmentCount() > 1 );
+		// Given out join by join, not all at the end
+		CHECK ( output.mCalls > 1 );
+		redecodes += parallel.GetRedecodeCount();
+
+		const vector<BitbusFrame> & frames = output.mFrames;
+		CHECK ( frames.size() == serial.mFrames.size() );
+		bool same = ( frames.size() == serial.mFrames.size() );
+		for ( U32 i=0; same && ( i < frames.size() ); ++i )
+		{
+			same = SameFrame ( frames[ i ], serial.mFrames[ i ] );
+		}
+		CHECK ( same );
+
+		U32 fcsErrors = 0;
+		for ( U32 i=0; i < output.mMarkers.size(); ++i )
+		{
+			fcsErrors += ( output.mMarkers[ i ].mType == BITBUS_MARKER_FCS_ERROR ) ? 1 : 0;
+		}
+		CHECK ( fcsErrors == serial.mFcsErrorMarkers );
+		CHECK ( output.mMarkers.size() == serial.mFcsErrorMarkers + serial.mStuffedBitMarkers );
+	}
+	CHECK ( redecodes > 0 );
+}
+
+// Exposes how far apart the splits look for their idle runs
+class SplitSpacingDecoder : public BitbusParallelDecoder
+{
+public:
+	SplitSpacingDecoder ( const BitbusDecoderSettings & settings, U32 sampleRateHz, BitbusEdgeSourceFactory & sources ) :
+		BitbusParallelDecoder ( settings, sampleRateHz, BIT_HIGH, 0, sources )
+	{
+	}
+
+	using BitbusParallelDecoder::SamplesForBits;
+};
+
+// Split spacing at the fractional bit period: 1 MHz at 375 kbit/s is 2.67
+// samples a bit, not 2
+static void TestSplitSpacing()
+{
+	BitbusDecoderSettings settings = MakeSettings ( BITBUS_TRANSMISSION_BIT_SYNC );
+	BitbusLineEncoder line ( settings, kSamplesPerBit );
+	EdgeArraySources sources ( line );
+
+	settings.mBitRate = 375000;
+	SplitSpacingDecoder fractional ( settings, 1000000, sources );
+	CHECK ( fractional.SamplesForBits ( 16 ) == 42 );
+	CHECK ( fractional.SamplesForBits ( 3 ) == 8 );
+
+	settings.mBitRate = 62500;
+	SplitSpacingDecoder whole ( settings, kSampleRate, sources );
+	CHECK ( whole.SamplesForBits ( 16 ) == 16 * kSamplesPerBit );
+
+	// Faster than the sample rate: a sample a bit at least
+	settings.mBitRate = 2000000;
+	SplitSpacingDecoder fast ( settings, 1000000, sources );
+	CHECK ( fast.SamplesForBits ( 16 ) == 16 );
+}
+
+// The counters match what the sink was given, and the edges those of the line
+static void TestDecodeStats ( BitbusTransmissionModeType mode )
+{
+	BitbusDecoderSettings settings = MakeSettings ( mode );
+	BitbusLineEncoder line ( settings, kSamplesPerBit );
+
+	const U8 frame[] = { 0x01, 0x10, 0x7E, 0xFF, 0x3F };
+	line.AddIdle ( 16 );
+	line.AddFlags ( 2 );
+	line.AddFrame ( frame, sizeof ( frame ) );
+	line.AddFlags ( 3 );
+	line.AddFrame ( frame, sizeof ( frame ), true );
+	line.AddFlags ( 1 );
+	line.AddAbortedFrame ( frame, 4 );
+	line.AddIdle ( 16 );
+	line.AddFlags ( 2 );
+	line.AddFrame ( frame, sizeof ( frame ) );
+	line.AddFlags ( 2 );
+	line.AddIdle ( 16 );
+
+	BitbusEdgeChannel channel ( line.GetInitialState(), line.GetEdges().data(), line.GetEdges().size(), line.GetEndSample() );
+	BitbusCountingChannel<BitbusEdgeChannel> counting;
+	counting.Setup ( &channel );
+	TestSink sink;
+	BitbusDecoder< BitbusCountingChannel<BitbusEdgeChannel>, TestSink > decoder ( settings, sink );
+	decoder.Setup ( &counting, kSampleRate );
+	Decode ( decoder );
+
+	const BitbusDecodeStats & stats = decoder.GetStats();
+	CHECK ( stats.mFields == sink.mFrames.size() );
+	CHECK ( stats.mPackets == 4 );
+	CHECK ( stats.mAborts == 1 );
+	CHECK ( stats.mFcsErrors == 1 );
+	CHECK ( stats.mFcsErrors == sink.mFcsErrorMarkers );
+	CHECK ( stats.mInformationBytes == sink.Count ( BITBUS_FIELD_INFORMATION ) );
+	CHECK ( stats.mFlags + stats.mFillFlags == sink.Count ( BITBUS_FIELD_FLAG ) );
+	CHECK ( stats.mFillFlags > 0 );
+	CHECK ( stats.mStuffedBits == sink.mStuffedBitMarkers );
+	CHECK ( stats.mFramingErrors == 0 );
+	CHECK ( stats.mAllocations == decoder.GetAllocationCount() );
+	CHECK ( stats.mAllocations > 0 );
+	CHECK ( counting.GetEdgeCount() <= line.GetEdges().size() );
+	CHECK ( counting.GetCallCount() > counting.GetEdgeCount() );
+	if ( mode != BITBUS_TRANSMISSION_BYTE_ASYNC )
+	{
+		CHECK ( stats.mResyncs >= stats.mAborts );
+		CHECK ( stats.mStuffedBits > 0 );
+	}
+
+	// The parallel decoder counts the frames of the joined output
+	EdgeArraySources sources ( line );
+	BitbusParallelDecoder parallel ( settings, kSampleRate, line.GetInitialState(), line.GetEndSample(), sources );
+	CollectedOutput output;
+	CHECK ( parallel.Decode ( output, 2, 4 ) );
+	BitbusDecodeStats joined = parallel.GetStats();
+	CHECK ( joined.mFields == stats.mFields );
+	CHECK ( joined.mPackets == stats.mPackets );
+	CHECK ( joined.mInformationBytes == stats.mInformationBytes );
+	CHECK ( joined.mStuffedBits == stats.mStuffedBits );
+	CHECK ( joined.mEdges >= counting.GetEdgeCount() );
+	CHECK ( joined.mAllocations >= stats.mAllocations );
+
+	ostringstream out;
+	BitbusWriteStatsExport ( out, stats );
+	const string text = out.str();
+	const string header = BITBUS_STATS_HEADER;
+	CHECK ( text.compare ( 0, header.size(), header ) == 0 );
+	CHECK ( text.find ( "\nframes,4\n" ) != string::npos );
+	CHECK ( text.find ( "\naborts,1\n" ) != string::npos );
+	CHECK ( text.find ( "\nbuffer_allocations," + to_string ( stats.mAllocations ) + "\n" ) != string::npos );
+	CHECK ( text.find ( "\ncommitted_frames,0\n" ) != string::npos );
+#ifdef BITBUS_PHASE_TIMING
+	CHECK ( text.find ( "\nbyte_phase_ns," ) != string::npos );
+#else
+	CHECK ( text.find ( "_phase_ns" ) == string::npos );
+#endif
+}
+
+// The ring keeps the latest records, and an abort storm dumps it
+static void TestTraceRing()
+{
+	BitbusTraceRing ring;
+	for ( U64 i=0; i < BITBUS_TRACE_RECORDS + 10; ++i )
+	{
+		ring.Record ( BITBUS_TRACE_BYTE, i, U32 ( i & 0xFF ) );
+	}
+	stringstream dump;
+	ring.Write ( dump, "test" );
+	CHECK ( dump.str().size() == BITBUS_TRACE_HEADER_SIZE + BITBUS_TRACE_RECORDS * BITBUS_TRACE_RECORD_SIZE );
+
+	BitbusTraceHeader header;
+	vector<BitbusTraceRecord> records;
+	string error;
+	CHECK ( BitbusReadTrace ( dump, header, records, error ) );
+	CHECK ( header.mReason == "test" );
+	CHECK ( header.mRecorded == BITBUS_TRACE_RECORDS + 10 );
+	CHECK ( records.size() == BITBUS_TRACE_RECORDS );
+	CHECK ( ( records.front().mSample == 10 ) && ( records.back().mSample == BITBUS_TRACE_RECORDS + 9 ) );
+	CHECK ( ( records.back().mEvent == BITBUS_TRACE_BYTE ) && ( records.back().mPayload == ( ( BITBUS_TRACE_RECORDS + 9 ) & 0xFF ) ) );
+
+	BitbusTraceRing::Configure ( ".", false );
+	BitbusTraceRing storm;
+	const string path = "./bitbus-trace-" + to_string ( storm.GetThread() ) + "-0.bbtr";
+	remove ( path.c_str() );
+	for ( U32 i=0; i < BITBUS_TRACE_STORM_ABORTS - 1; ++i )
+	{
+		storm.Trace ( BITBUS_TRACE_ABORT, i, 0 );
+	}
+	storm.Trace ( BITBUS_TRACE_FRAME_END, 100, 0 );
+	ifstream none ( path.c_str(), ios::in | ios::binary );
+	CHECK ( !none );
+	for ( U32 i=0; i < BITBUS_TRACE_STORM_ABORTS; ++i )
+	{
+		storm.Trace ( BITBUS_TRACE_ABORT, 200 + i, 0 );
+	}
+	ifstream file ( path.c_str(), ios::in | ios::binary );
+	CHECK ( BitbusReadTrace ( file, header, records, error ) );
+	CHECK ( header.mReason == "abort storm" );
+	CHECK ( records.size() == 2 * BITBUS_TRACE_STORM_ABORTS + 1 );
+	CHECK ( ( records.back().mEvent == BITBUS_TRACE_ABORT_STORM ) && ( records.back().mPayload == BITBUS_TRACE_STORM_ABORTS ) );
+	file.close();
+	remove ( path.c_str() );
+	BitbusTraceRing::Configure ( "", false );
+}
+
+// One record per BITBUS frame, the payload as it was sent
+static void TestFrameRecords ( BitbusTransmissionModeType mode )
+{
+	BitbusDecoderSettings settings = MakeSettings ( mode );
+	BitbusLineEncoder line ( settings, kSamplesPerBit );
+
+	const U8 frame[] = { 0x01, 0x42, 0x7E, 0x7D, 0x7F, 0xFF, 0x20 };
+	line.AddIdle ( 16 );
+	line.AddFlags ( 3 );
+	line.AddFrame ( frame, sizeof ( frame ) );
+	line.AddFlags ( 1 );
+	line.AddFrame ( frame, 2, true );
+	line.AddFlags ( 1 );
+	line.AddAbortedFrame ( frame, 5 );
+	line.AddIdle ( 16 );
+	line.AddFlags ( 2 );
+	line.AddFrame ( frame, sizeof ( frame ) );
+	line.AddFlags ( 2 );
+	line.AddIdle ( 16 );
+
+	TestSink sink;
+	Decode ( settings, line, sink );
+
+	BitbusFrameRecordBuilder builder;
+	vector<BitbusFrameRecord> records;
+	U64 startFlag = 0;
+	for ( U32 i=0; i < sink.mFrames.size(); ++i )
+	{
+		const BitbusFrame & f = sink.mFrames[ i ];
+		startFlag = ( ( f.mType == BITBUS_FIELD_FLAG ) && ( f.mData1 == BITBUS_FLAG_START ) ) ? f.mStartingSampleInclusive : startFlag;
+		if ( builder.Add ( f ) )
+		{
+			records.push_back ( builder.GetRecord() );
+			CHECK ( records.back().mStartingSample == startFlag );
+			CHECK ( records.back().mEndingSample == f.mEndingSampleInclusive );
+		}
+	}
+
+	CHECK ( records.size() == 4 );
+	if ( records.size() != 4 )
+	{
+		return;
+	}
+	const vector<U8> payload ( frame + 2, frame + sizeof ( frame ) );
+	CHECK ( records[ 0 ].mHasAddress && ( records[ 0 ].mAddress == 0x0142 ) );
+	CHECK ( records[ 0 ].mPayload == payload );
+	CHECK ( records[ 0 ].mHasFcs && ( records[ 0 ].mFcsRead == records[ 0 ].mFcsCalculated ) );
+	CHECK ( records[ 0 ].mErrors == 0 );
+	CHECK ( records[ 1 ].mPayload.empty() );
+	CHECK ( records[ 1 ].mFcsRead != records[ 1 ].mFcsCalculated );
+	CHECK ( records[ 1 ].mErrors == BITBUS_RECORD_FCS_ERROR );
+	CHECK ( !records[ 2 ].mHasFcs );
+	CHECK ( ( records[ 2 ].mErrors & BITBUS_RECORD_ABORTED ) != 0 );
+	CHECK ( records[ 3 ].mPayload == payload );
+	CHECK ( records[ 3 ].mErrors == 0 );
+
+	// A one byte address is escaped like the payload in async mode
+	settings.mBitbusAddressingMode = BITBUS_ADDRESS_ADDR_RESERVED;
+	BitbusLineEncoder escapedLine ( settings, kSamplesPerBit );
+	const U8 escapedAddress[] = { 0x7E, 0x00, 0x42 };
+	escapedLine.AddIdle ( 16 );
+	escapedLine.AddFlags ( 2 );
+	escapedLine.AddFrame ( escapedAddress, sizeof ( escapedAddress ) );
+	escapedLine.AddFlags ( 2 );
+	escapedLine.AddIdle ( 16 );
+
+	TestSink escapedSink;
+	Decode ( settings, escapedLine, escapedSink );
+	U32 closed = 0;
+	for ( U32 i=0; i < escapedSink.mFrames.size(); ++i )
+	{
+		if ( builder.Add ( escapedSink.mFrames[ i ] ) )
+		{
+			closed++;
+			CHECK ( builder.GetRecord().mHasAddress && ( builder.GetRecord().mAddress == 0x7E ) );
+			CHECK ( builder.GetRecord().mPayload == vector<U8> ( 1, 0x42 ) );
+			CHECK ( builder.GetRecord().mErrors == 0 );
+		}
+	}
+	CHECK ( closed == 1 );
+}
+
+// A FrameV2 as columns, and the FrameV2 output of a run
+struct TestFrameV2
+{
+	void AddString ( const char* key, const char* value )
+	{
+		mColumns[ key ] = value;
+	}
+	void AddInteger ( const char* key, S64 value )
+	{
+		mColumns[ key ] = std::to_string ( value );
+	}
+	void AddBoolean ( const char* key, bool value )
+	{
+		mColumns[ key ] = value ? "true" : "false";
+	}
+
+	std::map<string, string> mColumns;
+};
+
+struct TestRecordSink
+{
+	void AddFieldRecord ( const BitbusFrame & field )
+	{
+		TestFrameV2 frame;
+		mTypes.push_back ( BitbusAddFieldColumns ( frame, field ) );
+		mFields.push_back ( frame );
+	}
+	void AddFrameRecord ( const BitbusFrameRecord & record )
+	{
+		mRecords.push_back ( record );
+	}
+
+	vector<string> mTypes;
+	vector<TestFrameV2> mFields;
+	vector<BitbusFrameRecord> mRecords;
+};
+
+static void TestRecordOutput ( BitbusTransmissionModeType mode )
+{
+	BitbusDecoderSettings settings = MakeSettings ( mode );
+	BitbusLineEncoder line ( settings, kSamplesPerBit );
+
+	const U8 frame[] = { 0x01, 0x42, 0x7E, 0x10 };
+	line.AddIdle ( 16 );
+	line.AddFlags ( 2 );
+	line.AddFrame ( frame, sizeof ( frame ) );
+	line.AddFlags ( 1 );
+	line.AddAbortedFrame ( frame, 3 );
+	line.AddIdle ( 16 );
+
+	TestSink sink;
+	Decode ( settings, line, sink );
+
+	const BitbusOutputMode outputModes[] = { BITBUS_OUTPUT_FIELDS, BITBUS_OUTPUT_FIELDS_AND_RECORDS, BITBUS_OUTPUT_RECORDS };
+	for ( U32 m=0; m < 3; ++m )
+	{
+		BitbusRecordOutput output;
+		TestRecordSink records;
+		output.Start ( outputModes[ m ] );
+		for ( U32 i=0; i < sink.mFrames.size(); ++i )
+		{
+			output.Add ( records, sink.mFrames[ i ] );
+		}
+
+		// Every output mode has FrameV2 records
+		CHECK ( !records.mFields.empty() || !records.mRecords.empty() );
+		if ( outputModes[ m ] != BITBUS_OUTPUT_FIELDS )
+		{
+			CHECK ( records.mFields.empty() );
+			CHECK ( records.mRecords.size() == 2 );
+			continue;
+		}
+
+		CHECK ( records.mRecords.empty() );
+		CHECK ( records.mFields.size() == sink.mFrames.size() );
+		U32 info = 0;
+		for ( U32 i=0; i < records.mFields.size(); ++i )
+		{
+			std::map<string, string> & columns = records.mFields[ i ].mColumns;
+			CHECK ( columns[ "framing_error" ] == "false" );
+			if ( records.mTypes[ i ] == "information" )
+			{
+				// The byte as sent, not as escaped on the wire
+				CHECK ( columns[ "value" ] == std::to_string ( frame[ 2 + info % 2 ] ) );
+				CHECK ( columns[ "escaped" ] == ( ( ( mode != BITBUS_TRANSMISSION_BYTE_ASYNC ) || ( info % 2 ) ) ? "false" : "true" ) );
+				CHECK ( columns[ "index" ] == std::to_string ( info % 2 ) );
+				info++;
+			}
+		}
+		CHECK ( info == 3 );
+		CHECK ( records.mTypes.front() == "flag" );
+		CHECK ( records.mTypes.back() == "abort" );
+	}
+}
+
+int main()
+{
+	const BitbusTransmissionModeType modes[] = { BITBUS_TRANSMISSION_BIT_SYNC, BITBUS_TRANSMISSION_BIT_SYNC_NRZ, BITBUS_TRANSMISSION_BYTE_ASYNC };
+
+	for ( U32 i=0; i < 3; ++i )
+	{
+		TestGoodFrames ( modes[ i ], BITBUS_FCS_CRC16 );
+		TestGoodFrames ( modes[ i ], BITBUS_FCS_CRC32 );
+		TestFcsError ( modes[ i ] );
+		TestAbort ( modes[ i ] );
+		TestResume ( modes[ i ] );
+		TestParallelDecode ( modes[ i ] );
+		TestDecodeStats ( modes[ i ] );
+		TestFrameRecords ( modes[ i ] );
+		TestRecordOutput ( modes[ i ] );
+	}
+	TestSplitSpacing();
+	TestBitClockDrift ( BITBUS_TRANSMISSION_BIT_SYNC );
+	TestBitClockDrift ( BITBUS_TRANSMISSION_BIT_SYNC_NRZ );
+	TestFlagHunt ( BITBUS_TRANSMISSION_BIT_SYNC );
+	TestFlagHunt ( BITBUS_TRANSMISSION_BIT_SYNC_NRZ );
+	TestPacketText();
+	TestFieldText();
+	TestFramingError();
+	TestWaveformTables();
+	TestAllocationsFlat();
+	TestCsvWriterNumbers();
+	for ( U32 i=0; i < 3; ++i )
+	{
+		TestParallelExport ( modes[ i ], BITBUS_ADDRESS_SOF );
+		TestParallelExport ( modes[ i ], BITBUS_ADDRESS_EXTENDED );
+		TestParallelExport ( modes[ i ], BITBUS_ADDRESS_ADDR_RESERVED );
+	}
+	for ( U32 i=0; i < 3; ++i )
+	{
+		TestPacketIndex ( modes[ i ] );
+	}
+	TestEdgeListExport();
+	TestRunLengthCapture();
+	TestSaleaeBinaryWriter();
+	TestTraceRing();
+	for ( U32 i=0; i < 3; ++i )
+	{
+		for ( U32 type=0; type < BITBUS_TRAFFIC_TYPES; ++type )
+		{
+			TestTraffic ( modes[ i ], BitbusTrafficType ( type ), BITBUS_FCS_CRC16 );
+		}
+		TestTraffic ( modes[ i ], BITBUS_TRAFFIC_FAULTS, BITBUS_FCS_CRC32 );
+	}
+	for ( U32 i=0; i < 3; ++i )
+	{
+		TestBitClock ( modes[ i ], 3.5, 3.5 );
+		TestBitClock ( modes[ i ], 6.6, 6.6 );
+		TestBitClock ( modes[ i ], 3.4, 3.5 ); // the line 3% fast
+		TestBitRateDetection ( modes[ i ], 400 );
+		TestBitRateDetection ( modes[ i ], 66.67 );
+		TestBitRateDetection ( modes[ i ], 4 );
+		TestSetupBitRate ( modes[ i ] );
+		TestReadAheadChannel ( modes[ i ] );
+	}
+
+	if ( sFailures > 0 )
+	{
+		printf ( "%u check(s) failed\n", sFailures );
+		return 1;
+	}
+	printf ( "All BITBUS decoder tests passed\n" );
+	return 0;
+}
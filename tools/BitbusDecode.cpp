@@ -0,0 +1,475 @@
+// Headless BITBUS decoder: reads a Saleae Logic 2 digital binary export
+// (digital_N.bin), a BITBUS run-length capture (.bbrl) or an edge-list
+// text file, decodes it like the analyzer and writes the analyzer's
+// text/csv export. The capture is streamed.
+//
+//   BitbusDecode [options] <capture> [output.csv]
+//   BitbusDecode [options] --save <capture.bbrl> <capture>
+//
+// Without an output file the CSV goes to stdout.
+
+#include "BitbusBitRate.h"
+#include "BitbusCaptureReader.h"
+#include "BitbusCsvExport.h"
+#include "BitbusFrameReader.h"
+#include "BitbusParallelDecoder.h"
+#include "BitbusParallelExport.h"
+#include "BitbusRunLengthCapture.h"
+#include "BitbusStatsExport.h"
+#include "BitbusTrace.h"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace std;
+
+static void Usage()
+{
+	fprintf ( stderr,
+	          "usage: BitbusDecode [options] <capture> [output.csv]\n"
+	          "  capture: Saleae binary export (digital_N.bin), run-length capture (.bbrl)\n"
+	          "           or edge-list text file\n"
+	          "options:\n"
+	          "  --save FILE          convert the capture to a run-length capture, no decoding\n"
+	          "  --start SAMPLE       decode from this sample on (run-length captures)\n"
+	          "  --threads N          decode and format on N threads (run-length captures)\n"
+	          "  --sample-rate HZ     sample rate (required for binary exports)\n"
+	          "  --bit-rate BPS       bit rate (default 62500), or auto to detect it from the\n"
+	          "                       first edges of the capture\n"
+	          "  --mode MODE          nrzi (default), nrz or async\n"
+	          "  --address TYPE       sof (default), normal or extended\n"
+	          "  --fcs TYPE           crc16 (default) or crc32\n"
+	          "  --base BASE          hex (default), dec, bin or ascii\n"
+	          "  --stats FILE         write the decode counters (edges, channel calls, flags,\n"
+	          "                       errors, time per phase) to FILE as csv\n"
+	          "  --trace DIR          dump each decoding thread's trace ring to DIR as it ends\n"
+	          "                       (builds with -DBITBUS_TRACE=ON)\n"
+	          "  --quiet              no summary on stderr\n" );
+}
+
+// Index of value in names, or -1
+static int Lookup ( const char* value, const char* const* names, int count )
+{
+	for ( int i=0; i < count; ++i )
+	{
+		if ( strcmp ( value, names[ i ] ) == 0 )
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+// Each decoding thread maps the capture for itself
+class RunLengthSources : public BitbusEdgeSourceFactory
+{
+public:
+	RunLengthSources ( const char* path, U32 sampleRate ) : mPath ( path ), mSampleRate ( sampleRate )
+	{
+	}
+
+	virtual BitbusEdgeSource* CreateSource()
+	{
+		unique_ptr<BitbusRunLengthReader> reader ( new BitbusRunLengthReader() );
+		string error;
+		return reader->Open ( mPath, mSampleRate, error ) ? reader.release() : 0;
+	}
+
+protected:
+	const char* mPath;
+	U32 mSampleRate;
+};
+
+// The parallel decoder's output, formatted as it comes; taking each joined
+// stretch is timed as a commit
+class ExportOutput : public BitbusParallelOutput
+{
+public:
+	explicit ExportOutput ( BitbusParallelCsvExport & exporter ) : mExporter ( exporter ), mCommits ( 0 ), mCommitNanoseconds ( 0 )
+	{
+	}
+
+	virtual void AddDecoded ( const BitbusFrame* frames, U64 frameCount, const BitbusDecodedMarker* /*markers*/, U64 /*markerCount*/ )
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for ( U64 i=0; i < frameCount; ++i )
+		{
+			mExporter.AddFrame ( frames[ i ] );
+		}
+		mCommits++;
+		mCommitNanoseconds += U64 ( std::chrono::duration_cast<std::chrono::nanoseconds> ( std::chrono::steady_clock::now() - start ).count() );
+	}
+
+	BitbusParallelCsvExport & mExporter;
+	U64 mCommits;
+	U64 mCommitNanoseconds;
+};
+
+// The decode counters, to statsPath if there is one
+static bool WriteStats ( const char* statsPath, const BitbusDecodeStats & stats )
+{
+	if ( statsPath == 0 )
+	{
+		return true;
+	}
+	ofstream statsFile ( statsPath, ios::out );
+	BitbusWriteStatsExport ( statsFile, stats );
+	if ( !statsFile )
+	{
+		fprintf ( stderr, "cannot write %s\n", statsPath );
+		return false;
+	}
+	return true;
+}
+
+static bool DecodeParallel ( const char* path, const BitbusCaptureReader & capture, const BitbusDecoderSettings & settings,
+                             U32 threads, DisplayBase displayBase, ostream & output, bool quiet, const char* statsPath )
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	RunLengthSources sources ( path, capture.GetSampleRate() );
+	BitbusParallelDecoder decoder ( settings, capture.GetSampleRate(), capture.GetInitialState(), capture.GetEndSample(), sources );
+	BitbusParallelCsvExport exporter ( output, settings, displayBase, capture.GetTriggerSample(), capture.GetSampleRate(),
+	                                   &BitbusGetNumberString, &BitbusGetTimeString, threads );
+	ExportOutput exportOutput ( exporter );
+	if ( !decoder.Decode ( exportOutput, threads ) )
+	{
+		fprintf ( stderr, "cannot read %s\n", path );
+		return false;
+	}
+	exporter.Finish();
+	output.flush();
+
+	BitbusDecodeStats stats = decoder.GetStats();
+	stats.mCommits = exportOutput.mCommits;
+	stats.mCommittedPackets = stats.mPackets;
+	stats.mCommitNanoseconds = exportOutput.mCommitNanoseconds;
+	if ( !WriteStats ( statsPath, stats ) )
+	{
+		return false;
+	}
+
+	double seconds = std::chrono::duration<double> ( std::chrono::steady_clock::now() - start ).count();
+	if ( !quiet )
+	{
+		double captureSeconds = double ( capture.GetEndSample() ) / capture.GetSampleRate();
+		fprintf ( stderr, "%llu frames, %llu FCS errors, %.3f s of capture decoded in %.3f s (%u threads, %u segments, %u joined by decoding again)\n",
+		          stats.mFields, stats.mFcsErrors, captureSeconds, seconds, threads,
+		          decoder.GetSegmentCount(), decoder.GetRedecodeCount() );
+	}
+	return true;
+}
+
+// Reader for the kind of capture the file is
+static BitbusCaptureReader* NewCaptureReader ( const char* path )
+{
+	if ( BitbusSaleaeBinaryReader::IsSaleaeBinary ( path ) )
+	{
+		return new BitbusSaleaeBinaryReader();
+	}
+	if ( BitbusRunLengthReader::IsRunLength ( path ) )
+	{
+		return new BitbusRunLengthReader();
+	}
+	return new BitbusEdgeListReader();
+}
+
+// Bit rate from the first edges of the capture, read apart from the ones
+// decoded; 0 if they do not tell
+static U32 DetectBitRate ( const char* path, U32 sampleRate )
+{
+	unique_ptr< BitbusCaptureReader > capture ( NewCaptureReader ( path ) );
+	string error;
+	if ( !capture->Open ( path, sampleRate, error ) )
+	{
+		return 0;
+	}
+	BitbusBitRateDetector detector ( capture->GetSampleRate() );
+	U64 edge;
+	for ( U32 i=0; ( i < BITBUS_AUTOBAUD_MAX_EDGES ) && capture->NextEdge ( edge ); ++i )
+	{
+		detector.AddEdge ( edge );
+	}
+	return detector.GetBitRate();
+}
+
+static int SaveRunLength ( BitbusCaptureReader & capture, const char* path, bool quiet )
+{
+	BitbusRunLengthWriter writer;
+	string error;
+	if ( !writer.Create ( path, capture.GetSampleRate(), capture.GetInitialState(), capture.GetTriggerSample(), error ) )
+	{
+		fprintf ( stderr, "%s\n", error.c_str() );
+		return 1;
+	}
+
+	U64 edge;
+	U64 edges = 0;
+	while ( capture.NextEdge ( edge ) )
+	{
+		edges += writer.AddEdge ( edge ) ? 1 : 0;
+	}
+	if ( !writer.Close ( capture.GetEndSample() ) )
+	{
+		fprintf ( stderr, "error writing %s\n", path );
+		return 1;
+	}
+
+	if ( !quiet )
+	{
+		fprintf ( stderr, "%llu edges, %llu samples written to %s\n", edges, capture.GetEndSample(), path );
+	}
+	return 0;
+}
+
+int main ( int argc, char** argv )
+{
+	static const char* const modes[] = { "nrzi", "nrz", "async" };
+	static const BitbusTransmissionModeType modeValues[] = { BITBUS_TRANSMISSION_BIT_SYNC, BITBUS_TRANSMISSION_BIT_SYNC_NRZ, BITBUS_TRANSMISSION_BYTE_ASYNC };
+	static const char* const addresses[] = { "sof", "normal", "extended" };
+	static const BitbusAddressingMode addressValues[] = { BITBUS_ADDRESS_SOF, BITBUS_ADDRESS_ADDR_RESERVED, BITBUS_ADDRESS_EXTENDED };
+	static const char* const fcsTypes[] = { "crc16", "crc32" };
+	static const BitbusFcsType fcsValues[] = { BITBUS_FCS_CRC16, BITBUS_FCS_CRC32 };
+	static const char* const bases[] = { "hex", "dec", "bin", "ascii" };
+	static const DisplayBase baseValues[] = { Hexadecimal, Decimal, Binary, ASCII };
+
+	BitbusDecoderSettings settings;
+	U32 sampleRate = 0;
+	DisplayBase displayBase = Hexadecimal;
+	bool quiet = false;
+	const char* inputPath = 0;
+	const char* outputPath = 0;
+	const char* savePath = 0;
+	const char* statsPath = 0;
+	const char* traceDirectory = 0;
+	U64 startSample = 0;
+	U32 threads = 1;
+	bool detectBitRate = false;
+
+	for ( int i=1; i < argc; ++i )
+	{
+		const char* arg = argv[ i ];
+		const char* value = ( i + 1 < argc ) ? argv[ i + 1 ] : "";
+		int index = 0;
+
+		if ( strcmp ( arg, "--quiet" ) == 0 )
+		{
+			quiet = true;
+			continue;
+		}
+		else if ( strcmp ( arg, "--save" ) == 0 )
+		{
+			savePath = value;
+			index = ( *value != 0 ) ? 0 : -1;
+		}
+		else if ( strcmp ( arg, "--stats" ) == 0 )
+		{
+			statsPath = value;
+			index = ( *value != 0 ) ? 0 : -1;
+		}
+		else if ( strcmp ( arg, "--trace" ) == 0 )
+		{
+			traceDirectory = value;
+			index = ( *value != 0 ) ? 0 : -1;
+		}
+		else if ( strcmp ( arg, "--start" ) == 0 )
+		{
+			char* end;
+			startSample = strtoull ( value, &end, 10 );
+			index = ( ( end != value ) && ( *end == 0 ) ) ? 0 : -1;
+		}
+		else if ( strcmp ( arg, "--threads" ) == 0 )
+		{
+			threads = U32 ( strtoul ( value, 0, 10 ) );
+			index = ( threads > 0 ) ? 0 : -1;
+		}
+		else if ( strcmp ( arg, "--sample-rate" ) == 0 )
+		{
+			sampleRate = U32 ( strtoul ( value, 0, 10 ) );
+			index = ( sampleRate > 0 ) ? 0 : -1;
+		}
+		else if ( strcmp ( arg, "--bit-rate" ) == 0 )
+		{
+			detectBitRate = ( strcmp ( value, "auto" ) == 0 );
+			if ( !detectBitRate )
+			{
+				settings.mBitRate = U32 ( strtoul ( value, 0, 10 ) );
+				index = ( settings.mBitRate > 0 ) ? 0 : -1;
+			}
+		}
+		else if ( strcmp ( arg, "--mode" ) == 0 )
+		{
+			index = Lookup ( value, modes, 3 );
+			settings.mTransmissionMode = modeValues[ ( index < 0 ) ? 0 : index ];
+		}
+		else if ( strcmp ( arg, "--address" ) == 0 )
+		{
+			index = Lookup ( value, addresses, 3 );
+			settings.mBitbusAddressingMode = addressValues[ ( index < 0 ) ? 0 : index ];
+		}
+		else if ( strcmp ( arg, "--fcs" ) == 0 )
+		{
+			index = Lookup ( value, fcsTypes, 2 );
+			settings.mFcsType = fcsValues[ ( index < 0 ) ? 0 : index ];
+		}
+		else if ( strcmp ( arg, "--base" ) == 0 )
+		{
+			index = Lookup ( value, bases, 4 );
+			displayBase = baseValues[ ( index < 0 ) ? 0 : index ];
+		}
+		else if ( ( arg[ 0 ] == '-' ) && ( arg[ 1 ] != 0 ) )
+		{
+			Usage();
+			return 2;
+		}
+		else
+		{
+			if ( inputPath == 0 )
+			{
+				inputPath = arg;
+			}
+			else if ( outputPath == 0 )
+			{
+				outputPath = arg;
+			}
+			else
+			{
+				Usage();
+				return 2;
+			}
+			continue;
+		}
+
+		if ( index < 0 )
+		{
+			fprintf ( stderr, "bad value for %s: %s\n", arg, value );
+			return 2;
+		}
+		i++; // the option's value
+	}
+
+	if ( inputPath == 0 )
+	{
+		Usage();
+		return 2;
+	}
+
+	if ( traceDirectory != 0 )
+	{
+#ifndef BITBUS_TRACE
+		fprintf ( stderr, "--trace: built without BITBUS_TRACE, nothing is recorded\n" );
+#endif
+		BitbusTraceRing::Configure ( traceDirectory, true );
+	}
+
+	unique_ptr< BitbusCaptureReader > capture ( NewCaptureReader ( inputPath ) );
+	string error;
+	if ( !capture->Open ( inputPath, sampleRate, error ) )
+	{
+		fprintf ( stderr, "%s\n", error.c_str() );
+		return 1;
+	}
+
+	if ( savePath != 0 )
+	{
+		return SaveRunLength ( *capture, savePath, quiet );
+	}
+
+	if ( detectBitRate )
+	{
+		settings.mBitRate = DetectBitRate ( inputPath, sampleRate );
+		if ( settings.mBitRate == 0 )
+		{
+			fprintf ( stderr, "cannot detect the bit rate: too few edges, or only flags\n" );
+			return 1;
+		}
+		if ( !quiet )
+		{
+			fprintf ( stderr, "bit rate detected: %u bit/s\n", settings.mBitRate );
+		}
+	}
+
+	ofstream outputFile;
+	if ( outputPath != 0 )
+	{
+		outputFile.open ( outputPath, ios::out );
+		if ( !outputFile )
+		{
+			fprintf ( stderr, "cannot write %s\n", outputPath );
+			return 1;
+		}
+	}
+	ostream & output = ( outputPath != 0 ) ? static_cast<ostream &> ( outputFile ) : cout;
+
+	if ( threads > 1 )
+	{
+		if ( !BitbusRunLengthReader::IsRunLength ( inputPath ) || ( startSample > 0 ) )
+		{
+			fprintf ( stderr, "--threads needs a run-length capture (convert it with --save first) and no --start\n" );
+			return 1;
+		}
+		if ( !DecodeParallel ( inputPath, *capture, settings, threads, displayBase, output, quiet, statsPath ) )
+		{
+			return 1;
+		}
+	}
+	else
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		BitbusStreamChannel channel ( capture->GetInitialState(), *capture );
+		if ( ( startSample > 0 ) && !channel.Seek ( startSample ) )
+		{
+			fprintf ( stderr, "--start needs a run-length capture, convert it with --save first\n" );
+			return 1;
+		}
+		BitbusCountingChannel< BitbusStreamChannel > countingChannel;
+		countingChannel.Setup ( &channel );
+		BitbusFrameReader< BitbusCountingChannel< BitbusStreamChannel > > frames ( settings, countingChannel, capture->GetSampleRate() );
+		BitbusWriteCsvExport ( output, frames, settings, displayBase, capture->GetTriggerSample(), capture->GetSampleRate(),
+		                       &BitbusGetNumberString, &BitbusGetTimeString );
+		output.flush();
+
+		std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+		double seconds = std::chrono::duration<double> ( elapsed ).count();
+
+		// Frames are decoded as the export asks for them: committing is the rest of the run,
+		// known only with the phases timed
+		BitbusDecodeStats stats = frames.GetStats();
+		stats.mEdges = countingChannel.GetEdgeCount();
+		stats.mChannelCalls = countingChannel.GetCallCount();
+		U64 decoding = stats.mFlagNanoseconds + stats.mByteNanoseconds;
+		U64 total = U64 ( std::chrono::duration_cast<std::chrono::nanoseconds> ( elapsed ).count() );
+		stats.mCommits = 1;
+		stats.mCommittedPackets = stats.mPackets;
+		stats.mCommitNanoseconds = ( ( decoding > 0 ) && ( total > decoding ) ) ? total - decoding : 0;
+		if ( !WriteStats ( statsPath, stats ) )
+		{
+			return 1;
+		}
+		if ( !quiet )
+		{
+			double captureSeconds = double ( channel.GetSampleNumber() ) / capture->GetSampleRate();
+			fprintf ( stderr, "%llu frames, %llu FCS errors, %.3f s of capture decoded in %.3f s\n",
+			          frames.GetDecodedFrameCount(), frames.GetFcsErrorCount(), captureSeconds, seconds );
+			const BitbusHuntStats & hunt = frames.GetHuntStats();
+			if ( hunt.mHunts > 0 )
+			{
+				fprintf ( stderr, "%llu flag hunts over %llu edges (%.3f s of capture) in %.3f ms\n",
+				          hunt.mHunts, hunt.mEdgesSkipped, double ( hunt.mSamplesSkipped ) / capture->GetSampleRate(),
+				          hunt.mNanoseconds / 1e6 );
+			}
+		}
+	}
+
+	if ( !output )
+	{
+		fprintf ( stderr, "error writing the output\n" );
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,386 @@
+// Synthetic BITBUS capture writer: sends simulated traffic (the analyzer's
+// simulation profiles) straight to a run-length capture (.bbrl) or a
+// Saleae Logic 2 binary export, with a ground-truth list of the frames it
+// sent. The capture is streamed, so it can be as large as the disk allows.
+//
+//   BitbusGenerate [options] <capture> [truth.csv]
+//
+// The capture reads back with BitbusDecode, using the same settings.
+
+#include "BitbusCaptureReader.h"
+#include "BitbusRunLengthCapture.h"
+#include "BitbusTraffic.h"
+#include <chrono>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace std;
+
+static void Usage()
+{
+	fprintf ( stderr,
+	          "usage: BitbusGenerate [options] <capture> [truth.csv]\n"
+	          "  capture: file to write, a run-length capture or a binary export (--format)\n"
+	          "  truth:   one line per frame sent: samples, address, length, FCS, status\n"
+	          "options:\n"
+	          "  --format FORMAT      bbrl (default) or saleae\n"
+	          "  --size BYTES         stop once the capture is this large (K, M or G suffix)\n"
+	          "  --seconds S          stop after this much capture time\n"
+	          "  --frames N           stop after N frames (default 1000 if no limit is given)\n"
+	          "  --sample-rate HZ     sample rate (default 25000000)\n"
+	          "  --bit-rate BPS       bit rate (default 62500); the sample rate must be a multiple of it\n"
+	          "  --mode MODE          nrzi (default), nrz or async\n"
+	          "  --address TYPE       sof (default), normal or extended\n"
+	          "  --fcs TYPE           crc16 (default) or crc32\n"
+	          "  --profile PROFILE    fixed (default), mixed, stuffing or faults\n"
+	          "  --seed N             random seed (default 5)\n"
+	          "  --quiet              no summary on stderr\n" );
+}
+
+// Index of value in names, or -1
+static int Lookup ( const char* value, const char* const* names, int count )
+{
+	for ( int i=0; i < count; ++i )
+	{
+		if ( strcmp ( value, names[ i ] ) == 0 )
+		{
+			return i;
+		}
+	}
+	return -1;
+}
+
+// A byte count with an optional K, M or G (binary) suffix; 0 if bad
+static U64 ParseSize ( const char* value )
+{
+	char* end;
+	U64 size = strtoull ( value, &end, 10 );
+	if ( end == value )
+	{
+		return 0;
+	}
+	switch ( *end )
+	{
+	case 'G': case 'g': size <<= 10; // fall through
+	case 'M': case 'm': size <<= 10; // fall through
+	case 'K': case 'k': size <<= 10; end++; break;
+	default: break;
+	}
+	return ( *end == 0 ) ? size : 0;
+}
+
+// The line as BitbusTrafficWriter drives it, each edge going to a capture
+// writer (BitbusRunLengthWriter or BitbusSaleaeBinaryWriter)
+template <class Writer>
+class CaptureLine
+{
+public:
+	CaptureLine ( Writer & writer, BitState initialState )
+		:	mWriter ( writer ), mState ( initialState ), mSample ( 0 ), mEdges ( 0 )
+	{
+	}
+
+	void Transition()
+	{
+		mWriter.AddEdge ( mSample );
+		mState = ( mState == BIT_LOW ) ? BIT_HIGH : BIT_LOW;
+		mEdges++;
+	}
+
+	void TransitionIfNeeded ( BitState state )
+	{
+		if ( state != mState )
+		{
+			Transition();
+		}
+	}
+
+	void Advance ( U32 samples )
+	{
+		mSample += samples;
+	}
+
+	BitState GetCurrentBitState() const
+	{
+		return mState;
+	}
+
+	U64 GetCurrentSampleNumber() const
+	{
+		return mSample;
+	}
+
+	U64 GetEdgeCount() const
+	{
+		return mEdges;
+	}
+
+protected:
+	Writer & mWriter;
+	BitState mState;
+	U64 mSample;
+	U64 mEdges;
+};
+
+struct GenerateOptions
+{
+	BitbusDecoderSettings mSettings;
+	BitbusTrafficType mProfile;
+	U32 mSampleRate;
+	U64 mSeed;
+	U64 mMaxBytes;   // 0: no limit
+	U64 mMaxSamples; // 0: no limit
+	U64 mMaxFrames;  // 0: no limit
+	bool mQuiet;
+};
+
+static void WriteTruth ( FILE* truth, U64 index, const BitbusTrafficFrame & frame, U32 fcsBytes, U32 sampleRate )
+{
+	const char* status = frame.mAborted ? "aborted" : ( frame.mFcsError ? "fcs_error" : "ok" );
+	U32 address = 0;
+	for ( U32 i=0; i < frame.mAddressBytes; ++i )
+	{
+		address = ( address << 8 ) | frame.mBytes[ i ];
+	}
+	fprintf ( truth, "%llu,%llu,%llu,%.9f,0x%04X,%u,", index, frame.mStartSample, frame.mEndSample,
+	          double ( frame.mStartSample ) / sampleRate, address, U32 ( frame.mBytes.size() - frame.mAddressBytes ) );
+	if ( frame.mAborted )
+	{
+		fprintf ( truth, ",%s\n", status );
+	}
+	else
+	{
+		fprintf ( truth, "0x%0*X,%s\n", int ( 2 * fcsBytes ), frame.mFcs, status );
+	}
+}
+
+template <class Writer>
+static int Generate ( Writer & writer, const char* capturePath, FILE* truth, const GenerateOptions & options )
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// The simulation's line: low, idle for a while before the first flag
+	const U64 samplesPerBit = options.mSampleRate / options.mSettings.mBitRate;
+	CaptureLine<Writer> line ( writer, BIT_LOW );
+	BitbusTrafficWriter< CaptureLine<Writer> > traffic ( options.mSettings, BitbusTrafficProfile::Get ( options.mProfile ),
+	                                                     samplesPerBit, options.mSeed );
+	line.Advance ( U32 ( 16 * samplesPerBit ) );
+
+	const U32 fcsBytes = BitbusDecoderSettings::FcsBytes ( options.mSettings.mFcsType );
+	U64 frames = 0;
+	U64 aborted = 0;
+	U64 fcsErrors = 0;
+	for ( ; ; )
+	{
+		if ( ( ( options.mMaxFrames > 0 ) && ( frames >= options.mMaxFrames ) ) ||
+		     ( ( options.mMaxSamples > 0 ) && ( line.GetCurrentSampleNumber() >= options.mMaxSamples ) ) ||
+		     ( ( options.mMaxBytes > 0 ) && ( writer.GetSize() >= options.mMaxBytes ) ) )
+		{
+			break;
+		}
+
+		const BitbusTrafficFrame & frame = traffic.SendFrame ( line );
+		aborted += frame.mAborted ? 1 : 0;
+		fcsErrors += frame.mFcsError ? 1 : 0;
+		if ( truth != 0 )
+		{
+			WriteTruth ( truth, frames, frame, fcsBytes, options.mSampleRate );
+		}
+		frames++;
+	}
+
+	// Closing flags, so the last frame is seen to end
+	traffic.SendFlag ( line );
+	traffic.SendFlag ( line );
+	line.Advance ( U32 ( 16 * samplesPerBit ) );
+
+	if ( !writer.Close ( line.GetCurrentSampleNumber() ) )
+	{
+		fprintf ( stderr, "error writing %s\n", capturePath );
+		return 1;
+	}
+
+	double seconds = std::chrono::duration<double> ( std::chrono::steady_clock::now() - start ).count();
+	if ( !options.mQuiet )
+	{
+		fprintf ( stderr, "%llu frames (%llu aborted, %llu FCS errors), %llu edges, %.3f s of capture, %llu bytes written to %s in %.3f s\n",
+		          frames, aborted, fcsErrors, line.GetEdgeCount(), double ( line.GetCurrentSampleNumber() ) / options.mSampleRate,
+		          writer.GetSize(), capturePath, seconds );
+	}
+	return 0;
+}
+
+int main ( int argc, char** argv )
+{
+	static const char* const formats[] = { "bbrl", "saleae" };
+	static const char* const modes[] = { "nrzi", "nrz", "async" };
+	static const BitbusTransmissionModeType modeValues[] = { BITBUS_TRANSMISSION_BIT_SYNC, BITBUS_TRANSMISSION_BIT_SYNC_NRZ, BITBUS_TRANSMISSION_BYTE_ASYNC };
+	static const char* const addresses[] = { "sof", "normal", "extended" };
+	static const BitbusAddressingMode addressValues[] = { BITBUS_ADDRESS_SOF, BITBUS_ADDRESS_ADDR_RESERVED, BITBUS_ADDRESS_EXTENDED };
+	static const char* const fcsTypes[] = { "crc16", "crc32" };
+	static const BitbusFcsType fcsValues[] = { BITBUS_FCS_CRC16, BITBUS_FCS_CRC32 };
+
+	GenerateOptions options;
+	options.mProfile = BITBUS_TRAFFIC_FIXED;
+	options.mSampleRate = 25000000;
+	options.mSeed = 5;
+	options.mMaxBytes = 0;
+	options.mMaxSamples = 0;
+	options.mMaxFrames = 0;
+	options.mQuiet = false;
+	int format = 0;
+	double maxSeconds = 0.0;
+	const char* capturePath = 0;
+	const char* truthPath = 0;
+
+	for ( int i=1; i < argc; ++i )
+	{
+		const char* arg = argv[ i ];
+		const char* value = ( i + 1 < argc ) ? argv[ i + 1 ] : "";
+		int index = 0;
+
+		if ( strcmp ( arg, "--quiet" ) == 0 )
+		{
+			options.mQuiet = true;
+			continue;
+		}
+		else if ( strcmp ( arg, "--format" ) == 0 )
+		{
+			index = format = Lookup ( value, formats, 2 );
+		}
+		else if ( strcmp ( arg, "--size" ) == 0 )
+		{
+			options.mMaxBytes = ParseSize ( value );
+			index = ( options.mMaxBytes > 0 ) ? 0 : -1;
+		}
+		else if ( strcmp ( arg, "--seconds" ) == 0 )
+		{
+			maxSeconds = atof ( value );
+			index = ( maxSeconds > 0.0 ) ? 0 : -1;
+		}
+		else if ( strcmp ( arg, "--frames" ) == 0 )
+		{
+			options.mMaxFrames = strtoull ( value, 0, 10 );
+			index = ( options.mMaxFrames > 0 ) ? 0 : -1;
+		}
+		else if ( strcmp ( arg, "--sample-rate" ) == 0 )
+		{
+			options.mSampleRate = U32 ( strtoul ( value, 0, 10 ) );
+			index = ( options.mSampleRate > 0 ) ? 0 : -1;
+		}
+		else if ( strcmp ( arg, "--bit-rate" ) == 0 )
+		{
+			options.mSettings.mBitRate = U32 ( strtoul ( value, 0, 10 ) );
+			index = ( options.mSettings.mBitRate > 0 ) ? 0 : -1;
+		}
+		else if ( strcmp ( arg, "--mode" ) == 0 )
+		{
+			index = Lookup ( value, modes, 3 );
+			options.mSettings.mTransmissionMode = modeValues[ ( index < 0 ) ? 0 : index ];
+		}
+		else if ( strcmp ( arg, "--address" ) == 0 )
+		{
+			index = Lookup ( value, addresses, 3 );
+			options.mSettings.mBitbusAddressingMode = addressValues[ ( index < 0 ) ? 0 : index ];
+		}
+		else if ( strcmp ( arg, "--fcs" ) == 0 )
+		{
+			index = Lookup ( value, fcsTypes, 2 );
+			options.mSettings.mFcsType = fcsValues[ ( index < 0 ) ? 0 : index ];
+		}
+		else if ( strcmp ( arg, "--profile" ) == 0 )
+		{
+			index = BitbusTrafficProfile::Find ( value, options.mProfile ) ? 0 : -1;
+		}
+		else if ( strcmp ( arg, "--seed" ) == 0 )
+		{
+			char* end;
+			options.mSeed = strtoull ( value, &end, 10 );
+			index = ( ( end != value ) && ( *end == 0 ) ) ? 0 : -1;
+		}
+		else if ( ( arg[ 0 ] == '-' ) && ( arg[ 1 ] != 0 ) )
+		{
+			Usage();
+			return 2;
+		}
+		else
+		{
+			if ( capturePath == 0 )
+			{
+				capturePath = arg;
+			}
+			else if ( truthPath == 0 )
+			{
+				truthPath = arg;
+			}
+			else
+			{
+				Usage();
+				return 2;
+			}
+			continue;
+		}
+
+		if ( index < 0 )
+		{
+			fprintf ( stderr, "bad value for %s: %s\n", arg, value );
+			return 2;
+		}
+		i++; // the option's value
+	}
+
+	if ( capturePath == 0 )
+	{
+		Usage();
+		return 2;
+	}
+	if ( ( options.mSampleRate % options.mSettings.mBitRate ) != 0 || ( options.mSampleRate / options.mSettings.mBitRate < 2 ) )
+	{
+		fprintf ( stderr, "the sample rate must be a multiple (2 or more) of the bit rate\n" );
+		return 2;
+	}
+	options.mMaxSamples = U64 ( maxSeconds * options.mSampleRate );
+	if ( ( options.mMaxBytes == 0 ) && ( options.mMaxSamples == 0 ) && ( options.mMaxFrames == 0 ) )
+	{
+		options.mMaxFrames = 1000;
+	}
+
+	FILE* truth = 0;
+	if ( truthPath != 0 )
+	{
+		truth = fopen ( truthPath, "w" );
+		if ( truth == 0 )
+		{
+			fprintf ( stderr, "cannot write %s\n", truthPath );
+			return 1;
+		}
+		setvbuf ( truth, 0, _IOFBF, 1 << 20 );
+		fprintf ( truth, "frame,start_sample,end_sample,start_time,address,info_bytes,fcs,status\n" );
+	}
+
+	string error;
+	int result;
+	if ( format == 0 )
+	{
+		BitbusRunLengthWriter writer;
+		result = writer.Create ( capturePath, options.mSampleRate, BIT_LOW, 0, error ) ? Generate ( writer, capturePath, truth, options ) : 1;
+	}
+	else
+	{
+		BitbusSaleaeBinaryWriter writer;
+		result = writer.Create ( capturePath, options.mSampleRate, BIT_LOW, error ) ? Generate ( writer, capturePath, truth, options ) : 1;
+	}
+	if ( !error.empty() )
+	{
+		fprintf ( stderr, "%s\n", error.c_str() );
+	}
+
+	if ( ( truth != 0 ) && ( fclose ( truth ) != 0 ) && ( result == 0 ) )
+	{
+		fprintf ( stderr, "error writing %s\n", truthPath );
+		result = 1;
+	}
+	return result;
+}
@@ -0,0 +1,89 @@
+// Prints decoder trace dumps (.bbtr, see BitbusTrace.h) as text: one line
+// per record, oldest first, with its sample number and payload.
+//
+//   BitbusTraceDump [--sample-rate HZ] <trace.bbtr>...
+
+#include "BitbusTrace.h"
+#include <fstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+using namespace std;
+
+static void Usage()
+{
+	fprintf ( stderr,
+	          "usage: BitbusTraceDump [options] <trace.bbtr>...\n"
+	          "  trace: ring dump written by a decoder built with -DBITBUS_TRACE=ON\n"
+	          "options:\n"
+	          "  --sample-rate HZ     also print the time of each record, in seconds\n" );
+}
+
+static void PrintTrace ( const BitbusTraceHeader & header, const vector<BitbusTraceRecord> & records, U32 sampleRate )
+{
+	printf ( "thread %u, %s: %llu of %llu records\n", header.mThread, header.mReason.c_str(), header.mKept, header.mRecorded );
+
+	const U64 first = header.mRecorded - header.mKept;
+	for ( U64 i=0; i < records.size(); ++i )
+	{
+		const BitbusTraceRecord & record = records[ i ];
+		printf ( "%12llu %14llu ", first + i, record.mSample );
+		if ( sampleRate > 0 )
+		{
+			printf ( "%14.9f ", double ( record.mSample ) / sampleRate );
+		}
+		if ( record.mEvent == BITBUS_TRACE_BYTE )
+		{
+			printf ( "%-12s 0x%02X\n", BitbusTraceEventName ( record.mEvent ), record.mPayload );
+		}
+		else
+		{
+			printf ( "%-12s %u\n", BitbusTraceEventName ( record.mEvent ), record.mPayload );
+		}
+	}
+}
+
+int main ( int argc, char* argv[] )
+{
+	U32 sampleRate = 0;
+	int traces = 0;
+
+	for ( int i=1; i < argc; ++i )
+	{
+		if ( strcmp ( argv[ i ], "--sample-rate" ) == 0 )
+		{
+			sampleRate = ( i + 1 < argc ) ? U32 ( strtoul ( argv[ ++i ], 0, 10 ) ) : 0;
+			if ( sampleRate == 0 )
+			{
+				Usage();
+				return 2;
+			}
+			continue;
+		}
+		if ( argv[ i ][ 0 ] == '-' )
+		{
+			Usage();
+			return 2;
+		}
+
+		ifstream file ( argv[ i ], ios::in | ios::binary );
+		BitbusTraceHeader header;
+		vector<BitbusTraceRecord> records;
+		string error;
+		if ( !file || !BitbusReadTrace ( file, header, records, error ) )
+		{
+			fprintf ( stderr, "%s: %s\n", argv[ i ], file ? error.c_str() : "cannot open" );
+			return 1;
+		}
+		PrintTrace ( header, records, sampleRate );
+		traces++;
+	}
+
+	if ( traces == 0 )
+	{
+		Usage();
+		return 2;
+	}
+	return 0;
+}